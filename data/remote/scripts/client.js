@@ -10,6 +10,7 @@ var currentQueue, currentTransfers = [];
 var interval, graphMinutes = 5;
 var transferClasses, settingsPages;
 var settingsStore = [];
+var globalLogNext = 0, transferLogNext = 0, transferLogUuid;
 
 function clientInit() {
 	client = XmlRpc.getObject("/xmlrpc", rpcMethods);
@@ -280,6 +281,21 @@ function updateTransfers() {
 	});
 }
 
+// Replaces or extends a log view with the records received since the last request
+function appendLog(id, data, full, scroll) {
+	var elem = $(id);
+	if (full)
+		elem.text(data);
+	else if (data.length > 0) {
+		var atBottom = elem.scrollTop() + elem.innerHeight() >= elem[0].scrollHeight;
+		var text = elem.text();
+		elem.text(text.length > 0 ? text + "\n" + data : data);
+		scroll = scroll || atBottom;
+	}
+	if (scroll)
+		elem.scrollTop(elem[0].scrollHeight);
+}
+
 function tabSwitched(reallySwitched) {
 	d = new Date();
 	if ($("#tabs-tsg").is(':visible')) {
@@ -308,18 +324,25 @@ function tabSwitched(reallySwitched) {
 			$("#tabs").tabs("option", "selected", 0);
 	}
 	else if ($("#global-log").is(':visible')) {
-		$.get('/log', function(data) {
-			$("#global-log").text(data);
-			if (reallySwitched)
-				$("#global-log").scrollTop($("#global-log")[0].scrollHeight);
+		if (reallySwitched)
+			globalLogNext = 0;
+		$.get('/log', { since: globalLogNext }, function(data, status, xhr) {
+			var full = globalLogNext == 0;
+			globalLogNext = parseInt(xhr.getResponseHeader('X-Log-Next')) || 0;
+			appendLog("#global-log", data, full, reallySwitched);
 		});
 		if (currentTransfers.length == 1) {
-			$.get('/log/'+currentTransfers[0], function(data) {
-				$("#transfer-log").text(data);
-				if (reallySwitched)
-					$("#transfer-log").scrollTop($("#transfer-log")[0].scrollHeight);
+			if (reallySwitched || transferLogUuid != currentTransfers[0]) {
+				transferLogUuid = currentTransfers[0];
+				transferLogNext = 0;
+			}
+			$.get('/log/'+transferLogUuid, { since: transferLogNext }, function(data, status, xhr) {
+				var full = transferLogNext == 0;
+				transferLogNext = parseInt(xhr.getResponseHeader('X-Log-Next')) || 0;
+				appendLog("#transfer-log", data, full, reallySwitched);
 			});
 		} else {
+			transferLogUuid = null;
 			$("#transfer-log").html('');
 		}
 	}
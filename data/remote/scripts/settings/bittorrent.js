@@ -11,7 +11,7 @@ function settingsLoad() {
 	"torrent/maxuploads", "torrent/maxconnections_loc", "torrent/maxuploads_loc", "torrent/maxfiles",
 	"torrent/dht", "torrent/pex", "torrent/allocation", "torrent/external_ip", "torrent/enc_incoming",
 	"torrent/enc_outgoing", "torrent/enc_level", "torrent/enc_rc4_prefer", "torrent/mapping_upnp",
-	"torrent/mapping_natpmp", "torrent/mapping_lsd"];
+	"torrent/mapping_natpmp", "torrent/mapping_lsd", "torrent/ipfilter_enable", "torrent/ipfilter"];
 	
 	getSettingsValues(keys, function(hash) {
 		$("#bittorrent-port-start").val(hash["torrent/listen_start"]);
@@ -33,6 +33,8 @@ function settingsLoad() {
 		$("#bittorrent-encryption-preferrc4").attr('checked', isTrue(hash["torrent/enc_rc4_prefer"]));
 		$("#bittorrent-portmapping-upnp").attr('checked', isTrue(hash["torrent/mapping_upnp"]));
 		$("#bittorrent-portmapping-natpmp").attr('checked', isTrue(hash["torrent/mapping_natpmp"]));
+		$("#bittorrent-ipfilter-enable").attr('checked', isTrue(hash["torrent/ipfilter_enable"]));
+		$("#bittorrent-ipfilter-file").val(hash["torrent/ipfilter"]);
 	});
 }
 
@@ -73,4 +75,6 @@ function settingsSave() {
 	setSettingsValue("torrent/enc_level", $("#bittorrent-encryption-levels").val());
 	setSettingsValue("torrent/external_ip", $("#bittorrent-external-ip").val());
 	setSettingsValue("torrent/allocation", $("#bittorrent-allocation-mode").val());
+	setSettingsValue("torrent/ipfilter_enable", $("#bittorrent-ipfilter-enable").is(":checked"));
+	setSettingsValue("torrent/ipfilter", $("#bittorrent-ipfilter-file").val());
 }
@@ -41,7 +41,7 @@ function subclassPerformReload(t) {
 		if (scTorrentDownloadFirstLoad) {
 			for (var p=0;p<data.files.length;p++) {
 				$("<tr id='torrentdownload-files-"+p+"'>"+
-					"<td><input type='checkbox' rel='"+p+"' id='torrentdownload-files-"+p+"-checkbox' /><span class='filename'>"+removeTopDir(data.files[p].name)+"</span></td>"+
+					"<td><input type='checkbox' rel='"+p+"' id='torrentdownload-files-"+p+"-checkbox' /><a class='filename' target='_blank' title='Play while downloading' href='/stream?transfer="+t.uuid+"&file="+p+"'>"+removeTopDir(data.files[p].name)+"</a></td>"+
 					"<td>"+formatSize(data.files[p].size)+"</td>"+
 					"<td class='progressbar' id='torrentdownload-files-"+p+"-progress'><span></span></td>"+
 					"<td class='torrentdownload-priority'><select rel='"+p+"' id='torrentdownload-files-"+p+"-select'>"+
@@ -25,10 +25,18 @@ respects for all of the code used other than "OpenSSL".
 */
 
 #include "Auth.h"
+#include "Settings.h"
 #include <QSettings>
+#include <QRegExp>
+#include <QMutex>
 
 extern QSettings* g_settings;
 
+static QMutex m_cacheLock;
+static QList<Auth> m_cachedAuths;
+static QList<QRegExp> m_cachedRegExps;
+static int m_nCacheGeneration = -1;
+
 QList<Auth> Auth::loadAuths()
 {
 	QList<Auth> r;
@@ -61,4 +69,31 @@ void Auth::saveAuths(const QList<Auth>& auths)
 		g_settings->setValue("password", auths[i].strPassword);
 	}
 	g_settings->endArray();
+	invalidateSettingsCache();
+}
+
+bool Auth::find(QString url, Auth& out)
+{
+	QMutexLocker l(&m_cacheLock);
+	const int gen = g_settingsGeneration.loadAcquire();
+	
+	if(gen != m_nCacheGeneration)
+	{
+		m_cachedAuths = loadAuths();
+		m_cachedRegExps.clear();
+		
+		foreach(const Auth& a, m_cachedAuths)
+			m_cachedRegExps << QRegExp(a.strRegExp);
+		m_nCacheGeneration = gen;
+	}
+	
+	for(int i=0;i<m_cachedRegExps.size();i++)
+	{
+		if(m_cachedRegExps[i].exactMatch(url))
+		{
+			out = m_cachedAuths[i];
+			return true;
+		}
+	}
+	return false;
 }
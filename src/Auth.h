@@ -34,6 +34,9 @@ struct Auth
 	QString strRegExp, strUser, strPassword;
 	static QList<Auth> loadAuths();
 	static void saveAuths(const QList<Auth>& auths);
+	// finds the stored authentication data for the URL, the regexps
+	// are compiled once per settings change
+	static bool find(QString url, Auth& out);
 };
 
 #endif
@@ -29,16 +29,17 @@ respects for all of the code used other than "OpenSSL".
 #include <QObject>
 #include <QTextEdit>
 #include "Transfer.h"
+#include "TickService.h"
 
 class LogManager : public QObject
 {
 Q_OBJECT
 public:
 	LogManager(QObject* parent, QTextEdit* widgetT, QTextEdit* widgetG)
-	: QObject(parent), m_text(widgetT), m_textG(widgetG), m_last(0)
+	: QObject(parent), m_text(widgetT), m_textG(widgetG), m_last(0), m_nNext(0), m_nNextG(0)
 	{
-		widgetG->setPlainText(Logger::global()->logContents());
-		connect(Logger::global(), SIGNAL(logMessage(QString)), widgetG, SLOT(append(const QString&)));
+		widgetG->setPlainText(Logger::global()->logContents(0, &m_nNextG));
+		connect(TickService::instance(), SIGNAL(guiTick()), this, SLOT(refresh()));
 	}
 	void setLogSource(Transfer* t)
 	{
@@ -46,19 +47,13 @@ public:
 			return;
 		
 		if(m_last != 0)
-		{
-			disconnect(m_last, SIGNAL(logMessage(QString)), m_text, SLOT(append(const QString&)));
-			disconnect(m_last, SIGNAL(logMessage(QString)), this, SLOT(onLogMessage()));
 			disconnect(m_last, SIGNAL(destroyed()), this, SLOT(onDeleteSource()));
-		}
 		m_last = t;
 		
 		if(t != 0)
 		{
 			m_text->setEnabled(true);
-			m_text->setPlainText(t->logContents());
-			connect(t, SIGNAL(logMessage(QString)), m_text, SLOT(append(const QString&)));
-			connect(t, SIGNAL(logMessage(QString)), this, SLOT(onLogMessage()));
+			m_text->setPlainText(t->logContents(0, &m_nNext));
 			connect(t, SIGNAL(destroyed()), this, SLOT(onDeleteSource()));
 		}
 		else
@@ -72,14 +67,29 @@ public slots:
 	{
 		m_last = 0;
 	}
-	void onLogMessage()
+	// appends the records logged since the last refresh
+	void refresh()
 	{
-		if (m_text->toPlainText().size() > 2*1024*1024)
-			m_text->setPlainText(m_last->logContents());
+		QString text = Logger::global()->logContents(m_nNextG, &m_nNextG);
+		if (!text.isEmpty())
+			m_textG->append(text);
+		
+		if (m_last != 0)
+		{
+			text = m_last->logContents(m_nNext, &m_nNext);
+			if (!text.isEmpty())
+			{
+				if (m_text->toPlainText().size() > 2*1024*1024)
+					m_text->setPlainText(m_last->logContents(0, &m_nNext));
+				else
+					m_text->append(text);
+			}
+		}
 	}
 private:
 	QTextEdit *m_text, *m_textG;
 	Transfer* m_last;
+	qint64 m_nNext, m_nNextG;
 };
 
 #endif
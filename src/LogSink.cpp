@@ -0,0 +1,180 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "LogSink.h"
+#include <QMutexLocker>
+#include <syslog.h>
+
+// records waiting to be written, anything beyond is dropped
+static const int MAX_PENDING = 10000;
+
+LogSink* LogSink::m_instance = 0;
+
+LogSink::LogSink()
+	: m_nDropped(0), m_bAbort(false), m_bSysLog(false)
+{
+}
+
+LogSink::~LogSink()
+{
+	if (m_bSysLog)
+		closelog();
+}
+
+LogSink* LogSink::instance()
+{
+	static QMutex creationLock;
+	QMutexLocker l(&creationLock);
+	
+	if (!m_instance)
+		m_instance = new LogSink;
+	return m_instance;
+}
+
+void LogSink::shutdown()
+{
+	if (!m_instance)
+		return;
+	
+	m_instance->m_lock.lock();
+	m_instance->m_bAbort = true;
+	m_instance->m_cond.wakeAll();
+	m_instance->m_lock.unlock();
+	
+	m_instance->wait();
+	delete m_instance;
+	m_instance = 0;
+}
+
+void LogSink::post(const Logger::Record& record)
+{
+	QMutexLocker l(&m_lock);
+	
+	if (m_pending.size() >= MAX_PENDING)
+		m_nDropped++;
+	else
+		m_pending << record;
+	
+	// started on demand, the process may still daemonize while the options are parsed
+	if (!isRunning())
+		start(QThread::LowPriority);
+	else
+		m_cond.wakeOne();
+}
+
+void LogSink::enableSysLog(bool on)
+{
+	QMutexLocker l(&m_lock);
+	if (on == m_bSysLog)
+		return;
+	
+	if (on)
+		openlog("fatrat", LOG_PID, LOG_USER);
+	else
+		closelog();
+	m_bSysLog = on;
+}
+
+bool LogSink::setFile(QString path)
+{
+	QMutexLocker l(&m_lock);
+	
+	m_file.close();
+	if (path.isEmpty())
+		return true;
+	
+	m_file.setFileName(path);
+	return m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+}
+
+void LogSink::run()
+{
+	QMutexLocker l(&m_lock);
+	
+	while (true)
+	{
+		while (m_pending.isEmpty() && !m_nDropped && !m_bAbort)
+			m_cond.wait(&m_lock);
+		
+		if (m_pending.isEmpty() && !m_nDropped && m_bAbort)
+			break;
+		
+		QList<Logger::Record> records;
+		int dropped = m_nDropped;
+		
+		records.swap(m_pending);
+		m_nDropped = 0;
+		
+		// syslog() and the file are only touched by this thread
+		// and the settings are changed under the lock
+		const bool sysLog = m_bSysLog;
+		const bool file = m_file.isOpen();
+		
+		l.unlock();
+		
+		QByteArray out;
+		
+		if (dropped)
+		{
+			Logger::Record r;
+			r.time = QDateTime::currentMSecsSinceEpoch();
+			r.level = Logger::LevelWarning;
+			r.message = QString("%1 log messages have been dropped").arg(dropped);
+			records.prepend(r);
+		}
+		
+		foreach (const Logger::Record& r, records)
+		{
+			QByteArray line = Logger::format(r).toUtf8();
+			
+			if (sysLog)
+			{
+				int priority = LOG_INFO;
+				if (r.level == Logger::LevelWarning)
+					priority = LOG_WARNING;
+				else if (r.level == Logger::LevelError)
+					priority = LOG_ERR;
+				else if (r.level == Logger::LevelDebug)
+					priority = LOG_DEBUG;
+				
+				syslog(priority, "%s", line.constData());
+			}
+			if (file)
+			{
+				out += line;
+				out += '\n';
+			}
+		}
+		
+		l.relock();
+		
+		if (file && m_file.isOpen())
+		{
+			m_file.write(out);
+			m_file.flush();
+		}
+	}
+}
@@ -0,0 +1,63 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef LOGSINK_H
+#define LOGSINK_H
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QList>
+#include "Logger.h"
+
+// Writes log records to syslog and/or a file on its own thread,
+// so that logging never blocks the thread that produced the message
+class LogSink : public QThread
+{
+public:
+	static LogSink* instance();
+	// flushes the pending records and stops the thread
+	static void shutdown();
+	
+	void post(const Logger::Record& record);
+	void enableSysLog(bool on);
+	bool setFile(QString path);
+protected:
+	LogSink();
+	~LogSink();
+	virtual void run();
+private:
+	static LogSink* m_instance;
+	
+	QMutex m_lock;
+	QWaitCondition m_cond;
+	QList<Logger::Record> m_pending;
+	int m_nDropped;
+	bool m_bAbort, m_bSysLog;
+	QFile m_file;
+};
+
+#endif
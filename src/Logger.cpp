@@ -24,70 +24,126 @@ executables. You must obey the GNU General Public License in all
 respects for all of the code used other than "OpenSSL".
 */
 
+
 #include "Logger.h"
-#include <QDate>
-#include <QTime>
-#include <syslog.h>
+#include "LogSink.h"
+#include <QDateTime>
+#include <QStringList>
 
-Logger Logger::m_global;
+Logger Logger::m_global(10000);
 
-Logger::Logger()
-	: m_bSysLog(false)
+Logger::Logger(int capacity)
+	: m_nCapacity(qMax(capacity, 1)), m_nNext(0), m_bSink(false)
 {
+	// the ring grows on demand up to the capacity
 }
 
 Logger::~Logger()
 {
-	if (m_bSysLog)
-		closelog();
+}
+
+void Logger::toggleSink(bool on)
+{
+	QMutexLocker l(&m_lock);
+	m_bSink = on;
 }
 
 void Logger::toggleSysLog(bool on)
 {
-	if (on != m_bSysLog)
-	{
-		if (on)
-			openlog("fatrat", LOG_PID, LOG_USER);
-		else
-			closelog();
-		m_bSysLog = on;
-	}
+	LogSink::instance()->enableSysLog(on);
+	if (on)
+		toggleSink(true);
 }
 
-void Logger::enterLogMessage(QString msg)
+void Logger::enterLogMessage(Level level, QString sender, QString msg)
 {
-	QWriteLocker l(&m_lock);
+	Record r;
 	
-	QString text = QString("%1 %2 - %3")
-		.arg( QDate::currentDate().toString(Qt::ISODate) )
-		.arg( QTime::currentTime().toString(Qt::ISODate) )
-		.arg(msg);
-
-	if(!m_strLog.isEmpty())
-		m_strLog += '\n';
+	r.time = QDateTime::currentMSecsSinceEpoch();
+	r.level = level;
+	r.sender = sender;
+	r.message = msg;
 	
-	m_strLog += text;
+	QMutexLocker l(&m_lock);
+	r.seq = m_nNext++;
 	
-	if (m_strLog.size() > 2*1024*1024)
-		m_strLog = m_strLog.mid(1024*1024);
-
+	if (m_records.size() < m_nCapacity)
+		m_records << r;
+	else
+		m_records[r.seq % m_nCapacity] = r;
+	
+	const bool sink = m_bSink;
 	l.unlock();
-	emit logMessage(text);
+	
+	if (sink)
+		LogSink::instance()->post(r);
+}
 
-	if (m_bSysLog)
-	{
-		std::string str = text.toStdString();
-		syslog(LOG_INFO, "%s", str.c_str());
-	}
+void Logger::enterLogMessage(QString msg)
+{
+	enterLogMessage(LevelInfo, QString(), msg);
 }
 
 void Logger::enterLogMessage(QString sender, QString msg)
 {
-	enterLogMessage(QString("[%1]: %2").arg(sender).arg(msg));
+	enterLogMessage(LevelInfo, sender, msg);
+}
+
+QList<Logger::Record> Logger::records(qint64 since, qint64* next) const
+{
+	QList<Record> result;
+	QMutexLocker l(&m_lock);
+	
+	// records older than this have been overwritten already
+	const qint64 oldest = m_nNext - m_records.size();
+	
+	// a cursor from before a restart starts over with what is retained
+	if (since > m_nNext || since < oldest)
+		since = oldest;
+	
+	for (qint64 s = since; s < m_nNext; s++)
+		result << m_records[s % m_nCapacity];
+	
+	if (next)
+		*next = m_nNext;
+	return result;
+}
+
+qint64 Logger::nextSequence() const
+{
+	QMutexLocker l(&m_lock);
+	return m_nNext;
 }
 
 QString Logger::logContents() const
 {
-	QReadLocker l(&m_lock); // TODO: Is this sufficient?
-	return m_strLog;
+	return logContents(0, 0);
+}
+
+QString Logger::logContents(qint64 since, qint64* next) const
+{
+	QList<Record> recs = records(since, next);
+	QStringList lines;
+	
+	// formatting happens here, outside of the lock
+	foreach (const Record& r, recs)
+		lines << format(r);
+	
+	return lines.join("\n");
+}
+
+QString Logger::format(const Record& r)
+{
+	QDateTime dt = QDateTime::fromMSecsSinceEpoch(r.time);
+	QString text = dt.date().toString(Qt::ISODate) + ' ' + dt.time().toString(Qt::ISODate) + " - ";
+	
+	if (r.level == LevelWarning)
+		text += "WARNING: ";
+	else if (r.level == LevelError)
+		text += "ERROR: ";
+	
+	if (!r.sender.isEmpty())
+		text += QString("[%1]: ").arg(r.sender);
+	
+	return text + r.message;
 }
@@ -24,33 +24,61 @@ executables. You must obey the GNU General Public License in all
 respects for all of the code used other than "OpenSSL".
 */
 
+
 #ifndef LOGGER_H
 #define LOGGER_H
 #include <QObject>
 #include <QString>
-#include <QReadWriteLock>
+#include <QVector>
+#include <QMutex>
 
+// Keeps the most recent log records in a fixed-size ring. The records are
+// stored unformatted and only turned into text when somebody reads them.
 class Logger : public QObject
 {
 Q_OBJECT
 public:
-	Logger();
+	enum Level { LevelDebug, LevelInfo, LevelWarning, LevelError };
+	
+	struct Record
+	{
+		// increases by one with every record of the logger
+		qint64 seq;
+		// milliseconds since the epoch
+		qint64 time;
+		Level level;
+		QString sender, message;
+	};
+	
+	Logger(int capacity = 1000);
 	~Logger();
 
 	Q_INVOKABLE QString logContents() const;
 	Q_PROPERTY(QString logContents READ logContents)
+	// Formats the records with sequence numbers from "since" on;
+	// "next" receives the value to pass in the next call
+	QString logContents(qint64 since, qint64* next) const;
+	QList<Record> records(qint64 since = 0, qint64* next = 0) const;
+	// the sequence number the next record will get
+	qint64 nextSequence() const;
+	
+	static QString format(const Record& record);
 	static Logger* global() { return &m_global; }
 
+	// passes the records to the asynchronous syslog/file sink
+	void toggleSink(bool on);
 	void toggleSysLog(bool on);
+	
+	void enterLogMessage(Level level, QString sender, QString msg);
 public slots:
 	void enterLogMessage(QString msg);
 	void enterLogMessage(QString sender, QString msg);
-signals:
-	void logMessage(QString msg);
 private:
-	QString m_strLog;
-	bool m_bSysLog;
-	mutable QReadWriteLock m_lock;
+	QVector<Record> m_records;
+	int m_nCapacity;
+	qint64 m_nNext;
+	bool m_bSink;
+	mutable QMutex m_lock;
 	static Logger m_global;
 };
 
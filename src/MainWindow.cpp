@@ -39,11 +39,13 @@ respects for all of the code used other than "OpenSSL".
 #include <QUrl>
 #include <QApplication>
 #include <QClipboard>
+#include <QScrollBar>
 
 #include "MainWindow.h"
 #include "QueueDlg.h"
 #include "Queue.h"
 #include "QueueMgr.h"
+#include "TickService.h"
 #include "engines/FakeDownload.h"
 #include "WidgetHostDlg.h"
 #include "NewTransferDlg.h"
@@ -93,7 +95,7 @@ static QList<QPair<QWidget*,bool> > m_statusWidgets;
 using namespace std;
 
 MainWindow::MainWindow(bool bStartHidden)
-	: m_timer(0), m_trayIcon(this), m_pDetailsDisplay(0), m_lastTransfer(0), m_dlgNewTransfer(0)
+	: m_trayIcon(this), m_pDetailsDisplay(0), m_lastTransfer(0), m_dlgNewTransfer(0)
 {
 	setupUi();
 	restoreWindowState(bStartHidden && m_trayIcon.isVisible());
@@ -133,6 +135,7 @@ void MainWindow::setupUi()
 	m_modelTransfers = new TransfersModel(this);
 	treeTransfers->setModel(m_modelTransfers);
 	treeTransfers->setItemDelegate(new ProgressDelegate(treeTransfers));
+	connect(treeTransfers->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(transfersScrolled()));
 	
 	m_trayIcon.setIcon(QIcon(":/fatrat/fatrat.png"));
 	m_trayIcon.setToolTip("FatRat");
@@ -620,11 +623,31 @@ void MainWindow::updateUi()
 	if(q != 0)
 		doneQueue(q,true,false);
 	
+	updateVisibleTransfers();
 	m_modelTransfers->refresh();
 	if(currentTab == 1)
 		refreshDetailsTab();
 }
 
+void MainWindow::updateVisibleTransfers()
+{
+	QModelIndex first = treeTransfers->indexAt(QPoint(0, 0));
+	QModelIndex last = treeTransfers->indexAt(QPoint(0, treeTransfers->viewport()->height()-1));
+	int firstRow = first.isValid() ? first.row() : 0;
+	
+	// the rows don't reach the bottom of the view
+	if(!last.isValid())
+		last = m_modelTransfers->index(firstRow + treeTransfers->viewport()->height()/16);
+	
+	m_modelTransfers->setVisibleRows(firstRow, last.row());
+}
+
+void MainWindow::transfersScrolled()
+{
+	updateVisibleTransfers();
+	m_modelTransfers->refresh();
+}
+
 void MainWindow::refreshQueues()
 {
 	g_queuesLock.lockForRead();
@@ -656,15 +679,20 @@ void MainWindow::refreshQueues()
 	int upq = 0, downq = 0;
 	int cur = getSelectedQueue();
 	
+	QList<QueueSnapshot> snapshots;
 	for(int j=0;j<g_queues.size();j++)
+		snapshots << g_queues[j]->snapshot();
+	
+	g_queuesLock.unlock();
+	
+	for(int j=0;j<snapshots.size();j++)
 	{
-		Queue* q = g_queues[j];
-		q->lock();
+		const QueueSnapshot& q = snapshots[j];
 		
-		for(int i=0;i<q->size();i++)
+		for(int i=0;i<q.size();i++)
 		{
 			int up,down;
-			q->at(i)->speeds(down,up);
+			q.at(i)->speeds(down,up);
 			downt += down;
 			upt += up;
 			
@@ -674,12 +702,8 @@ void MainWindow::refreshQueues()
 				upq += up;
 			}
 		}
-		
-		q->unlock();
 	}
 	
-	g_queuesLock.unlock();
-	
 	m_labelStatus.setText( QString(tr("Queue's speed: %1 down, %2 up")).arg(formatSize(downq,true)).arg(formatSize(upq,true)) );
 }
 
@@ -882,6 +906,7 @@ void MainWindow::move(int i)
 		model->blockSignals(true);
 		model->clearSelection();
 		
+		q->beginBatch();
 		switch(i)
 		{
 			case 0:
@@ -935,6 +960,7 @@ void MainWindow::move(int i)
 				break;
 			}
 		}
+		q->endBatch();
 		
 		model->blockSignals(false);
 	}
@@ -1172,10 +1198,10 @@ void MainWindow::deleteTransfer()
 		{
 			treeTransfers->selectionModel()->clearSelection();
 			
-			q->lockW();
+			q->beginBatch();
 			for(int i=0;i<sel.size();i++)
 				q->remove(sel[i]-i, true);
-			q->unlock();
+			q->endBatch();
 			Queue::saveQueuesAsync();
 		}
 	}
@@ -1198,12 +1224,12 @@ void MainWindow::deleteTransferData()
 		{
 			treeTransfers->selectionModel()->clearSelection();
 			
-			q->lockW();
+			q->beginBatch();
 			//bool bOK = true;
 			
 			for(int i=0;i<sel.size();i++)
 				/*bOK &=*/ q->removeWithData(sel[i]-i, true);
-			q->unlock();
+			q->endBatch();
 			Queue::saveQueuesAsync();
 			
 			/*if(!bOK)
@@ -1404,7 +1430,7 @@ void MainWindow::removeCompleted()
 	}
 	
 	q = getCurrentQueue(false);
-	q->lockW();
+	q->beginBatch();
 	
 	for(int i=0;i<q->size();i++)
 	{
@@ -1413,7 +1439,7 @@ void MainWindow::removeCompleted()
 			q->remove(i--,true);
 	}
 	
-	q->unlock();
+	q->endBatch();
 	
 	doneQueue(q, false, true);
 }
@@ -1763,14 +1789,13 @@ void MainWindow::showHelp()
 
 void MainWindow::applySettings()
 {
-	delete m_timer;	
-	m_timer = new QTimer(this);
-	
-	m_timer->start(getSettingsValue("gui_refresh").toInt());
+	TickService* ticks = TickService::instance();
+	ticks->applySettings();
 	
-	connect(m_timer, SIGNAL(timeout()), this, SLOT(updateUi()));
-	connect(m_timer, SIGNAL(timeout()), this, SLOT(refreshQueues()));
-	connect(m_timer, SIGNAL(timeout()), widgetStats, SLOT(refresh()));
+	// the connections are unique, so repeated calls don't multiply refreshes
+	connect(ticks, SIGNAL(guiTick()), this, SLOT(updateUi()), Qt::UniqueConnection);
+	connect(ticks, SIGNAL(guiTick()), this, SLOT(refreshQueues()), Qt::UniqueConnection);
+	connect(ticks, SIGNAL(guiTick()), widgetStats, SLOT(refresh()), Qt::UniqueConnection);
 
 #ifdef WITH_JPLUGINS
 	bool now = m_extensionCheckTimer.isActive();
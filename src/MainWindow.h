@@ -120,6 +120,7 @@ public slots:
 	void showHelp();
 	void reportBug();
 	void filterTextChanged(const QString& text);
+	void transfersScrolled();
 #ifdef WITH_JPLUGINS
 	void showPremiumStatus();
 	void premiumStatusClosed();
@@ -149,10 +150,10 @@ protected:
 	void showTrayIcon();
 	void transferOpen(bool bOpenFile);
 	void initAppTools(QMenu* menu);
+	void updateVisibleTransfers();
 
 	static QPixmap grayscalePixmap(QPixmap in);
 private:
-	QTimer* m_timer;
 	MyTrayIcon m_trayIcon;
 	QMenu m_trayIconMenu;
 	TransfersModel* m_modelTransfers;
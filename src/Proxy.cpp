@@ -25,11 +25,18 @@ respects for all of the code used other than "OpenSSL".
 */
 
 #include "Proxy.h"
+#include "Settings.h"
 #include <QSettings>
+#include <QHash>
+#include <QMutex>
 #include <QtDebug>
 
 extern QSettings* g_settings;
 
+static QMutex m_cacheLock;
+static QHash<QUuid, Proxy> m_cachedProxys;
+static int m_nCacheGeneration = -1;
+
 QList<Proxy> Proxy::loadProxys()
 {
 	QList<Proxy> r;
@@ -60,29 +67,19 @@ Proxy Proxy::getProxy(QUuid uuid)
 	if(uuid.isNull())
 		return Proxy();
 	
-	int count = g_settings->beginReadArray("httpftp/proxys");
-	for(int i=0;i<count;i++)
+	QMutexLocker l(&m_cacheLock);
+	const int gen = g_settingsGeneration.loadAcquire();
+	
+	// called for every new connection, the list is only re-read after a settings change
+	if(gen != m_nCacheGeneration)
 	{
-		Proxy p;
-		g_settings->setArrayIndex(i);
-		
-		p.uuid = g_settings->value("uuid").toString();
-		if(p.uuid != uuid)
-			continue;
-		
-		p.strName = g_settings->value("name").toString();
-		p.strIP = g_settings->value("ip").toString();
-		p.nPort = g_settings->value("port").toUInt();
-		p.strUser = g_settings->value("user").toString();
-		p.strPassword = g_settings->value("password").toString();
-		p.nType = (Proxy::ProxyType) g_settings->value("type",0).toInt();
-		
-		g_settings->endArray();
-		return p;
+		m_cachedProxys.clear();
+		foreach(const Proxy& p, loadProxys())
+			m_cachedProxys[p.uuid] = p;
+		m_nCacheGeneration = gen;
 	}
 	
-	g_settings->endArray();
-	return Proxy();
+	return m_cachedProxys.value(uuid);
 }
 
 Proxy::operator QNetworkProxy() const
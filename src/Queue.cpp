@@ -24,18 +24,25 @@ executables. You must obey the GNU General Public License in all
 respects for all of the code used other than "OpenSSL".
 */
 
+#include "config.h"
 #include "fatrat.h"
 #include "Queue.h"
 #include "QueueMgr.h"
 #include "Settings.h"
+#include "TransferIndex.h"
 #include "engines/PlaceholderTransfer.h"
+#ifdef WITH_BITTORRENT
+#	include "engines/TorrentDownload.h"
+#endif
 #include <unistd.h>
 #include <QList>
 #include <QReadWriteLock>
 #include <QDir>
 #include <QFile>
 #include <QDomDocument>
+#include <QDateTime>
 #include <QtDebug>
+#include <QCoreApplication>
 
 using namespace std;
 
@@ -46,24 +53,40 @@ bool Queue::m_bLoaded = false;
 
 Queue::Queue()
 	: m_nDownLimit(0), m_nUpLimit(0), m_nDownTransferLimit(1), m_nUpTransferLimit(1),
-	m_nDownAuto(0), m_nUpAuto(0), m_bUpAsDown(false), m_lock(QReadWriteLock::Recursive)
+	m_nDownAuto(0), m_nUpAuto(0), m_bUpAsDown(false), m_lock(QReadWriteLock::Recursive),
+	m_speedHistory(new SpeedHistory), m_index(new TransferIndex(this)), m_nBatch(0), m_bUnpublished(false)
 {
 	memset(&m_stats, 0, sizeof m_stats);
 	m_uuid = QUuid::createUuid();
 	m_strDefaultDirectory = QDir::homePath();
+	publish();
 }
 
 Queue::~Queue()
 {
 	QWriteLocker l(&m_lock);
 	qDebug() << "Queue::~Queue()";
-	qDeleteAll(m_transfers);
+	
+	// someone may still be iterating an older snapshot
+	foreach(Transfer* t, m_transfers)
+		retire(t);
+	m_transfers.clear();
+	publish();
+	
+	QMutexLocker ls(&m_snapshotLock);
+	m_snapshot = QueueSnapshot();
+	ls.unlock();
+	
+	delete m_speedHistory;
 }
 
 void Queue::unloadQueues()
 {
 	qDebug() << "Queue::unloadQueues()";
 	qDeleteAll(g_queues);
+	
+	// the event loop has already finished, delete the retired transfers now
+	QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
 }
 
 void Queue::stopQueues()
@@ -84,15 +107,14 @@ void Queue::stopQueues()
 	}
 }
 
-void Queue::loadQueues()
+static bool readQueueFile(QDomDocument& doc)
 {
-	QDomDocument doc;
 	QFile file;
 	QDir dir = QDir::home();
 	
 	dir.mkpath(".local/share/fatrat");
 	if(!dir.cd(".local/share/fatrat"))
-		return;
+		return false;
 	file.setFileName(dir.absoluteFilePath("queues.xml"));
 	
 	QString errmsg;
@@ -101,7 +123,79 @@ void Queue::loadQueues()
 		qDebug() << "Failed to open " << file.fileName();
 		if(!errmsg.isEmpty())
 			qDebug() << "PARSE ERROR!" << errmsg;
+		return false;
+	}
+	
+#ifdef WITH_BITTORRENT
+	// the torrent files are parsed meanwhile, it is the slowest part of loading
+	QStringList torrents;
+	QDomElement q = doc.documentElement().firstChildElement("queue");
+	while(!q.isNull())
+	{
+		QDomElement n = q.firstChildElement("download");
+		while(!n.isNull())
+		{
+			if(n.attribute("class") == "TorrentDownload")
+			{
+				// inactive torrents stay out of the session, their files are parsed on demand
+				Transfer::State state = Transfer::string2state(Transfer::getXMLProperty(n, "state"));
+				bool attached = state == Transfer::Active || state == Transfer::ForcedActive
+						|| Transfer::getXMLProperty(n, "name").isEmpty();
+				QString file = Transfer::getXMLProperty(n, "torrent_file");
+				if(attached && !file.isEmpty())
+					torrents << file;
+			}
+			n = n.nextSiblingElement("download");
+		}
+		q = q.nextSiblingElement("queue");
+	}
+	TorrentDownload::preloadTorrentFiles(torrents);
+#endif
+	
+	return true;
+}
+
+class QueuePreloader : public QThread
+{
+public:
+	virtual void run()
+	{
+		m_bOK = readQueueFile(m_doc);
+	}
+	
+	QDomDocument m_doc;
+	bool m_bOK;
+};
+
+static QueuePreloader* m_preloader = 0;
+
+void Queue::preloadQueues()
+{
+	if(m_preloader)
+		return;
+	m_preloader = new QueuePreloader;
+	m_preloader->start();
+}
+
+void Queue::loadQueues()
+{
+	QDomDocument doc;
+	bool bOK;
+	
+	if(m_preloader)
+	{
+		m_preloader->wait();
+		doc = m_preloader->m_doc;
+		bOK = m_preloader->m_bOK;
 		
+		delete m_preloader;
+		m_preloader = 0;
+	}
+	else
+		bOK = readQueueFile(doc);
+	
+	if(!bOK)
+	{
 		// default queue for new users
 		Queue* q = new Queue;
 		q->setName(QObject::tr("Main queue"));
@@ -133,6 +227,13 @@ void Queue::loadQueues()
 				pQueue->m_strDefaultDirectory = n.attribute("defaultdir", pQueue->m_strDefaultDirectory);
 				pQueue->m_strMoveDirectory = n.attribute("movedir");
 				
+				QDomElement hist = n.firstChildElement("speedhistory");
+				if(!hist.isNull() && getSettingsValue("graph_persist").toBool())
+				{
+					pQueue->m_speedHistory->load(QByteArray::fromBase64(hist.text().toLatin1()),
+						hist.attribute("saved").toLongLong());
+				}
+				
 				pQueue->loadQueue(n);
 				g_queues << pQueue;
 			}
@@ -197,6 +298,14 @@ void Queue::saveQueues()
 		elem.setAttribute("defaultdir",q->m_strDefaultDirectory);
 		elem.setAttribute("movedir",q->m_strMoveDirectory);
 		
+		if(getSettingsValue("graph_persist").toBool())
+		{
+			QDomElement hist = doc.createElement("speedhistory");
+			hist.setAttribute("saved", QString::number(QDateTime::currentDateTime().toTime_t()));
+			hist.appendChild(doc.createTextNode(QString::fromLatin1(q->m_speedHistory->save().toBase64())));
+			elem.appendChild(hist);
+		}
+		
 		q->saveQueue(elem,doc);
 		root.appendChild(elem);
 	}
@@ -220,6 +329,7 @@ void Queue::loadQueue(const QDomNode& node)
 	m_lock.lockForWrite();
 	
 	qDeleteAll(m_transfers);
+	m_transfers.clear();
 	
 	QDomElement n = node.firstChildElement("download");
 	while(!n.isNull())
@@ -255,6 +365,7 @@ void Queue::loadQueue(const QDomNode& node)
 		n = n.nextSiblingElement("download");
 	}
 	
+	publish();
 	m_lock.unlock();
 }
 
@@ -289,10 +400,81 @@ Transfer* Queue::at(int r)
 		return m_transfers[r];
 }
 
+QueueSnapshot Queue::snapshot() const
+{
+	QMutexLocker l(&m_snapshotLock);
+	return m_snapshot;
+}
+
+void Queue::beginBatch()
+{
+	m_lock.lockForWrite();
+	m_nBatch++;
+}
+
+void Queue::endBatch()
+{
+	if(!--m_nBatch && m_bUnpublished)
+		publish();
+	m_lock.unlock();
+}
+
+void Queue::publish()
+{
+	// every publish copies the whole list, a batch does it only once
+	if(m_nBatch)
+	{
+		m_bUnpublished = true;
+		return;
+	}
+	m_bUnpublished = false;
+	
+	QueueSnapshot snap;
+	
+	snap.d = new QueueSnapshot::Data;
+	snap.d->transfers = m_transfers;
+	
+	QMutexLocker l(&m_snapshotLock);
+	if(m_snapshot.d)
+	{
+		m_snapshot.d->next = snap.d;
+		m_snapshot.d->retired += m_retired;
+		m_retired.clear();
+	}
+	
+	// the previous snapshot dies here unless someone is still reading it
+	m_snapshot = snap;
+}
+
+void Queue::retire(Transfer* t)
+{
+	QMutexLocker l(&m_snapshotLock);
+	m_retired << t;
+}
+
+QueueSnapshot::Data::~Data()
+{
+	foreach(Transfer* t, retired)
+		t->deleteLater();
+	
+	// Free the newer snapshots only referenced through this one here,
+	// letting each of them free the next would recurse along the chain
+	QExplicitlySharedDataPointer<Data> n = next;
+	next.reset();
+	
+	while(n && n->ref.load() == 1)
+	{
+		QExplicitlySharedDataPointer<Data> after = n->next;
+		n->next.reset();
+		n = after;
+	}
+}
+
 void Queue::add(Transfer* d)
 {
 	m_lock.lockForWrite();
 	m_transfers << d;
+	publish();
 	m_lock.unlock();
 }
 
@@ -300,6 +482,7 @@ void Queue::add(QList<Transfer*> d)
 {
 	m_lock.lockForWrite();
 	m_transfers << d;
+	publish();
 	m_lock.unlock();
 }
 
@@ -310,6 +493,7 @@ int Queue::moveDown(int n, bool nolock)
 		if (!nolock)
 			m_lock.lockForWrite();
 		m_transfers.swap(n,n+1);
+		publish();
 		if (!nolock)
 			m_lock.unlock();
 		
@@ -326,6 +510,7 @@ int Queue::moveUp(int n, bool nolock)
 		if (!nolock)
 			m_lock.lockForWrite();
 		m_transfers.swap(n-1,n);
+		publish();
 		if (!nolock)
 			m_lock.unlock();
 		return n-1;
@@ -345,6 +530,7 @@ void Queue::moveToPos(int from, int to, bool nolock)
 		m_lock.lockForWrite();
 	t = m_transfers.takeAt(from);
 	m_transfers.insert(to, t);
+	publish();
 	if (!nolock)
 		m_lock.unlock();
 }
@@ -354,6 +540,7 @@ void Queue::moveToTop(int n, bool nolock)
 	if (!nolock)
 		m_lock.lockForWrite();
 	m_transfers.prepend(m_transfers.takeAt(n));
+	publish();
 	if (!nolock)
 		m_lock.unlock();
 }
@@ -363,6 +550,7 @@ void Queue::moveToBottom(int n, bool nolock)
 	if (!nolock)
 		m_lock.lockForWrite();
 	m_transfers.append(m_transfers.takeAt(n));
+	publish();
 	if (!nolock)
 		m_lock.unlock();
 }
@@ -374,7 +562,10 @@ Transfer* Queue::take(int n, bool nolock)
 	if(!nolock)
 		m_lock.lockForWrite();
 	if(n < size() && n >= 0)
+	{
 		d = m_transfers.takeAt(n);
+		publish();
+	}
 	if(!nolock)
 		m_lock.unlock();
 	
@@ -383,16 +574,43 @@ Transfer* Queue::take(int n, bool nolock)
 
 void Queue::remove(int n, bool nolock)
 {
-	Transfer* d = take(n, nolock);
+	if(!nolock)
+		m_lock.lockForWrite();
+	
+	Transfer* d = m_transfers.takeAt(n);
+	retire(d);
+	publish();
+	
+	if(!nolock)
+		m_lock.unlock();
 	
 	if(d->isActive())
 		d->setState(Transfer::Paused);
-	d->deleteLater();
+}
+
+bool Queue::remove(Transfer* t)
+{
+	QWriteLocker l(&m_lock);
+	int i = m_transfers.indexOf(t);
+	
+	if(i == -1)
+		return false;
+	
+	remove(i, true);
+	return true;
 }
 
 void Queue::removeWithData(int n, bool nolock)
 {
-	Transfer* d = take(n, nolock);
+	if(!nolock)
+		m_lock.lockForWrite();
+	
+	Transfer* d = m_transfers.takeAt(n);
+	retire(d);
+	publish();
+	
+	if(!nolock)
+		m_lock.unlock();
 	
 	if(d->isActive())
 		d->setState(Transfer::Paused);
@@ -401,8 +619,6 @@ void Queue::removeWithData(int n, bool nolock)
 	
 	if(!path.isEmpty() && d->primaryMode() == Transfer::Download)
 		recursiveRemove(path);
-	
-	d->deleteLater();
 }
 
 void Queue::setAutoLimits(int down, int up)
@@ -410,7 +626,7 @@ void Queue::setAutoLimits(int down, int up)
 	m_nDownAuto = down;
 	m_nUpAuto = up;
 	
-	foreach(Transfer* d, m_transfers)
+	foreach(Transfer* d, snapshot().transfers())
 	{
 		if(!d->isActive())
 			continue;
@@ -465,9 +681,9 @@ bool Queue::replace(Transfer* old, Transfer* _new)
 	int i = m_transfers.indexOf(old);
 	if (i == -1)
 		return false;
-	Transfer* t = m_transfers[i];
+	retire(m_transfers[i]);
 	m_transfers[i] = _new;
-	t->deleteLater();
+	publish();
 	return true;
 }
 
@@ -477,10 +693,11 @@ bool Queue::replace(Transfer* old, QList<Transfer*> _new)
 	int i = m_transfers.indexOf(old);
 	if (i == -1)
 		return false;
-	m_transfers.takeAt(i)->deleteLater();
+	retire(m_transfers.takeAt(i));
 
 	for (int j = 0; j < _new.size(); j++)
 		m_transfers.insert(i+j, _new[j]);
+	publish();
 	return true;
 }
 
@@ -510,21 +727,16 @@ void Queue::resumeAll()
 void Queue::updateGraph()
 {
 	int downq = 0, upq = 0;
+	const QueueSnapshot snap = snapshot();
 
-	lock();
-
-	for(int i=0;i<size();i++)
+	for(int i=0;i<snap.size();i++)
 	{
 		int up,down;
-		at(i)->speeds(down,up);
+		snap.at(i)->speeds(down,up);
 
 		downq += down;
 		upq += up;
 	}
 
-	unlock();
-
-	if(m_qSpeedData.size() >= getSettingsValue("graphminutes").toInt()*60)
-		m_qSpeedData.dequeue();
-	m_qSpeedData.enqueue(QPair<int,int>(downq,upq));
+	m_speedHistory->add(downq, upq);
 }
@@ -33,12 +33,52 @@ respects for all of the code used other than "OpenSSL".
 #include <QPair>
 #include <QUuid>
 #include <QThread>
+#include <QMutex>
+#include <QSharedData>
 #include "Transfer.h"
+#include "SpeedHistory.h"
 
 class Queue;
+class TransferIndex;
 extern QList<Queue*> g_queues;
 extern QReadWriteLock g_queuesLock;
 
+// An immutable list of a queue's transfers as it was at some point.
+// It can be iterated without holding any lock; transfers removed from
+// the queue in the meantime are only deleted once no snapshot containing
+// them exists anymore.
+class QueueSnapshot
+{
+public:
+	QueueSnapshot() {}
+	
+	int size() const { return d ? d->transfers.size() : 0; }
+	bool isEmpty() const { return size() == 0; }
+	Transfer* at(int i) const { return d->transfers[i]; }
+	int indexOf(Transfer* t) const { return d ? d->transfers.indexOf(t) : -1; }
+	QList<Transfer*> transfers() const { return d ? d->transfers : QList<Transfer*>(); }
+	// true if both snapshots have been taken without any change in between
+	bool operator==(const QueueSnapshot& o) const { return d == o.d; }
+	bool operator!=(const QueueSnapshot& o) const { return d != o.d; }
+private:
+	class Data : public QSharedData
+	{
+	public:
+		~Data();
+		
+		QList<Transfer*> transfers;
+		// transfers removed right after this snapshot had been taken
+		QList<Transfer*> retired;
+		// keeps newer snapshots alive, so that a retired transfer outlives
+		// every older snapshot too
+		QExplicitlySharedDataPointer<Data> next;
+	};
+	
+	QExplicitlySharedDataPointer<Data> d;
+	
+	friend class Queue;
+};
+
 class Queue : public QObject
 {
 Q_OBJECT
@@ -47,6 +87,8 @@ public:
 	~Queue();
 	
 	static void stopQueues();
+	// reads and parses queues.xml on a background thread, loadQueues() picks up the result
+	static void preloadQueues();
 	static void loadQueues();
 	static void saveQueues();
 	static void saveQueuesAsync();
@@ -83,9 +125,16 @@ public:
 	void lock() { m_lock.lockForRead(); }
 	void lockW() { m_lock.lockForWrite(); }
 	void unlock() { m_lock.unlock(); }
+	// Write-locks the queue and publishes a single snapshot for all the
+	// changes made until the matching endBatch(), they nest
+	void beginBatch();
+	void endBatch();
 	
 	Q_INVOKABLE Transfer* at(int r);
 	
+	// doesn't block on writers and doesn't make them wait
+	QueueSnapshot snapshot() const;
+	
 	Q_INVOKABLE void add(Transfer* d);
 	void add(QList<Transfer*> d);
 	
@@ -103,10 +152,14 @@ public:
 	void setAutoLimits(int down, int up);
 	
 	bool contains(Transfer* t) const;
+	// removes the transfer wherever it is now, returns false if it isn't in the queue
+	bool remove(Transfer* t);
 	void stopAll();
 	void resumeAll();
 
-	QQueue<QPair<int,int> > speedData() const { return m_qSpeedData; }
+	const SpeedHistory* speedHistory() const { return m_speedHistory; }
+	// searches the names, URLs and comments of the transfers
+	TransferIndex* searchIndex() const { return m_index; }
 public slots:
 	bool replace(Transfer* old, Transfer* _new);
 	bool replace(Transfer* old, QList<Transfer*> _new);
@@ -114,6 +167,12 @@ private:
 	void loadQueue(const QDomNode& node);
 	void saveQueue(QDomNode& node,QDomDocument& doc);
 	
+	// publishes m_transfers as the current snapshot, must follow every change
+	// (deferred inside a batch)
+	void publish();
+	// the transfer is deleted once all snapshots that contain it are gone
+	void retire(Transfer* t);
+	
 	QString m_strName, m_strDefaultDirectory, m_strMoveDirectory;
 	int m_nDownLimit,m_nUpLimit,m_nDownTransferLimit,m_nUpTransferLimit;
 	int m_nDownAuto, m_nUpAuto;
@@ -131,7 +190,14 @@ protected:
 	void updateGraph();
 
 	QList<Transfer*> m_transfers;
-	QQueue<QPair<int,int> > m_qSpeedData;
+	SpeedHistory* m_speedHistory;
+	TransferIndex* m_index;
+	
+	mutable QMutex m_snapshotLock;
+	QueueSnapshot m_snapshot;
+	QList<Transfer*> m_retired;
+	int m_nBatch;
+	bool m_bUnpublished;
 	
 	friend class QueueMgr;
 
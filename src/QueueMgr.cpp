@@ -27,8 +27,12 @@ respects for all of the code used other than "OpenSSL".
 #include "fatrat.h"
 #include "Settings.h"
 #include "QueueMgr.h"
+#include "TickService.h"
+#include "TransferScheduler.h"
 #include "RuntimeException.h"
 #include <QSettings>
+#include <QDateTime>
+#include <QSet>
 
 using namespace std;
 
@@ -38,17 +42,19 @@ extern QSettings* g_settings;
 
 QueueMgr* QueueMgr::m_instance = 0;
 
+static const CachedSetting<bool> g_autoRemove("autoremove");
+static const CachedSetting<bool> g_retryWorking("retryworking");
+static const CachedSetting<int> g_retryCount("retrycount");
+static const CachedSetting<bool> g_dropForcedOnUpload("drop_forced_on_upload");
+
 QueueMgr::QueueMgr() : m_nCycle(0), m_down(0), m_up(0)
 {
 	m_instance = this;
 	
-	m_timer = new QTimer(this);
-	connect(m_timer, SIGNAL(timeout()), this, SLOT(doWork()), Qt::DirectConnection);
+	connect(TickService::instance(), SIGNAL(secondTick()), this, SLOT(doWork()), Qt::DirectConnection);
 	
 	connect(TransferNotifier::instance(), SIGNAL(stateChanged(Transfer*,Transfer::State,Transfer::State)), this, SLOT(transferStateChanged(Transfer*,Transfer::State,Transfer::State)));
 	connect(TransferNotifier::instance(), SIGNAL(modeChanged(Transfer*,Transfer::Mode,Transfer::Mode)), this, SLOT(transferModeChanged(Transfer*,Transfer::Mode,Transfer::Mode)));
-	
-	m_timer->start(1000);
 }
 
 void QueueMgr::doWork()
@@ -56,7 +62,8 @@ void QueueMgr::doWork()
 	int total[2] = { 0, 0 };
 	g_queuesLock.lockForRead();
 	
-	const bool autoremove = getSettingsValue("autoremove").toBool();
+	const bool autoremove = g_autoRemove.value();
+	const qint64 now = QDateTime::currentDateTime().toTime_t();
 	
 	foreach(Queue* q,g_queues)
 	{
@@ -71,13 +78,16 @@ void QueueMgr::doWork()
 		q->speedLimits(down,up);
 		q->updateGraph();
 		
-		q->lock();
+		// works on a snapshot, the queue may be modified meanwhile
+		const QueueSnapshot snapshot = q->snapshot();
 		
-		QList<int> stopList, resumeList;
+		QList<Transfer*> stopList, resumeList;
+		QVector<TransferScheduler::Item> downItems, upItems;
+		QList<Transfer*> downTransfers, upTransfers;
 		
-		for(int i=0;i<q->m_transfers.size();i++)
+		for(int i=0;i<snapshot.size();i++)
 		{
-			Transfer* d = q->m_transfers[i];
+			Transfer* d = snapshot.at(i);
 			int downs,ups;
 			Transfer::State state = d->state();
 			Transfer::Mode mode = d->mode();
@@ -95,25 +105,30 @@ void QueueMgr::doWork()
 			
 			if(state == Transfer::Waiting || state == Transfer::Active)
 			{
-				int* lim;
+				TransferScheduler::Item item;
 				
-				if(mode == Transfer::Download || q->m_bUpAsDown)
-					lim = &lim_down;
-				else
-					lim = &lim_up;
+				item.priority = Transfer::Priority(d->priority());
+				item.deadline = d->deadline();
+				item.speed = (mode == Transfer::Download) ? downs : ups;
+				if(item.deadline > 0 && d->total())
+					item.remaining = qint64(d->total()) - qint64(d->done());
 				
-				if(*lim != 0)
+				if(mode == Transfer::Download || q->m_bUpAsDown)
 				{
-					(*lim)--;
-					resumeList << i;
+					downItems << item;
+					downTransfers << d;
 				}
 				else
-					stopList << i;
+				{
+					upItems << item;
+					upTransfers << d;
+				}
 			}
 			else if(state == Transfer::Completed && autoremove)
 			{
 				doMove(q, d);
-				q->remove(i--, true);
+				q->remove(d);
+				continue;
 			}
 			
 			if(d->isActive())
@@ -125,10 +140,37 @@ void QueueMgr::doWork()
 				( (mode == Transfer::Download) ? stats.waiting_d : stats.waiting_u) ++;
 		}
 		
-		foreach(int x, stopList)
-			q->m_transfers[x]->setState(Transfer::Waiting);
-		foreach(int x, resumeList)
-			q->m_transfers[x]->setState(Transfer::Active);
+		// without priorities and deadlines this is the plain queue order
+		TransferScheduler::schedule(downItems, lim_down, down, now);
+		TransferScheduler::schedule(upItems, lim_up, up, now);
+		
+		const bool scheduled = !TransferScheduler::isTrivial(downItems) || !TransferScheduler::isTrivial(upItems);
+		
+		for(int j=0;j<downItems.size();j++)
+			(downItems[j].active ? resumeList : stopList) << downTransfers[j];
+		for(int j=0;j<upItems.size();j++)
+			(upItems[j].active ? resumeList : stopList) << upTransfers[j];
+		
+		{
+			// a transfer may have been removed since the snapshot was taken
+			QReadLocker l(&q->m_lock);
+			QSet<Transfer*> present;
+			const bool changed = q->snapshot() != snapshot;
+			
+			if(changed)
+				present = q->m_transfers.toSet();
+			
+			foreach(Transfer* x, stopList)
+			{
+				if(!changed || present.contains(x))
+					x->setState(Transfer::Waiting);
+			}
+			foreach(Transfer* x, resumeList)
+			{
+				if(!changed || present.contains(x))
+					x->setState(Transfer::Active);
+			}
+		}
 		
 		total[0] += stats.down;
 		total[1] += stats.up;
@@ -189,11 +231,20 @@ void QueueMgr::doWork()
 			
 			//qDebug() << "Setting" << curu;
 			q->setAutoLimits(curd, curu);
+			
+			if(scheduled)
+			{
+				// the scheduler's shares replace the even split of the download bandwidth
+				for(int j=0;j<downItems.size();j++)
+				{
+					Transfer* d = downTransfers[j];
+					if(downItems[j].active && d->isActive() && d->mode() == Transfer::Download)
+						d->setInternalSpeedLimits(downItems[j].limit, curu);
+				}
+			}
 		}
 		
 		q->m_stats = stats;
-		
-		q->unlock();
 	}
 	
 	g_queuesLock.unlock();
@@ -227,7 +278,7 @@ void QueueMgr::doMove(Queue* q, Transfer* t)
 
 void QueueMgr::transferStateChanged(Transfer* t, Transfer::State, Transfer::State now)
 {
-	const bool autoremove = getSettingsValue("autoremove").toBool();
+	const bool autoremove = g_autoRemove.value();
 	if(now == Transfer::Completed)
 	{
 		if(autoremove)
@@ -239,9 +290,9 @@ void QueueMgr::transferStateChanged(Transfer* t, Transfer::State, Transfer::Stat
 	else if(now == Transfer::Failed)
 	{
 		bool bRetry = false;
-		if(g_settings->value("retryworking", getSettingsDefault("retryworking")).toBool())
+		if(g_retryWorking.value())
 			bRetry = t->m_bWorking;
-		else if(g_settings->value("retrycount", getSettingsDefault("retrycount")).toInt() > t->m_nRetryCount)
+		else if(g_retryCount.value() > t->m_nRetryCount)
 			bRetry = true;
 		
 		if(bRetry)
@@ -256,7 +307,7 @@ void QueueMgr::transferModeChanged(Transfer* t, Transfer::Mode prev, Transfer::M
 {
 	if (t->state() == Transfer::ForcedActive && now == Transfer::Upload && prev == Transfer::Download)
 	{
-		if (getSettingsValue("drop_forced_on_upload").toBool())
+		if (g_dropForcedOnUpload.value())
 			t->setState(Transfer::Active);
 	}
 }
@@ -274,7 +325,7 @@ Queue* QueueMgr::findQueue(Transfer* t)
 
 void QueueMgr::exit()
 {
-	delete m_timer;
+	disconnect(TickService::instance(), 0, this, 0);
 	
 	QReadLocker l(&g_queuesLock);
 	foreach(Queue* q,g_queues)
@@ -27,7 +27,6 @@ respects for all of the code used other than "OpenSSL".
 #ifndef _QUEUEMGR_H
 #define _QUEUEMGR_H
 #include <QThread>
-#include <QTimer>
 #include "Queue.h"
 #include <QSettings>
 #include <QMap>
@@ -56,7 +55,6 @@ public slots:
 	void transferModeChanged(Transfer*,Transfer::Mode,Transfer::Mode);
 private:
 	static QueueMgr* m_instance;
-	QTimer* m_timer;
 	int m_nCycle;
 	int m_down, m_up;
 
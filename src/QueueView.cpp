@@ -68,12 +68,12 @@ bool QueueView::dropMimeData(QTreeWidgetItem* parent, int index, const QMimeData
 		if(queueFrom != queueTo && queueTo < g_queues.size())
 		{
 			q = g_queues[queueFrom];
-			q->lockW();
+			q->beginBatch();
 			
 			for(int i=0;i<transfers.size();i++)
 				objects << q->take(transfers[i]-i, true);
 			
-			q->unlock();
+			q->endBatch();
 			
 			q = g_queues[queueTo];
 			q->add(objects);
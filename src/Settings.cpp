@@ -48,6 +48,7 @@ respects for all of the code used other than "OpenSSL".
 
 QVector<SettingsItem> g_settingsPages;
 QSettings* g_settings = 0;
+QAtomicInt g_settingsGeneration(0);
 
 static QSettings* m_settingsDefaults = 0;
 
@@ -158,6 +159,7 @@ void setSettingsArray(QString id, QList<QMap<QString, QVariant> >& value)
 			g_settings->setValue(it.key(), it.value());
 	}
 	g_settings->endArray();
+	invalidateSettingsCache();
 }
 
 QVariant getSettingsValue(QString id, QVariant def)
@@ -171,6 +173,12 @@ QVariant getSettingsValue(QString id, QVariant def)
 void setSettingsValue(QString id, QVariant value)
 {
 	g_settings->setValue(id, value);
+	invalidateSettingsCache();
+}
+
+void invalidateSettingsCache()
+{
+	g_settingsGeneration.fetchAndAddOrdered(1);
 }
 
 void initSettingsDefaults(QString manualPath)
@@ -207,6 +215,8 @@ QVariant getSettingsDefault(QString id)
 
 void applyAllSettings()
 {
+	invalidateSettingsCache();
+	
 	for (int i = 0; i < g_settingsPages.size(); i++)
 	{
 		if (g_settingsPages[i].pfnApply) {
@@ -29,6 +29,8 @@ respects for all of the code used other than "OpenSSL".
 #include <QString>
 #include <QIcon>
 #include <QSettings>
+#include <QAtomicInt>
+#include <QAtomicInteger>
 #include "config.h"
 #include "WidgetHostChild.h"
 #include "DelayedIcon.h"
@@ -75,4 +77,35 @@ void setSettingsArray(QString id, QList<QMap<QString, QVariant> >& value);
 void initSettingsDefaults(QString manualPath = QString());
 void exitSettings();
 
+// Makes all CachedSettings and other cached data re-read the settings,
+// done automatically by setSettingsValue() and applyAllSettings()
+void invalidateSettingsCache();
+extern QAtomicInt g_settingsGeneration;
+
+// Typed access to a setting read on a hot path. The value is parsed once
+// and reused until the settings change; reading it takes no lock.
+// Only for integral types (int, bool, qint64...).
+template <typename T> class CachedSetting
+{
+public:
+	explicit CachedSetting(const char* id) : m_id(id), m_generation(-1), m_value(0) {}
+	
+	T value() const
+	{
+		const int gen = g_settingsGeneration.loadAcquire();
+		
+		if (m_generation.loadAcquire() != gen)
+		{
+			m_value.store(qint64(qvariant_cast<T>(getSettingsValue(m_id))));
+			m_generation.storeRelease(gen);
+		}
+		return T(m_value.load());
+	}
+	operator T() const { return value(); }
+private:
+	const char* m_id;
+	mutable QAtomicInt m_generation;
+	mutable QAtomicInteger<qint64> m_value;
+};
+
 #endif
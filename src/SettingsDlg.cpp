@@ -82,6 +82,8 @@ void SettingsDlg::accept()
 	{
 		foreach(WidgetHostChild* w,m_children)
 			w->accepted();
+		// some pages write to g_settings directly
+		invalidateSettingsCache();
 		
 		QDialog::accept();
 		
@@ -112,6 +114,7 @@ void SettingsDlg::buttonClicked(QAbstractButton* btn)
 		
 		foreach(WidgetHostChild* w,m_children)
 			w->accepted();
+		invalidateSettingsCache();
 		foreach(WidgetHostChild* w,m_children)
 			w->load();
 		
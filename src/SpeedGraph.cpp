@@ -28,16 +28,20 @@ respects for all of the code used other than "OpenSSL".
 #include "Queue.h"
 #include "Transfer.h"
 #include "Settings.h"
+#include "SpeedHistory.h"
+#include "TickService.h"
 #include "fatrat.h"
 #include <QtDebug>
 #include <QMenu>
 #include <QFileDialog>
 
+// read on every repaint
+static const CachedSetting<int> g_graphMinutes("graphminutes");
+static const CachedSetting<int> g_graphStyle("graph_style");
+
 SpeedGraph::SpeedGraph(QWidget* parent) : QWidget(parent), m_queue(0), m_transfer(0)
 {
-	m_timer = new QTimer(this);
-	connect(m_timer, SIGNAL(timeout()), this, SLOT(update()));
-	m_timer->start(getSettingsValue("gui_refresh").toInt());
+	connect(TickService::instance(), SIGNAL(guiTick()), this, SLOT(update()));
 }
 
 void SpeedGraph::setRenderSource(Transfer* t)
@@ -80,9 +84,9 @@ void SpeedGraph::saveScreenshot()
 	QImage image(size(), QImage::Format_RGB32);
 
 	if(m_transfer)
-		draw(m_transfer->speedData(), size(), &image);
+		draw(m_transfer->speedHistory(), size(), &image);
 	else if(m_queue)
-		draw(m_queue->speedData(), size(), &image);
+		draw(m_queue->speedHistory(), size(), &image);
 	else
 		return;
 
@@ -96,12 +100,12 @@ void SpeedGraph::saveScreenshot()
 	}
 }
 
-void SpeedGraph::draw(QQueue<QPair<int,int> > data, QSize size, QPaintDevice* device, QPaintEvent* event)
+void SpeedGraph::draw(const SpeedHistory* history, QSize size, QPaintDevice* device, QPaintEvent* event)
 {
 	int top = 0;
 	QPainter painter(device);
-	int seconds = getSettingsValue("graphminutes").toInt()*60;
-	bool bFilled = getSettingsValue("graph_style").toInt() == 0;
+	int seconds = g_graphMinutes.value()*60;
+	bool bFilled = g_graphStyle.value() == 0;
 
 	painter.setRenderHint(QPainter::Antialiasing);
 
@@ -113,17 +117,23 @@ void SpeedGraph::draw(QQueue<QPair<int,int> > data, QSize size, QPaintDevice* de
 	else
 		painter.fillRect(QRect(QPoint(0, 0), size), QBrush(Qt::white));
 
-	if(!data.size())
+	if(!history)
 	{
 		drawNoData(size, painter);
 		return;
 	}
+	
+	// long spans are drawn from the per-minute archive
+	const SpeedHistory::Resolution res = SpeedHistory::resolutionFor(seconds);
+	const int points = seconds / SpeedHistory::interval(res);
+	SpeedHistory::Reader data(history, res);
+	const int skip = qMax(0, data.size() - points);
 
-	for(int i=0;i<data.size();i++)
+	for(int i=skip;i<data.size();i++)
 	{
-		top = qMax(top, qMax(data[i].first,data[i].second));
+		top = qMax(top, qMax(data.at(i).down,data.at(i).up));
 	}
-	if(!top || data.size()<2)
+	if(!top || data.size()-skip<2)
 	{
 		drawNoData(size, painter);
 		return;
@@ -133,15 +143,15 @@ void SpeedGraph::draw(QQueue<QPair<int,int> > data, QSize size, QPaintDevice* de
 
 	const int height = size.height();
 	const int width = size.width();
-	const int elems = data.size();
-	qreal perpt = width / (qreal(qMax(elems,seconds))-1);
+	const int elems = data.size()-skip;
+	qreal perpt = width / (qreal(qMax(elems,points))-1);
 	qreal pos = width;
 	QVector<QLine> lines(elems);
 	QVector<QPoint> filler(elems+2);
 
-	for(int i = 0;i<data.size();i++) // download speed
+	for(int i = 0;i<elems;i++) // download speed
 	{
-		float y = height-height/qreal(top)*data[elems-i-1].first;
+		float y = height-height/qreal(top)*data.at(skip+elems-i-1).down;
 		filler[i] = QPoint(pos, y);
 		if(i > 0)
 			lines[i-1] = QLine(filler[i-1], filler[i]);
@@ -166,7 +176,7 @@ void SpeedGraph::draw(QQueue<QPair<int,int> > data, QSize size, QPaintDevice* de
 	pos = width;
 	for(int i = 0;i<elems;i++) // upload speed
 	{
-		float y = height-height/qreal(top)*data[elems-i-1].second;
+		float y = height-height/qreal(top)*data.at(skip+elems-i-1).up;
 		filler[i] = QPoint(pos, y);
 		if(i > 0)
 			lines[i-1] = QLine(filler[i-1], filler[i]);
@@ -214,9 +224,9 @@ void SpeedGraph::draw(QQueue<QPair<int,int> > data, QSize size, QPaintDevice* de
 void SpeedGraph::paintEvent(QPaintEvent* event)
 {
 	if(m_transfer)
-		draw(m_transfer->speedData(), size(), this, event);
+		draw(m_transfer->speedHistory(), size(), this, event);
         else if(m_queue)
-		draw(m_queue->speedData(), size(), this, event);
+		draw(m_queue->speedHistory(), size(), this, event);
 }
 
 void SpeedGraph::drawNoData(QSize size, QPainter& painter)
@@ -29,11 +29,10 @@ respects for all of the code used other than "OpenSSL".
 #include <QWidget>
 #include <QPainter>
 #include <QPaintEvent>
-#include <QQueue>
-#include <QTimer>
 
 class Transfer;
 class Queue;
+class SpeedHistory;
 
 class SpeedGraph : public QWidget
 {
@@ -42,7 +41,7 @@ public:
 	SpeedGraph(QWidget* parent);
 	void setRenderSource(Transfer* t);
 	void setRenderSource(Queue* q);
-	static void draw(QQueue<QPair<int,int> > data, QSize size, QPaintDevice* device, QPaintEvent* event = 0);
+	static void draw(const SpeedHistory* history, QSize size, QPaintDevice* device, QPaintEvent* event = 0);
 public slots:
 	void setNull() { setRenderSource((Queue*)NULL); }
 	void saveScreenshot();
@@ -53,7 +52,6 @@ protected:
 
 	Queue* m_queue;
 	Transfer* m_transfer;
-	QTimer* m_timer;
 };
 
 #endif
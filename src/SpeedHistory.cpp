@@ -0,0 +1,195 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "SpeedHistory.h"
+#include <QDataStream>
+#include <QDateTime>
+
+// half an hour of seconds and two days of minutes, about 37 KB in total
+static const int SECONDS_CAPACITY = 30*60;
+static const int MINUTES_CAPACITY = 2*24*60;
+// guards load() against corrupt data
+static const quint32 SAVE_MAGIC = 0x53504844;
+
+SpeedHistory::SpeedHistory(int span)
+	: m_nSpan(-1), m_nSumDown(0), m_nSumUp(0), m_nSummed(0)
+{
+	for (int i = 0; i < ResolutionCount; i++)
+		m_archives[i].first = m_archives[i].count = 0;
+	setSpan(span);
+}
+
+void SpeedHistory::setSpan(int span)
+{
+	QWriteLocker l(&m_lock);
+	
+	if (span < 0)
+		span = 0;
+	if (span == m_nSpan)
+		return;
+	
+	m_nSpan = span;
+	for (int i = 0; i < ResolutionCount; i++)
+	{
+		int cap = capacity(Resolution(i));
+		if (span)
+			cap = qBound(1, (span + interval(Resolution(i)) - 1) / interval(Resolution(i)), cap);
+		m_archives[i].resize(cap);
+	}
+}
+
+void SpeedHistory::Archive::resize(int cap)
+{
+	if (cap == samples.size())
+		return;
+	
+	QVector<Sample> newer(cap);
+	const int keep = qMin(count, cap);
+	
+	for (int i = 0; i < keep; i++)
+		newer[i] = at(count - keep + i);
+	
+	samples = newer;
+	first = 0;
+	count = keep;
+}
+
+void SpeedHistory::Archive::push(const Sample& s)
+{
+	const int cap = samples.size();
+	
+	if (count < cap)
+		samples[(first + count++) % cap] = s;
+	else
+	{
+		samples[first] = s;
+		first = (first + 1) % cap;
+	}
+}
+
+void SpeedHistory::add(int down, int up)
+{
+	QWriteLocker l(&m_lock);
+	Sample s = { down, up };
+	
+	m_archives[Seconds].push(s);
+	
+	m_nSumDown += down;
+	m_nSumUp += up;
+	
+	if (++m_nSummed >= interval(Minutes))
+	{
+		Sample avg = { int(m_nSumDown / m_nSummed), int(m_nSumUp / m_nSummed) };
+		m_archives[Minutes].push(avg);
+		m_nSumDown = m_nSumUp = 0;
+		m_nSummed = 0;
+	}
+}
+
+SpeedHistory::Resolution SpeedHistory::resolutionFor(int seconds)
+{
+	if (seconds <= capacity(Seconds) * interval(Seconds))
+		return Seconds;
+	return Minutes;
+}
+
+int SpeedHistory::interval(Resolution res)
+{
+	return (res == Minutes) ? 60 : 1;
+}
+
+int SpeedHistory::capacity(Resolution res)
+{
+	return (res == Minutes) ? MINUTES_CAPACITY : SECONDS_CAPACITY;
+}
+
+SpeedHistory::Reader::Reader(const SpeedHistory* history, Resolution res)
+	: m_history(history), m_res(res)
+{
+	m_history->m_lock.lockForRead();
+}
+
+SpeedHistory::Reader::~Reader()
+{
+	m_history->m_lock.unlock();
+}
+
+int SpeedHistory::Reader::size() const
+{
+	return m_history->m_archives[m_res].count;
+}
+
+const SpeedHistory::Sample& SpeedHistory::Reader::at(int i) const
+{
+	return m_history->m_archives[m_res].at(i);
+}
+
+QByteArray SpeedHistory::save() const
+{
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+	Reader r(this, Minutes);
+	
+	stream << SAVE_MAGIC << qint32(r.size());
+	for (int i = 0; i < r.size(); i++)
+		stream << qint32(r.at(i).down) << qint32(r.at(i).up);
+	
+	return data;
+}
+
+void SpeedHistory::load(const QByteArray& data, qint64 savedAt)
+{
+	QDataStream stream(data);
+	quint32 magic;
+	qint32 count;
+	
+	stream >> magic >> count;
+	if (stream.status() != QDataStream::Ok || magic != SAVE_MAGIC || count < 0 || count > MINUTES_CAPACITY)
+		return;
+	
+	QWriteLocker l(&m_lock);
+	Archive& archive = m_archives[Minutes];
+	
+	archive.first = archive.count = 0;
+	for (int i = 0; i < count; i++)
+	{
+		qint32 down, up;
+		stream >> down >> up;
+		
+		if (stream.status() != QDataStream::Ok)
+			break;
+		
+		Sample s = { down, up };
+		archive.push(s);
+	}
+	
+	// nothing was transferred while we weren't running
+	qint64 gap = (QDateTime::currentDateTime().toTime_t() - savedAt) / 60;
+	Sample zero = { 0, 0 };
+	
+	for (qint64 i = 0; i < qMin<qint64>(gap, MINUTES_CAPACITY); i++)
+		archive.push(zero);
+}
@@ -0,0 +1,110 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef SPEEDHISTORY_H
+#define SPEEDHISTORY_H
+#include <QVector>
+#include <QByteArray>
+#include <QReadWriteLock>
+
+// Speed samples kept at two resolutions, RRD style: one sample per second
+// for the recent minutes and one averaged sample per minute for the recent
+// days. Both archives are preallocated rings, so recording never allocates.
+// A history that only needs to reach a given number of seconds back
+// (a transfer's graph) gets rings just large enough for that.
+class SpeedHistory
+{
+public:
+	enum Resolution { Seconds = 0, Minutes, ResolutionCount };
+	
+	struct Sample
+	{
+		int down, up;
+	};
+	
+	// span is in seconds, 0 keeps the full capacity of both archives
+	SpeedHistory(int span = 0);
+	
+	int span() const { return m_nSpan; }
+	// resizes the archives, the newest samples are kept
+	void setSpan(int span);
+	
+	// records the speeds of the past second
+	void add(int down, int up);
+	
+	// picks the finest archive reaching the given number of seconds back
+	static Resolution resolutionFor(int seconds);
+	// seconds covered by one sample
+	static int interval(Resolution res);
+	static int capacity(Resolution res);
+	
+	// Read access to an archive without copying it. The history is
+	// read-locked for the lifetime of the reader, keep it short.
+	class Reader
+	{
+	public:
+		Reader(const SpeedHistory* history, Resolution res);
+		~Reader();
+		
+		int size() const;
+		// 0 is the oldest sample
+		const Sample& at(int i) const;
+	private:
+		Reader(const Reader&);
+		Reader& operator=(const Reader&);
+		
+		const SpeedHistory* m_history;
+		Resolution m_res;
+	};
+	
+	// the per-minute archive, for keeping the history across restarts
+	QByteArray save() const;
+	// "savedAt" is when save() was called, the time since is filled with zeros
+	void load(const QByteArray& data, qint64 savedAt);
+private:
+	SpeedHistory(const SpeedHistory&);
+	SpeedHistory& operator=(const SpeedHistory&);
+	
+	struct Archive
+	{
+		QVector<Sample> samples;
+		// index of the oldest sample and the number of samples
+		int first, count;
+		
+		void push(const Sample& s);
+		void resize(int cap);
+		const Sample& at(int i) const { return samples[(first + i) % samples.size()]; }
+	};
+	
+	Archive m_archives[ResolutionCount];
+	int m_nSpan;
+	// the running sum for the next per-minute sample
+	qint64 m_nSumDown, m_nSumUp;
+	int m_nSummed;
+	mutable QReadWriteLock m_lock;
+};
+
+#endif
@@ -0,0 +1,62 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "TickService.h"
+#include "Settings.h"
+#include <QtDebug>
+
+TickService* TickService::m_instance = 0;
+
+TickService::TickService() : m_nTick(0), m_nGuiTicks(1)
+{
+	m_instance = this;
+	
+	applySettings();
+	connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
+	m_timer.start(TickInterval);
+}
+
+TickService::~TickService()
+{
+	m_instance = 0;
+}
+
+void TickService::applySettings()
+{
+	m_nGuiTicks = qMax(1, getSettingsValue("gui_refresh").toInt() / TickInterval);
+}
+
+void TickService::tick()
+{
+	m_nTick++;
+	
+	emit transferTick();
+	
+	if(m_nTick % (1000 / TickInterval) == 0)
+		emit secondTick();
+	if(m_nTick % m_nGuiTicks == 0)
+		emit guiTick();
+}
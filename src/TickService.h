@@ -0,0 +1,61 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef TICKSERVICE_H
+#define TICKSERVICE_H
+#include <QObject>
+#include <QTimer>
+
+// Drives all periodic work from a single timer so that the number of
+// timer wakeups doesn't grow with the number of active transfers
+class TickService : public QObject
+{
+Q_OBJECT
+public:
+	TickService();
+	~TickService();
+	
+	static TickService* instance() { return m_instance; }
+	// reloads the GUI refresh interval
+	void applySettings();
+	
+	enum { TickInterval = 500 };
+signals:
+	// every TickInterval: transfer progress and segment bookkeeping
+	void transferTick();
+	// every second: queue management, statistics, engine workers
+	void secondTick();
+	// every "gui_refresh" milliseconds
+	void guiTick();
+private slots:
+	void tick();
+private:
+	static TickService* m_instance;
+	QTimer m_timer;
+	int m_nTick, m_nGuiTicks;
+};
+
+#endif
@@ -28,6 +28,7 @@ respects for all of the code used other than "OpenSSL".
 #include "Transfer.h"
 #include "Settings.h"
 #include "Queue.h"
+#include "SpeedHistory.h"
 
 #ifdef WITH_BITTORRENT
 #	include "engines/TorrentDownload.h"
@@ -41,6 +42,7 @@ respects for all of the code used other than "OpenSSL".
 #	include "engines/CurlDownload.h"
 #	include "engines/CurlUpload.h"
 #	include "engines/MetalinkDownload.h"
+#	include "engines/MirrorDownload.h"
 #endif
 
 #include <QtDebug>
@@ -57,6 +59,8 @@ QVector<EngineEntry> g_enginesUpload;
 extern QList<Queue*> g_queues;
 extern QReadWriteLock g_queuesLock;
 
+static const CachedSetting<int> g_graphMinutes("graphminutes");
+
 void initTransferClasses()
 {
 #ifdef ENABLE_FAKEDOWNLOAD
@@ -77,13 +81,17 @@ void initTransferClasses()
 		g_enginesDownload << e;
 	}
 	{
-		EngineEntry e = { "FtpUpload", "CURL FTP(S)/SFTP upload", 0, 0, { CurlUpload::createInstance }, { CurlUpload::acceptable }, 0 };
+		EngineEntry e = { "FtpUpload", "CURL FTP(S)/SFTP/HTTP(S) upload", 0, 0, { CurlUpload::createInstance }, { CurlUpload::acceptable }, 0 };
 		g_enginesUpload << e;
 	}
 	{
 		EngineEntry e = { "MetalinkDownload", "Metalink file handler", MetalinkDownload::globalInit, 0, { MetalinkDownload::createInstance }, { MetalinkDownload::acceptable }, 0 };
 		g_enginesDownload << e;
 	}
+	{
+		EngineEntry e = { "MirrorDownload", "CURL recursive HTTP/FTP directory mirror", 0, 0, { MirrorDownload::createInstance }, { MirrorDownload::acceptable }, 0 };
+		g_enginesDownload << e;
+	}
 #endif
 }
 
@@ -98,13 +106,14 @@ void addTransferClass(const EngineEntry& e, Transfer::Mode m)
 Transfer::Transfer(bool local)
 	: m_state(Paused), m_mode(Download), m_nDownLimit(0), m_nUpLimit(0),
 		  m_nDownLimitInt(0), m_nUpLimitInt(0), m_bLocal(local), m_bWorking(false),
-		  m_nTimeRunning(0), m_nRetryCount(0)
+		  m_nTimeRunning(0), m_nRetryCount(0), m_priority(PriorityNormal), m_nDeadline(0), m_speedHistory(0)
 {
 	m_uuid = QUuid::createUuid();
 }
 
 Transfer::~Transfer()
 {
+	delete m_speedHistory;
 }
 
 Transfer::State Transfer::state() const
@@ -112,6 +121,11 @@ Transfer::State Transfer::state() const
 	return m_state;
 }
 
+void Transfer::setPriority(int p)
+{
+	m_priority = Priority(qBound<int>(PriorityBackground, p, PriorityHigh));
+}
+
 void Transfer::setUserSpeedLimits(int down,int up)
 {
 	m_nDownLimitInt = m_nDownLimit = down;
@@ -354,6 +368,8 @@ void Transfer::load(const QDomNode& map)
 	m_strComment = getXMLProperty(map, "comment");
 	m_nTimeRunning = getXMLProperty(map, "timerunning").toLongLong();
 	m_uuid = getXMLProperty(map, "uuid");
+	setPriority(getXMLProperty(map, "priority").toInt());
+	m_nDeadline = getXMLProperty(map, "deadline").toLongLong();
 	
 	if(m_uuid.isNull())
 		m_uuid = QUuid::createUuid();
@@ -377,6 +393,8 @@ void Transfer::save(QDomDocument& doc, QDomNode& node) const
 	setXMLProperty(doc, node, "comment", m_strComment);
 	setXMLProperty(doc, node, "timerunning", QString::number(timeRunning()));
 	setXMLProperty(doc, node, "uuid", m_uuid.toString());
+	setXMLProperty(doc, node, "priority", QString::number(m_priority));
+	setXMLProperty(doc, node, "deadline", QString::number(m_nDeadline));
 	
 	QDomElement elem = doc.createElement("action");
 	QDomText text = doc.createTextNode(m_strCommandCompleted);
@@ -394,15 +412,37 @@ void Transfer::setMode(Mode newMode)
 	m_mode = newMode;
 }
 
+void Transfer::notifyTextChanged()
+{
+	if(!m_bLocal)
+		emit TransferNotifier::instance()->textChanged(this);
+}
+
+void Transfer::setComment(QString text)
+{
+	m_strComment = text;
+	notifyTextChanged();
+}
+
 void Transfer::updateGraph()
 {
 	int down, up;
 	
 	speeds(down,up);
 	
-	if(m_qSpeedData.size() >= getSettingsValue("graphminutes").toInt()*60)
-		m_qSpeedData.dequeue();
-	m_qSpeedData.enqueue(QPair<int,int>(down,up));
+	// a transfer's history only needs to cover its graph
+	const int span = qMax(g_graphMinutes.value(), 1) * 60;
+	
+	// transfers that have never run don't need any history
+	if(!m_speedHistory)
+	{
+		if(!down && !up)
+			return;
+		m_speedHistory = new SpeedHistory(span);
+	}
+	else if(m_speedHistory->span() != span)
+		m_speedHistory->setSpan(span);
+	m_speedHistory->add(down, up);
 }
 
 QString Transfer::getXMLProperty(const QDomNode& node, QString name)
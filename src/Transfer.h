@@ -43,6 +43,7 @@ class QIcon;
 class QMenu;
 class QDialog;
 class Queue;
+class SpeedHistory;
 
 class Transfer : public Logger
 {
@@ -103,6 +104,17 @@ public:
 	Q_INVOKABLE void setUserSpeedLimits(int down,int up);
 	void userSpeedLimits(int& down,int& up) const { down=m_nDownLimit; up=m_nUpLimit; }
 	
+	// SCHEDULING
+	// Background transfers only run on the bandwidth left over by the others
+	enum Priority { PriorityBackground = -1, PriorityNormal = 0, PriorityHigh = 1 };
+	Q_INVOKABLE int priority() const { return m_priority; }
+	Q_INVOKABLE void setPriority(int p);
+	Q_PROPERTY(int priority READ priority WRITE setPriority)
+	// UNIX time by which the transfer should be complete, 0 if there is none
+	Q_INVOKABLE qint64 deadline() const { return m_nDeadline; }
+	Q_INVOKABLE void setDeadline(qint64 t) { m_nDeadline = t; }
+	Q_PROPERTY(qint64 deadline READ deadline WRITE setDeadline)
+	
 	// TRANSFER SIZE
 	Q_INVOKABLE virtual qulonglong total() const = 0;
 	Q_PROPERTY(qulonglong total READ total)
@@ -119,11 +131,12 @@ public:
 	virtual void fillContextMenu(QMenu&) { }
 	
 	// LOGGING
-	QQueue<QPair<int,int> > speedData() const { return m_qSpeedData; }
+	// null until the transfer has been active for the first time
+	const SpeedHistory* speedHistory() const { return m_speedHistory; }
 	
 	// COMMENT
 	Q_INVOKABLE QString comment() const { return m_strComment; }
-	Q_INVOKABLE void setComment(QString text) { m_strComment = text; }
+	Q_INVOKABLE void setComment(QString text);
 	Q_PROPERTY(QString comment WRITE setComment READ comment)
 	
 	// AUTO ACTIONS
@@ -173,6 +186,8 @@ protected:
 	void setInternalSpeedLimits(int down,int up);
 	void setMode(Mode mode);
 	void fireCompleted();
+	// to be called when name() or remoteURI() return something else
+	void notifyTextChanged();
 	void updateGraph();
 
 	// Calls this->deleteLater()
@@ -191,9 +206,12 @@ protected:
 	
 	int m_nRetryCount;
 	
+	Priority m_priority;
+	qint64 m_nDeadline;
+	
 	QString m_strLog, m_strComment, m_strCommandCompleted;
 	
-	QQueue<QPair<int,int> > m_qSpeedData;
+	SpeedHistory* m_speedHistory;
 	QUuid m_uuid;
 	
 	friend class QueueMgr;
@@ -212,6 +230,8 @@ public:
 signals:
 	void stateChanged(Transfer* d, Transfer::State prev, Transfer::State now);
 	void modeChanged(Transfer* d, Transfer::Mode prev, Transfer::Mode now);
+	// the name, URL or comment has changed
+	void textChanged(Transfer* d);
 	friend class Transfer;
 };
 
@@ -0,0 +1,224 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "TransferIndex.h"
+#include "Transfer.h"
+
+static inline quint64 trigram(const QChar* p)
+{
+	return (quint64(p[0].unicode()) << 32) | (quint64(p[1].unicode()) << 16) | p[2].unicode();
+}
+
+TransferIndex::TransferIndex(QObject* parent)
+	: QObject(parent), m_nDead(0), m_bLastValid(false)
+{
+	connect(TransferNotifier::instance(), SIGNAL(stateChanged(Transfer*,Transfer::State,Transfer::State)),
+		this, SLOT(transferChanged(Transfer*)), Qt::DirectConnection);
+	connect(TransferNotifier::instance(), SIGNAL(textChanged(Transfer*)),
+		this, SLOT(transferChanged(Transfer*)), Qt::DirectConnection);
+}
+
+QString TransferIndex::textOf(Transfer* t)
+{
+	QString text = t->name();
+	
+	// magnet links would only add the info hash and inactive torrents
+	// would have to load their metadata to produce one
+	if(!t->inherits("TorrentDownload"))
+		text += '\n' + t->remoteURI();
+	text += '\n' + t->comment();
+	
+	return text.toLower();
+}
+
+void TransferIndex::insert(Transfer* t, const QString& text)
+{
+	Slot slot;
+	QSet<quint64> grams;
+	const int id = m_slots.size();
+	
+	slot.transfer = t;
+	slot.text = text;
+	m_slots << slot;
+	m_slotOf[t] = id;
+	
+	for(int i=0;i+2<text.size();i++)
+		grams << trigram(text.constData()+i);
+	foreach(quint64 g, grams)
+		m_grams[g] << id;
+}
+
+void TransferIndex::erase(Transfer* t)
+{
+	const int id = m_slotOf.take(t);
+	
+	m_slots[id].transfer = 0;
+	m_slots[id].text.clear();
+	m_nDead++;
+}
+
+void TransferIndex::compact()
+{
+	QVector<Slot> old = m_slots;
+	
+	m_slots.clear();
+	m_slotOf.clear();
+	m_grams.clear();
+	m_nDead = 0;
+	
+	foreach(const Slot& slot, old)
+	{
+		if(slot.transfer)
+			insert(slot.transfer, slot.text);
+	}
+}
+
+void TransferIndex::sync(const QueueSnapshot& snapshot)
+{
+	if(snapshot != m_snapshot)
+	{
+		QSet<Transfer*> present;
+		
+		present.reserve(snapshot.size());
+		for(int i=0;i<snapshot.size();i++)
+		{
+			Transfer* t = snapshot.at(i);
+			
+			present << t;
+			if(!m_slotOf.contains(t))
+				insert(t, textOf(t));
+		}
+		
+		QList<Transfer*> gone;
+		for(QHash<Transfer*,int>::const_iterator it = m_slotOf.constBegin(); it != m_slotOf.constEnd(); it++)
+		{
+			if(!present.contains(it.key()))
+				gone << it.key();
+		}
+		foreach(Transfer* t, gone)
+		{
+			erase(t);
+			m_stale.remove(t);
+		}
+		
+		m_snapshot = snapshot;
+		m_bLastValid = false;
+	}
+	
+	foreach(Transfer* t, m_stale)
+	{
+		if(!m_slotOf.contains(t))
+			continue;
+		
+		QString text = textOf(t);
+		if(text != m_slots[m_slotOf[t]].text)
+		{
+			erase(t);
+			insert(t, text);
+			m_bLastValid = false;
+		}
+	}
+	m_stale.clear();
+	
+	if(m_nDead > 1000 && m_nDead > m_slots.size()/2)
+		compact();
+}
+
+QSet<Transfer*> TransferIndex::search(const QueueSnapshot& snapshot, QString text)
+{
+	QMutexLocker l(&m_mutex);
+	QSet<Transfer*> result;
+	
+	sync(snapshot);
+	text = text.toLower();
+	
+	if(text.isEmpty())
+		return snapshot.transfers().toSet();
+	
+	if(m_bLastValid && text.contains(m_strLastQuery))
+	{
+		foreach(Transfer* t, m_lastResult)
+		{
+			if(m_slots[m_slotOf[t]].text.contains(text))
+				result << t;
+		}
+	}
+	else if(text.size() < 3)
+	{
+		foreach(const Slot& slot, m_slots)
+		{
+			if(slot.transfer && slot.text.contains(text))
+				result << slot.transfer;
+		}
+	}
+	else
+	{
+		// every match is in the posting list of each trigram of the text,
+		// the shortest one is enough to check
+		const QVector<int>* candidates = 0;
+		bool found = true;
+		
+		for(int i=0;i+2<text.size();i++)
+		{
+			QHash<quint64, QVector<int> >::const_iterator it = m_grams.constFind(trigram(text.constData()+i));
+			
+			if(it == m_grams.constEnd())
+			{
+				found = false;
+				break;
+			}
+			if(!candidates || it.value().size() < candidates->size())
+				candidates = &it.value();
+		}
+		
+		if(found && candidates)
+		{
+			foreach(int id, *candidates)
+			{
+				const Slot& slot = m_slots[id];
+				if(slot.transfer && slot.text.contains(text))
+					result << slot.transfer;
+			}
+		}
+	}
+	
+	m_strLastQuery = text;
+	m_lastResult = result;
+	m_bLastValid = true;
+	
+	return result;
+}
+
+void TransferIndex::invalidate(Transfer* t)
+{
+	QMutexLocker l(&m_mutex);
+	m_stale << t;
+}
+
+void TransferIndex::transferChanged(Transfer* t)
+{
+	invalidate(t);
+}
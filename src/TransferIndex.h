@@ -0,0 +1,81 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef TRANSFERINDEX_H
+#define TRANSFERINDEX_H
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QMutex>
+#include "Queue.h"
+
+// Trigram index over the names, URLs and comments of the transfers in
+// a queue, used by the transfer list filter and Queue.getTransfers
+class TransferIndex : public QObject
+{
+Q_OBJECT
+public:
+	TransferIndex(QObject* parent = 0);
+	
+	// transfers of the snapshot whose text contains the string, case insensitive
+	QSet<Transfer*> search(const QueueSnapshot& snapshot, QString text);
+	// the text of the transfer is read again on the next search
+	void invalidate(Transfer* t);
+private slots:
+	void transferChanged(Transfer* t);
+private:
+	void sync(const QueueSnapshot& snapshot);
+	void insert(Transfer* t, const QString& text);
+	void erase(Transfer* t);
+	void compact();
+	static QString textOf(Transfer* t);
+	
+	struct Slot
+	{
+		Transfer* transfer;
+		QString text;
+	};
+	
+	// slots of removed transfers stay dead until compact(), the posting
+	// lists are never searched without checking the slot
+	QVector<Slot> m_slots;
+	QHash<Transfer*,int> m_slotOf;
+	QHash<quint64, QVector<int> > m_grams;
+	int m_nDead;
+	
+	QSet<Transfer*> m_stale;
+	QueueSnapshot m_snapshot;
+	
+	// the previous result is narrowed down as the user keeps typing
+	QString m_strLastQuery;
+	QSet<Transfer*> m_lastResult;
+	bool m_bLastValid;
+	
+	QMutex m_mutex;
+};
+
+#endif
@@ -0,0 +1,352 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "TransferScheduler.h"
+#include <QTextStream>
+#include <QStringList>
+#include <QRegExp>
+#include <QtAlgorithms>
+
+static const int MIN_LIMIT = 1024;
+
+// the extra bandwidth reserved for deadline transfers to absorb fluctuations
+static const int DEADLINE_HEADROOM = 4; // 1/4
+
+static int rank(const TransferScheduler::Item& item)
+{
+	if(item.priority == Transfer::PriorityBackground)
+		return 3;
+	else if(item.deadline > 0)
+		return 0;
+	else if(item.priority == Transfer::PriorityHigh)
+		return 1;
+	else
+		return 2;
+}
+
+struct ActivationLess
+{
+	ActivationLess(const QVector<TransferScheduler::Item>& items) : m_items(items) {}
+	
+	bool operator()(int a, int b) const
+	{
+		const TransferScheduler::Item& ia = m_items[a];
+		const TransferScheduler::Item& ib = m_items[b];
+		int ra = rank(ia), rb = rank(ib);
+		
+		if(ra != rb)
+			return ra < rb;
+		if(ra == 0)
+			return ia.deadline < ib.deadline;
+		return false;
+	}
+	
+	const QVector<TransferScheduler::Item>& m_items;
+};
+
+QList<int> TransferScheduler::activationOrder(const QVector<Item>& items)
+{
+	QList<int> order;
+	
+	for(int i=0;i<items.size();i++)
+		order << i;
+	
+	// stable, so that the queue order is kept within a class
+	qStableSort(order.begin(), order.end(), ActivationLess(items));
+	return order;
+}
+
+bool TransferScheduler::isTrivial(const QVector<Item>& items)
+{
+	foreach(const Item& item, items)
+	{
+		if(item.priority != Transfer::PriorityNormal || item.deadline > 0)
+			return false;
+	}
+	return true;
+}
+
+void TransferScheduler::schedule(QVector<Item>& items, int maxActive, int bandwidth, qint64 now)
+{
+	QList<int> order = activationOrder(items);
+	qint64 foreground = 0;
+	
+	for(int i=0;i<items.size();i++)
+	{
+		items[i].active = false;
+		items[i].limit = 0;
+	}
+	
+	foreach(int i, order)
+	{
+		if(items[i].priority == Transfer::PriorityBackground || !maxActive)
+			continue;
+		
+		items[i].active = true;
+		foreground += items[i].speed;
+		maxActive--;
+	}
+	
+	// background transfers only start if the others don't saturate the link
+	const bool spare = !bandwidth || foreground < qint64(bandwidth) * 9 / 10;
+	
+	foreach(int i, order)
+	{
+		if(items[i].priority != Transfer::PriorityBackground || !maxActive)
+			continue;
+		if(!spare && !items[i].speed)
+			continue;
+		
+		items[i].active = true;
+		maxActive--;
+	}
+	
+	if(bandwidth > 0)
+		assignBandwidth(items, bandwidth, now);
+}
+
+void TransferScheduler::assignBandwidth(QVector<Item>& items, int bandwidth, qint64 now)
+{
+	QList<int> order = activationOrder(items);
+	qint64 left = bandwidth;
+	int weights = 0, background = 0;
+	
+	// 1) reserve what the deadline transfers need, earliest deadline first
+	foreach(int i, order)
+	{
+		Item& item = items[i];
+		if(!item.active)
+			continue;
+		
+		if(rank(item) != 0)
+		{
+			if(item.priority == Transfer::PriorityBackground)
+				background++;
+			else
+				weights += (item.priority == Transfer::PriorityHigh) ? 2 : 1;
+			continue;
+		}
+		
+		qint64 secs = item.deadline - now;
+		qint64 need;
+		
+		if(item.remaining < 0 || secs <= 0)
+			need = left; // already late or unknown, take all we can
+		else
+		{
+			need = item.remaining / secs + 1;
+			need += need / DEADLINE_HEADROOM;
+		}
+		
+		need = qMin(need, left);
+		item.limit = int(qMax<qint64>(need, MIN_LIMIT));
+		left -= need;
+	}
+	
+	// 2) share the rest between the high and normal priority transfers
+	qint64 used = 0;
+	foreach(int i, order)
+	{
+		Item& item = items[i];
+		if(!item.active || rank(item) == 0 || item.priority == Transfer::PriorityBackground)
+			continue;
+		
+		int w = (item.priority == Transfer::PriorityHigh) ? 2 : 1;
+		qint64 share = left * w / weights;
+		
+		item.limit = int(qMax<qint64>(share, MIN_LIMIT));
+		used += qMin<qint64>(item.speed, share);
+	}
+	
+	// 3) background transfers get whatever remains unused
+	if(background)
+	{
+		qint64 spare = qMax<qint64>(left - used, 0) / background;
+		foreach(int i, order)
+		{
+			Item& item = items[i];
+			if(item.active && item.priority == Transfer::PriorityBackground)
+				item.limit = int(qMax<qint64>(spare, MIN_LIMIT));
+		}
+	}
+}
+
+struct SimTransfer
+{
+	QString name;
+	qint64 arrival, size, deadline, finished;
+	Transfer::Priority priority;
+};
+
+QString TransferScheduler::simulate(QIODevice* workload)
+{
+	QList<SimTransfer> transfers;
+	QString report;
+	QTextStream out(&report);
+	QTextStream in(workload);
+	int bandwidth = 1024*1024, maxActive = 3;
+	
+	// bandwidth <bytes/s>
+	// slots <count>
+	// transfer <name> <arrival s> <size> <background|normal|high> [<deadline s>]
+	for(int lineNo = 1; !in.atEnd(); lineNo++)
+	{
+		QString line = in.readLine().trimmed();
+		if(line.isEmpty() || line.startsWith('#'))
+			continue;
+		
+		QStringList f = line.split(QRegExp("\\s+"));
+		
+		if(f[0] == "bandwidth" && f.size() == 2)
+			bandwidth = f[1].toInt();
+		else if(f[0] == "slots" && f.size() == 2)
+			maxActive = f[1].toInt();
+		else if(f[0] == "transfer" && (f.size() == 5 || f.size() == 6))
+		{
+			SimTransfer t;
+			t.name = f[1];
+			t.arrival = f[2].toLongLong();
+			t.size = f[3].toLongLong();
+			t.deadline = (f.size() == 6) ? f[5].toLongLong() : 0;
+			t.finished = -1;
+			
+			if(f[4] == "background")
+				t.priority = Transfer::PriorityBackground;
+			else if(f[4] == "high")
+				t.priority = Transfer::PriorityHigh;
+			else
+				t.priority = Transfer::PriorityNormal;
+			transfers << t;
+		}
+		else
+			out << QString("Line %1 ignored: %2\n").arg(lineNo).arg(line);
+	}
+	
+	if(bandwidth <= 0)
+		return report + "The bandwidth must be positive\n";
+	
+	QVector<qint64> remaining(transfers.size());
+	QVector<int> speeds(transfers.size(), 0);
+	int unfinished = transfers.size();
+	
+	for(int i=0;i<transfers.size();i++)
+		remaining[i] = transfers[i].size;
+	
+	// one step per second, capped at 30 days
+	for(qint64 now = 0; unfinished && now < 30*24*60*60; now++)
+	{
+		QVector<Item> items;
+		QList<int> map;
+		
+		for(int i=0;i<transfers.size();i++)
+		{
+			if(transfers[i].arrival > now || transfers[i].finished >= 0)
+				continue;
+			
+			Item item;
+			item.priority = transfers[i].priority;
+			item.deadline = transfers[i].deadline;
+			item.remaining = remaining[i];
+			item.speed = speeds[i];
+			items << item;
+			map << i;
+		}
+		
+		schedule(items, maxActive, bandwidth, now);
+		
+		// the link is shared evenly, honouring the assigned limits
+		qint64 capacity = bandwidth;
+		QList<int> hungry;
+		QVector<qint64> rate(items.size(), 0);
+		
+		for(int j=0;j<items.size();j++)
+		{
+			if(items[j].active)
+				hungry << j;
+		}
+		
+		while(capacity > 0 && !hungry.isEmpty())
+		{
+			qint64 share = qMax<qint64>(capacity / hungry.size(), 1);
+			
+			for(int k=0;k<hungry.size() && capacity > 0;k++)
+			{
+				int j = hungry[k];
+				qint64 cap = items[j].remaining - rate[j];
+				if(items[j].limit > 0)
+					cap = qMin<qint64>(cap, items[j].limit - rate[j]);
+				
+				qint64 give = qMin(qMin(share, cap), capacity);
+				rate[j] += give;
+				capacity -= give;
+				
+				if(give == cap)
+					hungry.removeAt(k--);
+			}
+		}
+		
+		for(int j=0;j<items.size();j++)
+		{
+			int i = map[j];
+			speeds[i] = int(rate[j]);
+			remaining[i] -= rate[j];
+			
+			if(remaining[i] <= 0)
+			{
+				transfers[i].finished = now+1;
+				unfinished--;
+			}
+		}
+	}
+	
+	int missed = 0, deadlines = 0;
+	foreach(const SimTransfer& t, transfers)
+	{
+		out << t.name << ": ";
+		if(t.finished < 0)
+			out << "unfinished";
+		else
+			out << "finished at " << t.finished << " s";
+		
+		if(t.deadline > 0)
+		{
+			deadlines++;
+			if(t.finished < 0 || t.finished > t.deadline)
+			{
+				missed++;
+				out << ", MISSED the deadline at " << t.deadline << " s";
+			}
+			else
+				out << ", met the deadline at " << t.deadline << " s";
+		}
+		out << '\n';
+	}
+	
+	out << QString("%1 of %2 deadlines missed\n").arg(missed).arg(deadlines);
+	out.flush();
+	
+	return report;
+}
@@ -0,0 +1,76 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef TRANSFERSCHEDULER_H
+#define TRANSFERSCHEDULER_H
+#include <QVector>
+#include <QList>
+#include <QString>
+#include "Transfer.h"
+
+class QIODevice;
+
+// Decides which transfers of a queue may run and how the queue's bandwidth
+// is shared among them. Transfers with a deadline are served earliest
+// deadline first, then high and normal priority transfers in the queue
+// order; background transfers only get the bandwidth the others leave unused.
+class TransferScheduler
+{
+public:
+	struct Item
+	{
+		Item() : priority(Transfer::PriorityNormal), deadline(0), remaining(-1), speed(0), active(false), limit(0) {}
+		
+		Transfer::Priority priority;
+		// UNIX time, 0 if there is none
+		qint64 deadline;
+		// bytes left to transfer, -1 if unknown
+		qint64 remaining;
+		// the current speed in bytes per second
+		int speed;
+		
+		// whether the item may be active
+		bool active;
+		// the assigned speed limit, 0 means unlimited
+		int limit;
+	};
+	
+	// maxActive < 0 means no limit on the number of active items,
+	// bandwidth == 0 means the bandwidth is not limited
+	static void schedule(QVector<Item>& items, int maxActive, int bandwidth, qint64 now);
+	// the indexes of items in the order they should be activated
+	static QList<int> activationOrder(const QVector<Item>& items);
+	// true if the default list-order scheduling gives the same result
+	static bool isTrivial(const QVector<Item>& items);
+	
+	// Replays a workload description and reports missed deadlines, see the
+	// --simulate-schedule command line option
+	static QString simulate(QIODevice* workload);
+private:
+	static void assignBandwidth(QVector<Item>& items, int bandwidth, qint64 now);
+};
+
+#endif
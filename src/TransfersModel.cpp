@@ -33,6 +33,7 @@ respects for all of the code used other than "OpenSSL".
 #include "TransfersModel.h"
 #include "fatrat.h"
 #include "MainWindow.h"
+#include "TransferIndex.h"
 
 extern QList<Queue*> g_queues;
 extern QReadWriteLock g_queuesLock;
@@ -41,7 +42,7 @@ extern MainWindow* g_wndMain;
 using namespace std;
 
 TransfersModel::TransfersModel(QObject* parent)
-	: QAbstractListModel(parent), m_queue(-1), m_nLastRowCount(0)
+	: QAbstractListModel(parent), m_queue(-1), m_nFirstVisible(0), m_nLastVisible(-1)
 {
 	m_states[0] = new QIcon(":/states/waiting.png");
 	m_states[1] = new QIcon(":/states/active.png");
@@ -56,6 +57,9 @@ TransfersModel::TransfersModel(QObject* parent)
 	m_states[9] = new QIcon(":/states/paused_upload.png");
 	m_states[10] = new QIcon(":/states/failed.png");
 	m_states[11] = new QIcon(":/states/completed_upload.png");
+	
+	connect(TransferNotifier::instance(), SIGNAL(stateChanged(Transfer*,Transfer::State,Transfer::State)), this, SLOT(transferChanged(Transfer*)));
+	connect(TransferNotifier::instance(), SIGNAL(modeChanged(Transfer*,Transfer::Mode,Transfer::Mode)), this, SLOT(transferChanged(Transfer*)));
 }
 
 TransfersModel::~TransfersModel()
@@ -107,145 +111,210 @@ QVariant TransfersModel::headerData(int section, Qt::Orientation orientation, in
 
 int TransfersModel::rowCount(const QModelIndex &parent) const
 {
-	int count = 0;
 	if(!parent.isValid())
-	{
-		g_queuesLock.lockForRead();
-		
-		if(m_queue < g_queues.size() && m_queue >= 0)
-			count = g_queues[m_queue]->size();
-		
-		g_queuesLock.unlock();
-	}
+		return m_rows.size();
+	else
+		return 0;
+}
+
+void TransfersModel::createDataSet(Transfer* t, RowData& data)
+{
+	data.state = t->state();
+	data.name = t->name();
+	data.total = t->total();
+	data.done = (data.total) ? t->done() : 0;
+	data.active = t->isActive();
 	
-	return count;
+	if(data.active)
+		t->speeds(data.down, data.up);
+	else
+		data.down = data.up = 0;
+	
+	data.message = t->message();
+	data.mode = t->mode();
+	data.primaryMode = t->primaryMode();
 }
 
-TransfersModel::RowData TransfersModel::createDataSet(Transfer* t)
+bool TransfersModel::updateRow(int index, QList<Transfer*>& renamed)
 {
+	RowData& data = m_data[index];
 	RowData newData;
 	
-	const qint64 total = t->total();
+	newData.transfer = data.transfer;
+	newData.fresh = true;
+	
+	if(newData.transfer != 0)
+		createDataSet(newData.transfer, newData);
 	
-	newData.state = t->state();
-	newData.name = t->name();
-	newData.fProgress = (total) ? 100.0/t->total()*t->done() : 0;
-	newData.progress = (total) ? QString("%1%").arg(newData.fProgress, 0, 'f', 1) : QString();
-	newData.size = (total) ? formatSize(t->total()) : QString("?");
+	const bool changed = !data.fresh || newData != data;
+	
+	if(data.fresh && data.name != newData.name)
+		renamed << data.transfer;
+	data = newData;
+	
+	return changed;
+}
+
+void TransfersModel::transferChanged(Transfer* t)
+{
+	m_dirty << t;
+}
+
+void TransfersModel::setVisibleRows(int first, int last)
+{
+	m_nFirstVisible = qMax(0, first);
+	m_nLastVisible = last;
+}
+
+void TransfersModel::remap(const QString& filter, const QList<Transfer*>& renamed)
+{
+	const int size = m_data.size();
+	QVector<int> rows, rowOf(size, -1);
+	QSet<Transfer*> matches;
 	
-	if(t->isActive())
+	if(!filter.isEmpty())
 	{
-		int down,up;
-		t->speeds(down,up);
-		
-		if(down || t->mode() == Transfer::Download)
-			newData.speedDown = formatSize(down, true);
-		if(up || t->mode() == Transfer::Upload)
-			newData.speedUp = formatSize(up, true);
-		
-		if(t->total())
+		g_queuesLock.lockForRead();
+		if(m_queue < g_queues.size() && m_queue >= 0)
 		{
-			QString s;
-			int down,up;
-			qulonglong totransfer = t->total() - t->done();
-			
-			t->speeds(down,up);
+			TransferIndex* index = g_queues[m_queue]->searchIndex();
 			
-			if(t->primaryMode() == Transfer::Download)
-			{
-				if(down)
-					newData.timeLeft = formatTime(totransfer/down);
-			}
-			else if(up)
-				newData.timeLeft = formatTime(totransfer/up);
+			foreach(Transfer* t, renamed)
+				index->invalidate(t);
+			matches = index->search(m_snapshot, filter);
 		}
+		g_queuesLock.unlock();
 	}
 	
-	newData.message = t->message();
-	newData.mode = t->mode();
-	newData.primaryMode = t->primaryMode();
+	rows.reserve(size);
+	for(int i=0;i<size;i++)
+	{
+		if(!filter.isEmpty() && !matches.contains(m_data[i].transfer))
+			continue;
+		
+		rowOf[i] = rows.size();
+		rows << i;
+	}
+	
+	const int count = rows.size(), lastCount = m_rows.size();
 	
-	return newData;
+	if(count > lastCount)
+	{
+		qDebug() << "Adding" << count - lastCount << "rows";
+		beginInsertRows(QModelIndex(), lastCount, count-1);
+		m_rows = rows;
+		m_rowOf = rowOf;
+		endInsertRows();
+	}
+	else if(count < lastCount)
+	{
+		qDebug() << "Removing" << lastCount - count << "rows";
+		beginRemoveRows(QModelIndex(), count, lastCount-1);
+		m_rows = rows;
+		m_rowOf = rowOf;
+		endRemoveRows();
+	}
+	else
+	{
+		m_rows = rows;
+		m_rowOf = rowOf;
+	}
+	
+	m_strFilter = filter;
+	
+	// the remaining rows may now show different transfers
+	if(qMin(count, lastCount) > 0)
+		dataChanged(createIndex(0,0), createIndex(qMin(count, lastCount)-1, 6));
 }
 
 void TransfersModel::refresh()
 {
-	int count = 0;
-	Queue* q = 0;
-	g_queuesLock.lockForRead();
+	QueueSnapshot snapshot;
 	
+	g_queuesLock.lockForRead();
 	if(m_queue < g_queues.size() && m_queue >= 0)
-	{
-		q = g_queues[m_queue];
-		count = q->size();
-	}
-	
-	m_lastData.resize(count);
+		snapshot = g_queues[m_queue]->snapshot();
+	g_queuesLock.unlock();
 	
-	QList<bool> changes;
 	MainWindow* w = static_cast<MainWindow*>(getMainWindow());
 	QString filter;
 
 	if(w)
 		filter = w->getFilterText();
-	m_filterMapping.clear();
 	
-	if(q != 0)
+	bool bRemap = filter != m_strFilter;
+	
+	if(snapshot != m_snapshot)
 	{
-		q->lock();
+		// carry the cached rows over to the new layout of the queue
+		const int count = snapshot.size();
+		QVector<RowData> data(count);
+		QHash<Transfer*,int> indexes;
 		
-		int filtered = 0;
-		for(int i=0,j=0;i<count;i++,j++)
+		indexes.reserve(count);
+		for(int i=0;i<count;i++)
 		{
-			Transfer* t = q->at(i);
-			RowData newData;
-
-			if (!filter.isEmpty())
-				m_filterMapping[j] = i;
-			if (!filter.isEmpty() && !t->name().contains(filter, Qt::CaseInsensitive))
-			{
-				filtered++;
-				j--;
-				continue;
-			}
-			
-			if(t != 0)
-				newData = createDataSet(t);
+			Transfer* t = snapshot.at(i);
+			QHash<Transfer*,int>::const_iterator it = m_indexes.constFind(t);
 			
-			changes << (newData != m_lastData[j]);
-			m_lastData[j] = newData;
+			if(it != m_indexes.constEnd())
+				data[i] = m_data[it.value()];
+			else
+				data[i].transfer = t;
+			indexes[t] = i;
 		}
-		count -= filtered;
-		q->unlock();
+		
+		m_snapshot = snapshot;
+		m_data = data;
+		m_indexes = indexes;
+		bRemap = true;
 	}
-	g_queuesLock.unlock();
 	
-	if(count > m_nLastRowCount)
+	if(bRemap)
+		remap(filter, QList<Transfer*>());
+	
+	// only the rows of transfers that have notified us and the rows
+	// on the screen are fetched again
+	QSet<Transfer*> dirty;
+	QVector<int> changed;
+	QList<Transfer*> renamed;
+	
+	dirty.swap(m_dirty);
+	foreach(Transfer* t, dirty)
 	{
-		qDebug() << "Adding" << count - m_nLastRowCount << "rows";
-		beginInsertRows(QModelIndex(), m_nLastRowCount, count-1);
-		endInsertRows();
+		QHash<Transfer*,int>::const_iterator it = m_indexes.constFind(t);
+		
+		if(it != m_indexes.constEnd() && updateRow(it.value(), renamed) && m_rowOf[it.value()] != -1)
+			changed << m_rowOf[it.value()];
 	}
-	else if(count < m_nLastRowCount)
+	
+	for(int row=m_nFirstVisible;row<=m_nLastVisible && row<m_rows.size();row++)
 	{
-		qDebug() << "Removing" << m_nLastRowCount - count << "rows";
-		beginRemoveRows(QModelIndex(), count, m_nLastRowCount-1);
-		endRemoveRows();
+		const int i = m_rows[row];
+		
+		if(dirty.contains(m_data[i].transfer))
+			continue;
+		if(updateRow(i, renamed))
+			changed << row;
 	}
-	m_nLastRowCount = count;
 	
-	for(int i=0;i<count;)
+	// engines that don't report renames are caught here
+	if(!renamed.isEmpty() && !filter.isEmpty())
 	{
-		if(!changes[i])
-			i++;
-		else
-		{
-			int from = i, to;
-			while(i < count && changes[i])
-				to = i++;
-			
-			dataChanged(createIndex(from,0), createIndex(to,5)); // refresh the view
-		}
+		remap(filter, renamed);
+		return;
+	}
+	
+	qSort(changed);
+	
+	for(int i=0;i<changed.size();)
+	{
+		int from = changed[i], to = from;
+		
+		while(++i < changed.size() && changed[i] <= to+1)
+			to = changed[i];
+		
+		dataChanged(createIndex(from,0), createIndex(to,6)); // refresh the view
 	}
 }
 
@@ -266,39 +335,59 @@ int TransfersModel::columnCount(const QModelIndex&) const
 
 QVariant TransfersModel::data(const QModelIndex &index, int role) const
 {
-	int row = index.row();
+	const int row = index.row();
+	
+	if(row >= m_rows.size() || m_rows[row] >= m_data.size())
+		return QVariant();
+	
+	const RowData& d = rowData(row);
 	
 	if(role == Qt::DisplayRole)
 	{
-		if(row < m_lastData.size())
+		switch(index.column())
 		{
-			switch(index.column())
+		case 0:
+			return d.name;
+		case 1:
+			if(d.total)
+				return QString("%1%").arg(d.progress(), 0, 'f', 1);
+			break;
+		case 2:
+			return (d.total) ? formatSize(d.total) : QString("?");
+		case 3:
+			if(d.active && (d.down || d.mode == Transfer::Download))
+				return formatSize(d.down, true);
+			break;
+		case 4:
+			if(d.active && (d.up || d.mode == Transfer::Upload))
+				return formatSize(d.up, true);
+			break;
+		case 5:
+			if(d.active && d.total)
 			{
-			case 0:
-				return m_lastData[row].name;
-			case 1:
-				return m_lastData[row].progress;
-			case 2:
-				return m_lastData[row].size;
-			case 3:
-				return m_lastData[row].speedDown;
-			case 4:
-				return m_lastData[row].speedUp;
-			case 5:
-				return m_lastData[row].timeLeft;
-			case 6:
-				return m_lastData[row].message;
+				qulonglong totransfer = d.total - d.done;
+				
+				if(d.primaryMode == Transfer::Download)
+				{
+					if(d.down)
+						return formatTime(totransfer/d.down);
+				}
+				else if(d.up)
+					return formatTime(totransfer/d.up);
 			}
+			break;
+		case 6:
+			return d.message;
 		}
 	}
 	else if(role == Qt::DecorationRole)
 	{
-		if(index.column() == 0 && row < m_lastData.size())
+		if(index.column() == 0)
 		{
-			Transfer::State state = m_lastData[row].state;
-			if(m_lastData[row].mode == Transfer::Upload)
+			Transfer::State state = d.state;
+			if(d.mode == Transfer::Upload)
 			{
-				if(state == Transfer::Completed && m_lastData[row].primaryMode == Transfer::Download)
+				if(state == Transfer::Completed && d.primaryMode == Transfer::Download)
 					return *m_states[5]; // an exception for download-oriented transfers
 				else
 					return *m_states[state+6];
@@ -317,7 +406,16 @@ QVariant TransfersModel::data(const QModelIndex &index, int role) const
 
 void TransfersModel::setQueue(int q)
 {
+	beginResetModel();
 	m_queue = q;
+	m_snapshot = QueueSnapshot();
+	m_data.clear();
+	m_indexes.clear();
+	m_rows.clear();
+	m_rowOf.clear();
+	m_dirty.clear();
+	endResetModel();
+	
 	refresh();
 }
 
@@ -338,23 +436,21 @@ Qt::ItemFlags TransfersModel::flags(const QModelIndex &index) const
 
 QMimeData* TransfersModel::mimeData(const QModelIndexList&) const
 {
-	QReadLocker l(&g_queuesLock);
 	QMimeData *mimeData = new QMimeData;
 	QByteArray encodedData;
 	QByteArray files;
 	QList<int> sel = g_wndMain->getSelection();
 	
-	Queue* q = g_queues[m_queue];
-	
-	q->lock();
+	// the selection refers to the rows of the snapshot being displayed
 	foreach(int x, sel)
 	{
+		if(x < 0 || x >= m_snapshot.size())
+			continue;
 		if(!files.isEmpty())
 			files += '\n';
 		files += "file://";
-		files += q->at(x)->dataPath(true).toUtf8();
+		files += m_snapshot.at(x)->dataPath(true).toUtf8();
 	}
-	q->unlock();
 
 	QDataStream stream(&encodedData, QIODevice::WriteOnly);
 	stream << m_queue << sel;
@@ -367,8 +463,8 @@ QMimeData* TransfersModel::mimeData(const QModelIndexList&) const
 
 int TransfersModel::remapIndex(int index)
 {
-	if (m_filterMapping.contains(index))
-		return m_filterMapping[index];
+	if (index >= 0 && index < m_rows.size())
+		return m_rows[index];
 	else
 		return index;
 }
@@ -381,16 +477,18 @@ void ProgressDelegate::paint(QPainter* painter, const QStyleOptionViewItem& opti
 		QStyleOptionProgressBarV2 opts;
 		const int row = index.row();
 		
-		if(row < model->m_lastData.size())
+		if(row < model->m_rows.size() && model->m_rows[row] < model->m_data.size())
 		{
-			if(model->m_lastData[row].size != "?")
-				opts.text = QString("%1%").arg(model->m_lastData[row].fProgress, 0, 'f', 1);
+			const TransfersModel::RowData& d = model->rowData(row);
+			
+			if(d.total)
+				opts.text = QString("%1%").arg(d.progress(), 0, 'f', 1);
 			else
 				opts.text = "?";
 			
 			opts.maximum = 1000;
 			opts.minimum = 0;
-			opts.progress = int( model->m_lastData[row].fProgress*10 );
+			opts.progress = int( d.progress()*10 );
 			opts.rect = option.rect;
 			opts.textVisible = true;
 			opts.state = QStyle::State_Enabled;
@@ -33,7 +33,9 @@ respects for all of the code used other than "OpenSSL".
 #include <QItemDelegate>
 #include "Queue.h"
 #include <QPixmap>
-#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QVector>
 
 class ProgressDelegate : public QItemDelegate
 {
@@ -62,34 +64,60 @@ public:
 	QMimeData* mimeData(const QModelIndexList &indexes) const;
 	
 	void setQueue(int q);
+	// Rows that are refreshed on every tick regardless of notifications
+	void setVisibleRows(int first, int last);
 	void refresh();
 	int remapIndex(int index);
 protected:
 	int m_queue;
+private slots:
+	void transferChanged(Transfer* t);
 private:
-	int m_nLastRowCount;
 	QIcon* m_states[12];
-	QMap<int,int> m_filterMapping;
 	
+	// raw values, the strings are only formatted in data()
 	struct RowData
 	{
+		RowData() : transfer(0), fresh(false), state(Transfer::Waiting), mode(Transfer::Download),
+			primaryMode(Transfer::Download), active(false), total(0), done(0), down(0), up(0) {}
+		
+		Transfer* transfer;
+		// false until the row has been fetched from the transfer
+		bool fresh;
+		
 		Transfer::State state;
-		QString name, speedDown, speedUp, timeLeft, message, progress, size;
 		Transfer::Mode mode, primaryMode;
-		float fProgress;
+		bool active;
+		QString name, message;
+		qulonglong total, done;
+		int down, up;
 		
-		inline bool operator!=(const RowData& d2)
+		inline bool operator!=(const RowData& d2) const
 		{
 #define COMP(n) n != d2.n
-			return COMP(state) || COMP(name) || COMP(speedDown) || COMP(speedUp) || COMP(timeLeft) || COMP(message) ||
-					COMP(progress) || COMP(size) || COMP(mode) || COMP(primaryMode);
+			return COMP(state) || COMP(name) || COMP(down) || COMP(up) || COMP(message) || COMP(active) ||
+					COMP(total) || COMP(done) || COMP(mode) || COMP(primaryMode);
 #undef COMP
 		}
+		float progress() const { return (total) ? 100.0/total*done : 0; }
 	};
 	
-	static RowData createDataSet(Transfer* t);
+	static void createDataSet(Transfer* t, RowData& data);
+	bool updateRow(int index, QList<Transfer*>& renamed);
+	void remap(const QString& filter, const QList<Transfer*>& renamed);
+	const RowData& rowData(int row) const { return m_data[m_rows[row]]; }
+	
+	// the queue as of the last refresh, m_data is indexed alike
+	QueueSnapshot m_snapshot;
+	QVector<RowData> m_data;
+	QHash<Transfer*,int> m_indexes;
+	
+	// model row -> queue index and back (-1 if filtered out)
+	QVector<int> m_rows, m_rowOf;
+	QString m_strFilter;
 	
-	QVector<RowData> m_lastData;
+	QSet<Transfer*> m_dirty;
+	int m_nFirstVisible, m_nLastVisible;
 	
 	friend class ProgressDelegate;
 };
@@ -132,10 +132,8 @@ QString DbusImpl::addTransfersNonInteractive(QString uris, QString target, QStri
 				throw;
 			}
 			
-			Queue* q = g_queues[queueID];
-			q->lockW();
-			q->add(t);
-			q->unlock();
+			// add() takes the queue's lock and publishes a new snapshot
+			g_queues[queueID]->add(t);
 		}
 	}
 	catch(const RuntimeException& e)
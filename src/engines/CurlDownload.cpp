@@ -36,12 +36,15 @@ respects for all of the code used other than "OpenSSL".
 #include "util/ExtendedAttributes.h"
 #include "CurlPoller.h"
 #include "Auth.h"
+#include "TickService.h"
 #include "HttpDetails.h"
+#include "MirrorProber.h"
 #include <errno.h>
 #include <cstring>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <QMessageBox>
 #include <QMenu>
 #include <QColor>
@@ -57,14 +60,18 @@ respects for all of the code used other than "OpenSSL".
 #	define O_LARGEFILE 0
 #endif
 
+// read for every segment
+static const CachedSetting<int> g_minSegSize("httpftp/minsegsize");
+static const CachedSetting<qint64> g_smallFileSize("httpftp/smallfile_size");
+static const CachedSetting<bool> g_priorityMode("httpftp/priority_mode");
+
 static const QColor g_colors[] = { Qt::red, Qt::green, Qt::blue, Qt::cyan, Qt::magenta, Qt::yellow, Qt::darkRed,
 	Qt::darkGreen, Qt::darkBlue, Qt::darkCyan, Qt::darkMagenta, Qt::darkYellow };
 
 CurlDownload::CurlDownload()
-	: m_nTotal(0), m_nStart(0), m_bAutoName(false), m_segmentsLock(QReadWriteLock::Recursive), m_master(0), m_nameChanger(0)
+	: m_nTotal(0), m_nStart(0), m_bAutoName(false), m_bSegmentsKnown(false), m_segmentsLock(QReadWriteLock::Recursive), m_master(0), m_bFastPath(false), m_nameChanger(0), m_prober(0)
 {
 	m_errorBuffer[0] = 0;
-	connect(&m_timer, SIGNAL(timeout()), this, SLOT(updateSegmentProgress()));
 }
 
 CurlDownload::~CurlDownload()
@@ -92,18 +99,13 @@ void CurlDownload::init(QString uri, QString dest)
 	
 	if(obj.url.userInfo().isEmpty())
 	{
-		QList<Auth> auths = Auth::loadAuths();
-		foreach(Auth a,auths)
+		Auth a;
+		if(Auth::find(uri, a))
 		{
-			if(!QRegExp(a.strRegExp).exactMatch(uri))
-				continue;
-			
 			obj.url.setUserName(a.strUser);
 			obj.url.setPassword(a.strPassword);
 			
 			enterLogMessage(tr("Loaded stored authentication data, matched regexp %1").arg(a.strRegExp));
-			
-			break;
 		}
 	}
 	
@@ -234,14 +236,24 @@ void CurlDownload::changeActive(bool bActive)
 			return;
 		}
 
+		fixActiveSegmentsList();
+
+		// Files that couldn't be split anyway don't need their own polling master
+		// nor periodic segment bookkeeping
+		if(m_nTotal && m_nTotal - d <= g_smallFileSize.value())
+		{
+			m_bFastPath = true;
+			l.unlock();
+			startSegment(m_listActiveSegments[0]);
+			return;
+		}
+
 		m_master = new CurlPollingMaster;
 		CurlPoller::instance()->addTransfer(m_master);
 		m_master->setMaxDown(m_nDownLimitInt);
 
 		qDebug() << "The limit is" << m_nDownLimitInt;
 
-		fixActiveSegmentsList();
-
 		if (m_nTotal)
 		{
 			for(int i=0;i<m_listActiveSegments.size();i++)
@@ -276,7 +288,7 @@ void CurlDownload::changeActive(bool bActive)
 			// 4) split the largest segment into halves
 			int odd = freeSegs[pos].bytes % 2;
 			qlonglong half = freeSegs[pos].bytes / 2;
-			if (half <= getSettingsValue("httpftp/minsegsize").toInt())
+			if (half <= g_minSegSize.value())
 				break;
 
 			freeSegs[pos].bytes = half + odd;
@@ -336,11 +348,18 @@ void CurlDownload::changeActive(bool bActive)
 				break;
 		}*/
 
-		// 8) update the segment progress every 500 miliseconds
-		m_timer.start(500);
+		// 8) update the segment progress along with the other transfers
+		connect(TickService::instance(), SIGNAL(transferTick()), this, SLOT(updateSegmentProgress()), Qt::UniqueConnection);
+
+		// 9) look for faster mirrors of a single-source download
+		if(m_urls.size() == 1 && !m_prober && getSettingsValue("httpftp/auto_mirrors").toInt() > 0)
+			probeMirrors();
 	}
-	else if(m_master != 0)
+	else if(isRunning())
 	{
+		delete m_prober;
+		m_prober = 0;
+
 		updateSegmentProgress();
 
 		m_segmentsLock.lockForWrite();
@@ -348,9 +367,8 @@ void CurlDownload::changeActive(bool bActive)
 		{
 			if(!m_segments[i].client)
 				continue;
-			m_master->removeTransfer(m_segments[i].client);
+			segmentPoller()->removeTransfer(m_segments[i].client);
 			m_segments[i].client->stop();
-			//delete m_segments[i].client;
 			m_segments[i].client = 0;
 			m_segments[i].color = Qt::black;
 		}
@@ -359,14 +377,25 @@ void CurlDownload::changeActive(bool bActive)
 		qDebug() << "After final simplify segments:" << m_segments;
 		m_segmentsLock.unlock();
 		m_nameChanger = 0;
-		m_timer.stop();
+		disconnect(TickService::instance(), SIGNAL(transferTick()), this, SLOT(updateSegmentProgress()));
 
-		CurlPoller::instance()->removeTransfer(m_master);
-		//delete m_master;
-		m_master = 0;
+		if(m_master != 0)
+		{
+			CurlPoller::instance()->removeTransfer(m_master);
+			m_master = 0;
+		}
+		m_bFastPath = false;
 	}
 }
 
+CurlPoller* CurlDownload::segmentPoller() const
+{
+	if(m_master != 0)
+		return m_master;
+	else
+		return CurlPoller::instance();
+}
+
 void CurlDownload::startSegment(Segment& seg, qlonglong bytes)
 {
 	qDebug() << "CurlDownload::startSegment(): seg offset:" << seg.offset << "; bytes:" << bytes;
@@ -382,6 +411,7 @@ void CurlDownload::startSegment(Segment& seg, qlonglong bytes)
 		setState(Failed);
 		return;
 	}
+	preallocate(file);
 	ExtendedAttributes::setAttribute(filePath(), ExtendedAttributes::ATTR_ORIGIN_URL, m_urls[0].url.toString().toUtf8());
 
 	seg.client = new UrlClient;
@@ -397,8 +427,81 @@ void CurlDownload::startSegment(Segment& seg, qlonglong bytes)
 	connect(seg.client, SIGNAL(rangesUnsupported()), this, SLOT(clientRangesUnsupported()));
 
 	seg.client->setPollingMaster(m_master);
+	if(!m_master)
+		seg.client->setMaxDown(m_nDownLimitInt);
 	seg.client->start();
-	m_master->addTransfer(static_cast<CurlUser*>(seg.client));
+	segmentPoller()->addTransfer(static_cast<CurlUser*>(seg.client));
+}
+
+void CurlDownload::probeMirrors()
+{
+	QStringList urls;
+	QMap<QString,QStringList> mirrors = MirrorProber::findMirrors(QStringList() << m_urls[0].url.toString());
+
+	foreach(const QStringList& list, mirrors)
+		urls << list;
+	if(urls.isEmpty())
+		return;
+
+	m_probedMirrors.clear();
+	m_prober = new MirrorProber(this);
+	connect(m_prober, SIGNAL(probed(QString,int,int)), this, SLOT(mirrorProbed(QString,int,int)));
+	connect(m_prober, SIGNAL(finished()), this, SLOT(mirrorsProbed()));
+	m_prober->probe(urls);
+}
+
+void CurlDownload::mirrorProbed(QString url, int, int response)
+{
+	if(response >= 0)
+		m_probedMirrors.insert(response, url);
+}
+
+void CurlDownload::mirrorsProbed()
+{
+	const int count = getSettingsValue("httpftp/auto_mirrors").toInt();
+	int added = 0;
+
+	m_prober->deleteLater();
+	m_prober = 0;
+
+	for(QMultiMap<int,QString>::const_iterator it = m_probedMirrors.constBegin(); it != m_probedMirrors.constEnd() && added < count; it++, added++)
+	{
+		UrlClient::UrlObject obj;
+
+		obj.url = it.value();
+		obj.proxy = m_urls[0].proxy;
+		obj.ftpMode = m_urls[0].ftpMode;
+		m_urls << obj;
+
+		// put the mirror to work right away, like a segment added by the user
+		m_listActiveSegments << m_urls.size()-1;
+		if(isActive() && m_nTotal)
+			startSegment(m_urls.size()-1);
+	}
+
+	if(added)
+		enterLogMessage(tr("Added %1 mirrors with the fastest response").arg(added));
+	m_probedMirrors.clear();
+}
+
+void CurlDownload::preallocate(int file)
+{
+	struct stat st;
+
+	// from now on, the file size says nothing about the progress
+	m_bSegmentsKnown = true;
+
+	if (m_nTotal <= 0 || fstat(file, &st) != 0 || st.st_size >= m_nTotal)
+		return;
+
+	// reserve the space upfront so that segments written out of order
+	// don't fragment the file or fail halfway on a full disk
+#ifdef __linux__
+	if (fallocate(file, 0, 0, m_nTotal) == 0)
+		return;
+#endif
+	if (ftruncate(file, m_nTotal) != 0)
+		enterLogMessage(tr("Failed to preallocate the file: %1").arg(strerror(errno)));
 }
 
 bool CurlDownload::Segment::operator<(const Segment& s2) const
@@ -422,6 +525,7 @@ void CurlDownload::setTargetName(QString newFileName)
 	{
 		m_dir.rename(m_strFile, newFileName);
 		m_strFile = newFileName;
+		notifyTextChanged();
 	}
 }
 
@@ -430,6 +534,15 @@ void CurlDownload::speeds(int& down, int& up) const
 	down = up = 0;
 	if(m_master != 0)
 		m_master->speeds(down, up);
+	else if(m_bFastPath)
+	{
+		QReadLocker l(&m_segmentsLock);
+		for(int i=0;i<m_segments.size();i++)
+		{
+			if(m_segments[i].client != 0)
+				m_segments[i].client->speeds(down, up);
+		}
+	}
 }
 
 qulonglong CurlDownload::total() const
@@ -442,8 +555,9 @@ qulonglong CurlDownload::done() const
 	m_segmentsLock.lockForRead();
 	qlonglong total = 0;
 
+	// active segments are read directly to stay current between ticks
 	for(int i=0;i<m_segments.size();i++)
-		total += m_segments[i].bytes;
+		total += m_segments[i].client ? m_segments[i].client->progress() : m_segments[i].bytes;
 
 	m_segmentsLock.unlock();
 	return total;
@@ -481,6 +595,8 @@ void CurlDownload::load(const QDomNode& map)
 	QDomElement segment, segments = map.firstChildElement("segments");
 	
 	m_segmentsLock.lockForWrite();
+	// queues saved by older versions have no segment list
+	m_bSegmentsKnown = !segments.isNull();
 	if(!segments.isNull())
 		segment = segments.firstChildElement("segment");
 	while(!segment.isNull())
@@ -568,7 +684,7 @@ void CurlDownload::autoCreateSegment()
 		return;
 	}
 
-	if(m_segments.isEmpty())
+	if(m_segments.isEmpty() && !m_bSegmentsKnown)
 	{
 		Segment s;
 
@@ -666,6 +782,15 @@ void CurlDownload::setSpeedLimits(int down, int)
 {
 	if(m_master != 0)
 		m_master->setMaxDown(down);
+	else if(m_bFastPath)
+	{
+		QReadLocker l(&m_segmentsLock);
+		for(int i=0;i<m_segments.size();i++)
+		{
+			if(m_segments[i].client != 0)
+				m_segments[i].client->setMaxDown(down);
+		}
+	}
 }
 
 
@@ -799,7 +924,7 @@ void CurlDownload::clientRangesUnsupported()
 
 	m_segmentsLock.unlock();
 
-	m_master->removeTransfer(client);
+	segmentPoller()->removeTransfer(client);
 	client->stop();
 
 	if (allfailed)
@@ -820,7 +945,7 @@ void CurlDownload::clientRangesUnsupported()
 
 void CurlDownload::clientFailure(QString err)
 {
-	if (!isActive() || !m_master)
+	if (!isActive() || !isRunning())
 		return;
 
 	qDebug() << "CurlDownload::clientFailure()" << err;
@@ -830,7 +955,7 @@ void CurlDownload::clientFailure(QString err)
 
 void CurlDownload::clientDone(QString error)
 {
-	if (!isActive() || !m_master)
+	if (!isActive() || !isRunning())
 		return;
 
 	UrlClient* client = static_cast<UrlClient*>(sender());
@@ -858,7 +983,7 @@ void CurlDownload::clientDone(QString error)
 
 	m_segmentsLock.unlock();
 
-	m_master->removeTransfer(client);
+	segmentPoller()->removeTransfer(client);
 	client->stop();
 	//client->deleteLater();
 
@@ -904,7 +1029,7 @@ void CurlDownload::clientDone(QString error)
 		//speeds(down, up);
 
 		// Only if it has a meaning
-		if (total()-done()*2 >= (qlonglong) getSettingsValue("httpftp/minsegsize").toInt() || m_listActiveSegments.size() == 1)
+		if (total()-done()*2 >= (qlonglong) g_minSegSize.value() || m_listActiveSegments.size() == 1)
 			startSegment(urlIndex);
 		else
 			m_listActiveSegments.removeOne(urlIndex);
@@ -935,7 +1060,7 @@ void CurlDownload::startSegment(int urlIndex)
 		seg.offset = (!m_segments.isEmpty()) ? m_segments[0].bytes : 0;
 	}
 	// No priority mode for downloads with a single thread
-	else if (!getSettingsValue("httpftp/priority_mode", false).toBool() || m_listActiveSegments.isEmpty())
+	else if (!g_priorityMode.value() || m_listActiveSegments.isEmpty())
 	{
 		for(int i=0;i<m_segments.size();i++)
 		{
@@ -981,7 +1106,7 @@ void CurlDownload::startSegment(int urlIndex)
 			//int odd = fs.bytes % 2;
 			qlonglong half = fs.bytes / 2;
 
-			if (half <= getSettingsValue("httpftp/minsegsize").toInt())
+			if (half <= g_minSegSize.value())
 			{
 				// remove the desired urlIndex from the list of active URLs
 				m_listActiveSegments.removeOne(urlIndex);
@@ -1008,7 +1133,7 @@ void CurlDownload::startSegment(int urlIndex)
 	{
 		// Find the first free spot smaller than seglim
 		// Try not to create a new freeseg bigger than 5*seglim
-		const int seglim = getSettingsValue("httpftp/minsegsize").toInt();
+		const int seglim = g_minSegSize.value();
 
 		for(int i=0;i<m_segments.size();i++)
 		{
@@ -1106,7 +1231,7 @@ void CurlDownload::stopSegment(int index, bool restarting)
 		return;
 	updateSegmentProgress();
 	s.urlIndex = -1;
-	m_master->removeTransfer(s.client);
+	segmentPoller()->removeTransfer(s.client);
 	s.client->stop();
 	s.client = 0;
 	simplifySegments(m_segments);
@@ -31,13 +31,15 @@ respects for all of the code used other than "OpenSSL".
 #include "engines/CurlUser.h"
 #include "engines/UrlClient.h"
 #include <QHash>
+#include <QMultiMap>
 #include <QUuid>
 #include <QDir>
 #include <QUrl>
-#include <QTimer>
 #include "StaticTransferMessage.h"
 
+class CurlPoller;
 class CurlPollingMaster;
+class MirrorProber;
 
 class CurlDownload : public StaticTransferMessage<Transfer>
 {
@@ -81,6 +83,8 @@ private slots:
 	void clientFailure(QString err);
 	void clientRangesUnsupported();
 	void updateSegmentProgress();
+	void mirrorProbed(QString url, int connect, int response);
+	void mirrorsProbed();
 private:
 	void generateName();
 	void init2(QString uri, QString dest);
@@ -130,7 +134,14 @@ protected:
 	QColor allocateSegmentColor();
 	void startSegment(Segment& seg, qlonglong bytes);
 	void startSegment(int urlIndex);
+	// extends the target file to the known total size
+	void preallocate(int file);
+	// adds the fastest mirrors from data/mirrors.txt, see httpftp/auto_mirrors
+	void probeMirrors();
 	void stopSegment(int index, bool restarting = false);
+	// the poller segment clients are added to
+	CurlPoller* segmentPoller() const;
+	bool isRunning() const { return m_master != 0 || m_bFastPath; }
 protected:
 	QDir m_dir;
 	long long m_nTotal;
@@ -143,11 +154,18 @@ protected:
 	
 	QList<UrlClient::UrlObject> m_urls;
 	QList<Segment> m_segments;
+	// m_segments is the only record of downloaded data; otherwise an
+	// existing file is taken as downloaded up to its size
+	bool m_bSegmentsKnown;
 	mutable QReadWriteLock m_segmentsLock;
 	CurlPollingMaster* m_master;
-	QTimer m_timer;
+	// small files run as a single client on the global poller
+	bool m_bFastPath;
 	UrlClient* m_nameChanger;
 	QList<int> m_listActiveSegments;
+	MirrorProber* m_prober;
+	// probed mirrors by their response time
+	QMultiMap<int,QString> m_probedMirrors;
 	
 	friend class HttpOptsWidget;
 	friend class HttpUrlOptsDlg;
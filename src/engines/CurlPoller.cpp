@@ -29,6 +29,8 @@ respects for all of the code used other than "OpenSSL".
 #include "CurlPollingMaster.h"
 #include <QtDebug>
 #include <cassert>
+#include <unistd.h>
+#include <fcntl.h>
 
 CurlPoller* CurlPoller::m_instance = 0;
 
@@ -45,8 +47,19 @@ CurlPoller::CurlPoller()
 	curl_multi_setopt(m_curlm, CURLMOPT_SOCKETFUNCTION, socket_callback);
 	curl_multi_setopt(m_curlm, CURLMOPT_SOCKETDATA, static_cast<CurlPoller*>(this));
 	
+	m_wakeupPipe[0] = m_wakeupPipe[1] = -1;
+	
 	if(!m_instance)
 	{
+		if(pipe(m_wakeupPipe) == 0)
+		{
+			fcntl(m_wakeupPipe[0], F_SETFL, O_NONBLOCK);
+			fcntl(m_wakeupPipe[1], F_SETFL, O_NONBLOCK);
+			m_poller->addSocket(m_wakeupPipe[0], Poller::PollerIn);
+		}
+		else
+			m_wakeupPipe[0] = m_wakeupPipe[1] = -1;
+		
 		m_instance = this;
 		start();
 	}
@@ -61,6 +74,11 @@ CurlPoller::~CurlPoller()
 	
 	if (this == m_instance)
 		m_instance = 0;
+	if (m_wakeupPipe[0] >= 0)
+	{
+		close(m_wakeupPipe[0]);
+		close(m_wakeupPipe[1]);
+	}
 	curl_multi_cleanup(m_curlm);
 	curl_global_cleanup();
 }
@@ -94,7 +112,13 @@ void CurlPoller::pollingCycle(bool oneshot)
 	for(int i=0;i<numEvents;i++)
 	{
 		int socket = events[i].socket;
-		if(!m_masters.contains(socket))
+		if(socket == m_wakeupPipe[0])
+		{
+			char buf[64];
+			while(read(socket, buf, sizeof(buf)) > 0);
+			resumePaused();
+		}
+		else if(!m_masters.contains(socket))
 		{
 			int mask = 0;
 
@@ -118,24 +142,17 @@ void CurlPoller::pollingCycle(bool oneshot)
 	else
 		m_timeout = m_curlTimeout;
 
-	while (!m_queueToDelete.isEmpty())
-	{
-		CurlUser* c = m_queueToDelete.dequeue();
-		CURL* handle = c->curlHandle();
+	deleteQueued();
 
-		qDebug() << "Deleting a queued CURL object:" << c << handle;
-		assert(!m_users.contains(handle));
-
-		for(sockets_hash::iterator it = m_sockets.begin(); it != m_sockets.end(); it++)
-		{
-			if (it.value().second == c)
-				m_socketsToRemove << it.key();
-		}
-
-		curl_multi_remove_handle(m_curlm, handle);
-		curl_easy_cleanup(handle);
-		delete c;
-		assert(!m_queueToDelete.contains(c));
+	// a removed master has no more events coming, its transfers can go with it
+	while (!m_mastersToDelete.isEmpty())
+	{
+		CurlPollingMaster* master = m_mastersToDelete.dequeue();
+		
+		master->m_usersLock.lock();
+		master->deleteQueued();
+		master->m_usersLock.unlock();
+		delete master;
 	}
 
 	for(int i = 0; i < m_socketsToRemove.size(); i++)
@@ -229,6 +246,68 @@ void CurlPoller::pollingCycle(bool oneshot)
 	m_usersLock.unlock();
 }
 
+void CurlPoller::deleteQueued()
+{
+	while (!m_queueToDelete.isEmpty())
+	{
+		CurlUser* c = m_queueToDelete.dequeue();
+		CURL* handle = c->curlHandle();
+
+		qDebug() << "Deleting a queued CURL object:" << c << handle;
+		assert(!m_users.contains(handle));
+
+		for(sockets_hash::iterator it = m_sockets.begin(); it != m_sockets.end(); it++)
+		{
+			if (it.value().second == c)
+				m_socketsToRemove << it.key();
+		}
+
+		curl_multi_remove_handle(m_curlm, handle);
+		curl_easy_cleanup(handle);
+		delete c;
+		assert(!m_queueToDelete.contains(c));
+	}
+}
+
+void CurlPoller::resumePaused()
+{
+	QList<CURL*> handles;
+
+	m_resumeLock.lock();
+	handles.swap(m_handlesToResume);
+	m_resumeLock.unlock();
+
+	foreach(CURL* handle, handles)
+	{
+		if(m_users.contains(handle))
+			curl_easy_pause(handle, CURLPAUSE_CONT);
+	}
+
+	foreach(CurlPollingMaster* master, m_masters)
+	{
+		QMutexLocker l(&master->m_usersLock);
+		master->resumePaused();
+	}
+}
+
+void CurlPoller::resumeTransfer(CURL* handle)
+{
+	QMutexLocker l(&m_resumeLock);
+	if(m_handlesToResume.contains(handle))
+		return;
+
+	m_handlesToResume << handle;
+
+	// sub-pollers are driven from the global poller's thread
+	int pipe = m_instance->m_wakeupPipe[1];
+	if(pipe >= 0)
+	{
+		char c = 0;
+		if(write(pipe, &c, 1) < 0)
+			qDebug() << "CurlPoller: failed to wake up the polling thread";
+	}
+}
+
 void CurlPoller::checkErrors(timeval tvNow)
 {
 	QMutexLocker l(&m_usersLock);
@@ -329,6 +408,10 @@ void CurlPoller::removeTransfer(CurlUser* obj, bool nodeep)
 	CURL* handle = obj->curlHandle();
 	if(handle != 0)
 	{
+		m_resumeLock.lock();
+		m_handlesToResume.removeAll(handle);
+		m_resumeLock.unlock();
+
 		if (!nodeep)
 		{
 			assert(!m_queueToDelete.contains(obj));
@@ -377,5 +460,8 @@ void CurlPoller::removeTransfer(CurlPollingMaster* obj)
 	m_masters.remove(handle);
 	m_sockets.remove(handle);
 	m_poller->removeSocket(handle);
+	
+	if(!m_mastersToDelete.contains(obj))
+		m_mastersToDelete.enqueue(obj);
 }
 
@@ -49,7 +49,10 @@ public:
 	void removeTransfer(CurlUser* obj, bool nodeep = false);
 	//void removeSafely(CURL* curl);
 	void addTransfer(CurlPollingMaster* obj);
+	// the master gets deleted too, along with the transfers removed from it
 	void removeTransfer(CurlPollingMaster* obj);
+	// thread safe, unpauses a handle paused with CURL_READFUNC_PAUSE
+	void resumeTransfer(CURL* handle);
 	
 	void run();
 	void checkErrors(timeval tvNow);
@@ -58,6 +61,9 @@ public:
 protected:
 	void epollEnable(int socket, int events);
 	void pollingCycle(bool oneshot);
+	void resumePaused();
+	// deletes the transfers removed since the last cycle
+	void deleteQueued();
 	static int socket_callback(CURL* easy, curl_socket_t s, int action, CurlPoller* This, void* socketp);
 	static int timer_callback(CURLM* multi, long newtimeout, long* timeout);
 	static void setTransferTimeout(int timeout);
@@ -79,10 +85,16 @@ protected:
 	sockets_hash m_sockets;
 	QMutex m_usersLock;
 	QQueue<CurlUser*> m_queueToDelete;
+	QQueue<CurlPollingMaster*> m_mastersToDelete;
 	
 	QList<int> m_socketsToRemove;
 	sockets_hash m_socketsToAdd;
 
+	// wakes up the polling thread when a paused handle is to be resumed
+	int m_wakeupPipe[2];
+	QMutex m_resumeLock;
+	QList<CURL*> m_handlesToResume;
+
 	friend class HttpFtpSettings;
 	friend class CurlDownload;
 	friend class CurlPollingMaster;
@@ -32,6 +32,11 @@ int CurlPollingMaster::handle()
 	return m_poller->handle();
 }
 
+void CurlPollingMaster::setMaxConnections(int count)
+{
+	curl_multi_setopt(m_curlm, CURLMOPT_MAXCONNECTS, long(count));
+}
+
 bool CurlPollingMaster::idleCycle(const timeval& tvNow)
 {
 	int dummy;
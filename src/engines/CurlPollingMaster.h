@@ -38,6 +38,8 @@ public:
 	void doWork();
 	int handle();
 	virtual bool idleCycle(const timeval& tvNow);
+	// limits the size of the connection cache shared by all handles of this master
+	void setMaxConnections(int count);
 };
 
 #endif
@@ -26,16 +26,18 @@ respects for all of the code used other than "OpenSSL".
 
 #include "CurlUpload.h"
 #include "CurlPoller.h"
+#include "CurlPollingMaster.h"
 #include "RuntimeException.h"
 #include "tools/HashDlg.h"
 #include "Proxy.h"
 #include "Auth.h"
 #include "Settings.h"
 #include <QFileInfo>
+#include <QStringList>
 #include <QMenu>
 
 CurlUpload::CurlUpload()
-	: m_curl(0), m_nDone(0), m_nTotal(0), m_mode(FtpPassive)
+	: m_curl(0), m_nDone(0), m_nTotal(0), m_mode(FtpPassive), m_chunkMaster(0), m_nChunkSize(0), m_nChunkSerial(0)
 {
 	Transfer::m_mode = Upload;
 	m_errorBuffer[0] = 0;
@@ -63,26 +65,21 @@ void CurlUpload::init(QString source, QString target)
 	if(m_strName.isEmpty())
 		m_strName = finfo.fileName();
 	
-	if(!target.startsWith("ftp://") && !target.startsWith("sftp://"))
-		throw RuntimeException(tr("Invalid protocol for this upload class (FTP)"));
+	if(!target.startsWith("ftp://") && !target.startsWith("sftp://") && !target.startsWith("http://") && !target.startsWith("https://"))
+		throw RuntimeException(tr("Invalid protocol for this upload class (FTP/HTTP)"));
 	
 	m_strTarget = target;
 	m_strSource = source;
 	
 	if(m_strTarget.userInfo().isEmpty())
 	{
-		QList<Auth> auths = Auth::loadAuths();
-		foreach(Auth a,auths)
+		Auth a;
+		if(Auth::find(target, a))
 		{
-			if(!QRegExp(a.strRegExp).exactMatch(target))
-				continue;
-			
 			m_strTarget.setUserName(a.strUser);
 			m_strTarget.setPassword(a.strPassword);
 			
 			enterLogMessage(tr("Loaded stored authentication data, matched regexp %1").arg(a.strRegExp));
-			
-			break;
 		}
 	}
 }
@@ -92,38 +89,101 @@ void CurlUpload::setObject(QString source)
 	m_strSource = source;
 }
 
-int CurlUpload::seek_function(QFile* file, curl_off_t offset, int origin)
+int CurlUpload::seek_function(ReadAheadBuffer* file, curl_off_t offset, int origin)
 {
 	qDebug() << "seek_function" << offset << origin;
 	
-	if(origin == SEEK_SET)
-	{
-		if(!file->seek(offset))
-			return -1;
-	}
-	else if(origin == SEEK_CUR)
+	if(origin == SEEK_CUR)
+		offset += file->pos();
+	else if(origin == SEEK_END)
+		offset += file->size();
+	else if(origin != SEEK_SET)
+		return -1;
+	
+	if(offset < 0 || offset > file->size())
+		return -1;
+	
+	file->seek(offset);
+	return 0;
+}
+
+int anti_crash_fun();
+
+QByteArray CurlUpload::targetUrl() const
+{
+	QByteArray ba;
+	ba = m_strTarget.toString().toUtf8();
+	if(!ba.endsWith("/"))
+		ba += '/';
+	int end = m_strSource.lastIndexOf('/');
+	
+	if(end < 0)
+		ba += m_strSource.toUtf8();
+	else
+		ba += m_strSource.mid(end+1).toUtf8();
+	return ba;
+}
+
+void CurlUpload::setupHandle(CURL* curl)
+{
+	curl_easy_setopt(curl, CURLOPT_UPLOAD, true);
+	curl_easy_setopt(curl, CURLOPT_USERAGENT, "FatRat/" VERSION);
+	curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, anti_crash_fun);
+	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, false);
+	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, false);
+	curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_function);
+	
+	int timeout = getSettingsValue("httpftp/timeout").toInt();
+	curl_easy_setopt(curl, CURLOPT_FTP_RESPONSE_TIMEOUT, timeout);
+	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, timeout);
+	
 	{
-		if(!file->seek(file->pos() + offset))
-			return -1;
+		QByteArray ba = m_strBindAddress.toUtf8();
+		if(!ba.isEmpty())
+			curl_easy_setopt(curl, CURLOPT_INTERFACE, ba.constData());
 	}
-	else if(origin == SEEK_END)
+	
+	Proxy proxy = Proxy::getProxy(m_proxy);
+	if(proxy.nType != Proxy::ProxyNone)
 	{
-		if(!file->seek(file->size() + offset))
-			return -1;
+		QByteArray p;
+		
+		if(proxy.strUser.isEmpty())
+			p = QString("%1:%2").arg(proxy.strIP).arg(proxy.nPort).toLatin1();
+		else
+			p = QString("%1:%2@%3:%4").arg(proxy.strUser).arg(proxy.strPassword).arg(proxy.strIP).arg(proxy.nPort).toLatin1();
+		curl_easy_setopt(curl, CURLOPT_PROXY, p.constData());
+		
+		int type;
+		if(proxy.nType == Proxy::ProxySocks5)
+			type = CURLPROXY_SOCKS5;
+		else if(proxy.nType == Proxy::ProxyHttp)
+			type = CURLPROXY_HTTP;
+		else
+			type = 0;
+		curl_easy_setopt(curl, CURLOPT_PROXYTYPE, type);
 	}
 	else
-		return -1;
-	return 0;
+		curl_easy_setopt(curl, CURLOPT_PROXY, "");
 }
 
-int anti_crash_fun();
+bool CurlUpload::isSegmented() const
+{
+	QString scheme = m_strTarget.scheme();
+	return scheme == "http" || scheme == "https";
+}
 
 void CurlUpload::changeActive(bool nowActive)
 {
 	if(nowActive)
 	{
-		m_file.setFileName(m_strSource);
-		if(!m_file.open(QIODevice::ReadOnly))
+		if(isSegmented())
+		{
+			startSegmented();
+			return;
+		}
+		
+		if(!m_file.open(m_strSource))
 		{
 			enterLogMessage(m_strMessage = m_file.errorString());
 			setState(Failed);
@@ -133,20 +193,15 @@ void CurlUpload::changeActive(bool nowActive)
 		m_nTotal = m_file.size();
 		
 		m_curl = curl_easy_init();
-		curl_easy_setopt(m_curl, CURLOPT_UPLOAD, true);
-		curl_easy_setopt(m_curl, CURLOPT_INFILESIZE_LARGE, total());
+		m_file.setCurlHandle(m_curl);
+		m_file.seek(0);
+		setupHandle(m_curl);
 		curl_easy_setopt(m_curl, CURLOPT_RESUME_FROM_LARGE, -1LL);
 		curl_easy_setopt(m_curl, CURLOPT_INFILESIZE_LARGE, m_nTotal);
-		curl_easy_setopt(m_curl, CURLOPT_USERAGENT, "FatRat/" VERSION);
 		curl_easy_setopt(m_curl, CURLOPT_USE_SSL, CURLUSESSL_TRY);
 		curl_easy_setopt(m_curl, CURLOPT_FTP_FILEMETHOD, CURLFTPMETHOD_SINGLECWD);
-		curl_easy_setopt(m_curl, CURLOPT_PROGRESSFUNCTION, anti_crash_fun);
 		
 		curl_easy_setopt(m_curl, CURLOPT_ERRORBUFFER, m_errorBuffer);
-		curl_easy_setopt(m_curl, CURLOPT_SSL_VERIFYPEER, false);
-		curl_easy_setopt(m_curl, CURLOPT_SSL_VERIFYHOST, false);
-		
-		curl_easy_setopt(m_curl, CURLOPT_READFUNCTION, read_function);
 		curl_easy_setopt(m_curl, CURLOPT_READDATA, static_cast<CurlUser*>(this));
 		
 		curl_easy_setopt(m_curl, CURLOPT_SEEKFUNCTION, seek_function);
@@ -155,57 +210,16 @@ void CurlUpload::changeActive(bool nowActive)
 		curl_easy_setopt(m_curl, CURLOPT_DEBUGDATA, this);
 		curl_easy_setopt(m_curl, CURLOPT_VERBOSE, true);
 		
-		int timeout = getSettingsValue("httpftp/timeout").toInt();
-		curl_easy_setopt(m_curl, CURLOPT_FTP_RESPONSE_TIMEOUT, timeout);
-		curl_easy_setopt(m_curl, CURLOPT_CONNECTTIMEOUT, timeout);
-		
-		{
-			QByteArray ba;
-			ba = m_strTarget.toString().toUtf8();
-			if(!ba.endsWith("/"))
-				ba += '/';
-			int end = m_strSource.lastIndexOf('/');
-			
-			if(end < 0)
-				ba += m_strSource.toUtf8();
-			else
-				ba += m_strSource.mid(end+1).toUtf8();
-			curl_easy_setopt(m_curl, CURLOPT_URL, ba.constData());
-		}
-		{
-			QByteArray ba = m_strBindAddress.toUtf8();
-			if(!ba.isEmpty())
-				curl_easy_setopt(m_curl, CURLOPT_INTERFACE, ba.constData());
-		}
+		QByteArray url = targetUrl();
+		curl_easy_setopt(m_curl, CURLOPT_URL, url.constData());
 		
 		if(m_mode == FtpActive)
 			curl_easy_setopt(m_curl, CURLOPT_FTPPORT, "-");
 		
-		Proxy proxy = Proxy::getProxy(m_proxy);
-		if(proxy.nType != Proxy::ProxyNone)
-		{
-			QByteArray p;
-			
-			if(proxy.strUser.isEmpty())
-				p = QString("%1:%2").arg(proxy.strIP).arg(proxy.nPort).toLatin1();
-			else
-				p = QString("%1:%2@%3:%4").arg(proxy.strUser).arg(proxy.strPassword).arg(proxy.strIP).arg(proxy.nPort).toLatin1();
-			curl_easy_setopt(m_curl, CURLOPT_PROXY, p.constData());
-			
-			int type;
-			if(proxy.nType == Proxy::ProxySocks5)
-				type = CURLPROXY_SOCKS5;
-			else if(proxy.nType == Proxy::ProxyHttp)
-				type = CURLPROXY_HTTP;
-			else
-				type = 0;
-			curl_easy_setopt(m_curl, CURLOPT_PROXYTYPE, type);
-		}
-		else
-			curl_easy_setopt(m_curl, CURLOPT_PROXY, "");
-		
 		CurlPoller::instance()->addTransfer(this);
 	}
+	else if(m_chunkMaster != 0)
+		stopSegmented();
 	else
 	{
 		m_nDone = done();
@@ -218,9 +232,204 @@ void CurlUpload::changeActive(bool nowActive)
 	}
 }
 
+void CurlUpload::startSegmented()
+{
+	m_nTotal = QFileInfo(m_strSource).size();
+	m_strMessage.clear();
+	
+	// the chunk size must stay the same as long as there is a saved progress
+	const qint64 chunkSize = getSettingsValue("httpftp/upload_chunksize").toLongLong();
+	if(m_nChunkSize <= 0 || m_chunksDone.isEmpty())
+		m_nChunkSize = qMax<qint64>(chunkSize, 64*1024);
+	
+	int chunks = int((m_nTotal + m_nChunkSize - 1) / m_nChunkSize);
+	if(m_chunksDone.size() != chunks)
+		m_chunksDone = QVector<bool>(qMax(chunks, 1), false);
+	
+	m_chunkRetries.clear();
+	m_nChunkSerial++;
+	
+	m_chunkMaster = new CurlPollingMaster;
+	CurlPoller::instance()->addTransfer(m_chunkMaster);
+	m_chunkMaster->setMaxUp(m_nUpLimitInt);
+	
+	startChunks();
+}
+
+void CurlUpload::stopSegmented()
+{
+	// the poller deletes the clients, joining their read-ahead threads,
+	// and then the master itself
+	foreach(ChunkClient* client, m_chunkClients)
+		m_chunkMaster->removeTransfer(client);
+	m_chunkClients.clear();
+	
+	CurlPoller::instance()->removeTransfer(m_chunkMaster);
+	m_chunkMaster = 0;
+	m_nDone = chunkedDone();
+}
+
+CurlUpload::ChunkClient* CurlUpload::findChunk(int index) const
+{
+	foreach(ChunkClient* client, m_chunkClients)
+	{
+		if(client->index() == index)
+			return client;
+	}
+	return 0;
+}
+
+void CurlUpload::startChunks()
+{
+	const int connections = qMax(1, getSettingsValue("httpftp/upload_connections").toInt());
+	const UploadProtocol protocol = UploadProtocol(getSettingsValue("httpftp/upload_protocol").toInt());
+	const QByteArray url = targetUrl();
+	
+	for(int i=0;i<m_chunksDone.size() && m_chunkClients.size() < connections;i++)
+	{
+		if(m_chunksDone[i] || findChunk(i))
+			continue;
+		
+		qint64 offset = i*m_nChunkSize;
+		qint64 length = qMin(m_nChunkSize, m_nTotal - offset);
+		ChunkClient* client = new ChunkClient(this, m_nChunkSerial, i, offset, length);
+		
+		if(!client->open(m_strSource, m_chunkMaster))
+		{
+			enterLogMessage(m_strMessage = client->errorString());
+			curl_easy_cleanup(client->curlHandle());
+			delete client;
+			setState(Failed);
+			return;
+		}
+		
+		CURL* curl = client->curlHandle();
+		setupHandle(curl);
+		curl_easy_setopt(curl, CURLOPT_READDATA, static_cast<CurlUser*>(client));
+		curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, curl_off_t(length));
+		curl_easy_setopt(curl, CURLOPT_FAILONERROR, true);
+		
+		if(protocol == QueryParameters)
+		{
+			QByteArray chunkUrl = url;
+			chunkUrl += url.contains('?') ? '&' : '?';
+			chunkUrl += QString("offset=%1&length=%2&total=%3&chunk=%4&chunks=%5")
+				.arg(offset).arg(length).arg(m_nTotal).arg(i).arg(m_chunksDone.size()).toLatin1();
+			curl_easy_setopt(curl, CURLOPT_URL, chunkUrl.constData());
+		}
+		else
+		{
+			QByteArray range = QString("Content-Range: bytes %1-%2/%3")
+				.arg(offset).arg(offset+length-1).arg(m_nTotal).toLatin1();
+			client->addHeader(range);
+			curl_easy_setopt(curl, CURLOPT_URL, url.constData());
+		}
+		
+		m_chunkClients << client;
+		m_chunkMaster->addTransfer(static_cast<CurlUser*>(client));
+	}
+}
+
+void CurlUpload::chunkDone(int serial, int index, int result, QString error)
+{
+	ChunkClient* client = findChunk(index);
+	
+	if(serial != m_nChunkSerial || !client || !isActive())
+		return;
+	
+	m_chunkClients.removeOne(client);
+	m_chunkMaster->removeTransfer(client);
+	
+	if(result == CURLE_OK)
+	{
+		m_chunksDone[index] = true;
+		m_chunkRetries.remove(index);
+		m_nDone = chunkedDone();
+	}
+	else if(++m_chunkRetries[index] > MAX_CHUNK_RETRIES)
+	{
+		enterLogMessage(m_strMessage = tr("Chunk %1 failed: %2").arg(index).arg(error));
+		setState(Failed);
+		return;
+	}
+	else
+		enterLogMessage(tr("Chunk %1 failed, retrying: %2").arg(index).arg(error));
+	
+	if(!m_chunksDone.contains(false))
+	{
+		m_nDone = m_nTotal;
+		setState(Completed);
+	}
+	else
+		startChunks();
+}
+
+qint64 CurlUpload::chunkedDone() const
+{
+	qint64 d = 0;
+	
+	for(int i=0;i<m_chunksDone.size();i++)
+	{
+		if(m_chunksDone[i])
+			d += qMin(m_nChunkSize, m_nTotal - i*m_nChunkSize);
+	}
+	foreach(ChunkClient* client, m_chunkClients)
+		d += client->progress();
+	
+	return d;
+}
+
+QString CurlUpload::chunksToString() const
+{
+	QStringList ranges;
+	
+	for(int i=0;i<m_chunksDone.size();i++)
+	{
+		if(!m_chunksDone[i])
+			continue;
+		
+		int j = i;
+		while(j+1 < m_chunksDone.size() && m_chunksDone[j+1])
+			j++;
+		
+		if(i == j)
+			ranges << QString::number(i);
+		else
+			ranges << QString("%1-%2").arg(i).arg(j);
+		i = j;
+	}
+	
+	return ranges.join(",");
+}
+
+void CurlUpload::chunksFromString(QString str, int count)
+{
+	m_chunksDone = QVector<bool>(count, false);
+	
+	foreach(QString range, str.split(',', QString::SkipEmptyParts))
+	{
+		int dash = range.indexOf('-');
+		int from = range.left(dash).toInt();
+		int to = (dash < 0) ? from : range.mid(dash+1).toInt();
+		
+		for(int i=qMax(from, 0);i<=to && i<count;i++)
+			m_chunksDone[i] = true;
+	}
+}
+
 size_t CurlUpload::readData(char* buffer, size_t maxData)
 {
-	return m_file.read(buffer, maxData);
+	qint64 rd = m_file.read(buffer, maxData);
+	
+	if(rd == ReadAheadBuffer::WouldBlock)
+		return CURL_READFUNC_PAUSE;
+	else if(rd < 0)
+	{
+		m_strMessage = m_file.errorString();
+		return CURL_READFUNC_ABORT;
+	}
+	else
+		return size_t(rd);
 }
 
 int CurlUpload::curl_debug_callback(CURL*, curl_infotype type, char* text, size_t bytes, CurlUpload* This)
@@ -239,16 +448,23 @@ int CurlUpload::curl_debug_callback(CURL*, curl_infotype type, char* text, size_
 void CurlUpload::setSpeedLimits(int, int up)
 {
 	m_up.max = up;
+	if(m_chunkMaster != 0)
+		m_chunkMaster->setMaxUp(up);
 }
 
 void CurlUpload::speeds(int& down, int& up) const
 {
-	CurlUser::speeds(down, up);
+	if(m_chunkMaster != 0)
+		m_chunkMaster->speeds(down, up);
+	else
+		CurlUser::speeds(down, up);
 }
 
 qulonglong CurlUpload::done() const
 {
-	if(!m_curl)
+	if(m_chunkMaster != 0)
+		return chunkedDone();
+	else if(!m_curl)
 		return m_nDone;
 	else
 	{
@@ -278,6 +494,7 @@ void CurlUpload::load(const QDomNode& map)
 	m_nDone = getXMLProperty(map, "done").toLongLong();
 	m_proxy = getXMLProperty(map, "proxy");
 	m_strBindAddress = getXMLProperty(map, "bindaddr");
+	m_nChunkSize = getXMLProperty(map, "chunksize").toLongLong();
 	
 	try
 	{
@@ -288,6 +505,9 @@ void CurlUpload::load(const QDomNode& map)
 		setState(Failed);
 		m_strMessage = e.what();
 	}
+	
+	if(m_nChunkSize > 0)
+		chunksFromString(getXMLProperty(map, "chunks"), int((m_nTotal + m_nChunkSize - 1) / m_nChunkSize));
 }
 
 void CurlUpload::save(QDomDocument& doc, QDomNode& map) const
@@ -298,17 +518,25 @@ void CurlUpload::save(QDomDocument& doc, QDomNode& map) const
 	setXMLProperty(doc, map, "target", m_strTarget.toString());
 	setXMLProperty(doc, map, "name", m_strName);
 	setXMLProperty(doc, map, "ftpmode", QString::number(m_mode));
-	setXMLProperty(doc, map, "done", QString::number(m_nDone));
+	setXMLProperty(doc, map, "done", QString::number(done()));
 	setXMLProperty(doc, map, "proxy", m_proxy.toString());
 	setXMLProperty(doc, map, "bindaddr", m_strBindAddress);
+	
+	if(isSegmented())
+	{
+		setXMLProperty(doc, map, "chunksize", QString::number(m_nChunkSize));
+		setXMLProperty(doc, map, "chunks", chunksToString());
+	}
 }
 
 int CurlUpload::acceptable(QString url, bool bDrop)
 {
 	if(bDrop)
 		return (url.startsWith("file://") || url.startsWith("/")) ? 2 : 0;
+	else if(url.startsWith("ftp://") || url.startsWith("sftp://"))
+		return 2;
 	else
-		return (url.startsWith("ftp://") || url.startsWith("sftp://")) ? 2 : 0;
+		return (url.startsWith("http://") || url.startsWith("https://")) ? 1 : 0;
 }
 
 CURL* CurlUpload::curlHandle()
@@ -361,6 +589,73 @@ QString CurlUpload::remoteURI() const
 
 ///////////////////////////////////////////
 
+CurlUpload::ChunkClient::ChunkClient(CurlUpload* upload, int serial, int index, qint64 offset, qint64 length)
+	: m_upload(upload), m_nSerial(serial), m_nIndex(index), m_nOffset(offset), m_nLength(length), m_nSent(0),
+	  m_reader(256*1024, 4), m_headers(0)
+{
+	m_curl = curl_easy_init();
+	m_errorBuffer[0] = 0;
+	curl_easy_setopt(m_curl, CURLOPT_ERRORBUFFER, m_errorBuffer);
+}
+
+CurlUpload::ChunkClient::~ChunkClient()
+{
+	// the handle itself is cleaned up by the poller
+	m_reader.close();
+	curl_slist_free_all(m_headers);
+}
+
+bool CurlUpload::ChunkClient::open(QString path, CurlPollingMaster* master)
+{
+	if(!m_reader.open(path))
+		return false;
+	
+	setSegmentMaster(master);
+	m_reader.setCurlHandle(m_curl, master);
+	m_reader.seek(m_nOffset, m_nLength);
+	return true;
+}
+
+void CurlUpload::ChunkClient::addHeader(const QByteArray& header)
+{
+	m_headers = curl_slist_append(m_headers, header.constData());
+	curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, m_headers);
+}
+
+size_t CurlUpload::ChunkClient::readData(char* buffer, size_t maxData)
+{
+	qint64 rd = m_reader.read(buffer, qMin<qint64>(maxData, m_nLength - m_nSent));
+	
+	if(rd == ReadAheadBuffer::WouldBlock)
+		return CURL_READFUNC_PAUSE;
+	else if(rd < 0)
+		return CURL_READFUNC_ABORT;
+	
+	m_nSent += rd;
+	return size_t(rd);
+}
+
+void CurlUpload::ChunkClient::transferDone(CURLcode result)
+{
+	QString error;
+	
+	if(result == CURLE_OK && m_nSent != m_nLength)
+		result = CURLE_READ_ERROR;
+	
+	if(result != CURLE_OK)
+		error = m_errorBuffer[0] ? QString::fromUtf8(m_errorBuffer) : QString(curl_easy_strerror(result));
+	
+	QMetaObject::invokeMethod(m_upload, "chunkDone", Qt::QueuedConnection, Q_ARG(int, m_nSerial),
+				  Q_ARG(int, m_nIndex), Q_ARG(int, int(result)), Q_ARG(QString, error));
+}
+
+QString CurlUpload::ChunkClient::errorString() const
+{
+	return m_reader.errorString();
+}
+
+///////////////////////////////////////////
+
 FtpUploadOptsForm::FtpUploadOptsForm(QWidget* me, CurlUpload* myobj)
 	: m_upload(myobj)
 {
@@ -422,6 +717,8 @@ bool FtpUploadOptsForm::accept()
 	
 	acc |= lineTarget->text().startsWith("ftp://");
 	acc |= lineTarget->text().startsWith("sftp://");
+	acc |= lineTarget->text().startsWith("http://");
+	acc |= lineTarget->text().startsWith("https://");
 	
 	return acc;
 }
@@ -28,6 +28,7 @@ respects for all of the code used other than "OpenSSL".
 #define CURLUPLOAD_H
 #include "Transfer.h"
 #include "CurlUser.h"
+#include "ReadAheadBuffer.h"
 #include "fatrat.h"
 #include "ui_FtpUploadOptsForm.h"
 #include "WidgetHostChild.h"
@@ -35,8 +36,12 @@ respects for all of the code used other than "OpenSSL".
 #include <QUuid>
 #include <QFile>
 #include <QUrl>
+#include <QVector>
+#include <QMap>
 #include <curl/curl.h>
 
+class CurlPollingMaster;
+
 class CurlUpload : public Transfer, public CurlUser
 {
 Q_OBJECT
@@ -70,23 +75,74 @@ public:
 	virtual QString remoteURI() const;
 protected slots:
 	void computeHash();
+	void chunkDone(int serial, int index, int result, QString error);
+protected:
+	// Sends one range of the file in the segmented HTTP mode
+	class ChunkClient : public CurlUser
+	{
+	public:
+		ChunkClient(CurlUpload* upload, int serial, int index, qint64 offset, qint64 length);
+		virtual ~ChunkClient();
+		
+		bool open(QString path, CurlPollingMaster* master);
+		void addHeader(const QByteArray& header);
+		QString errorString() const;
+		int index() const { return m_nIndex; }
+		qint64 progress() const { return m_nSent; }
+		
+		virtual CURL* curlHandle() { return m_curl; }
+		virtual void transferDone(CURLcode result);
+		virtual size_t readData(char* buffer, size_t maxData);
+	private:
+		CurlUpload* m_upload;
+		int m_nSerial, m_nIndex;
+		qint64 m_nOffset, m_nLength, m_nSent;
+		ReadAheadBuffer m_reader;
+		CURL* m_curl;
+		curl_slist* m_headers;
+		char m_errorBuffer[CURL_ERROR_SIZE];
+	};
+	
+	// How the ranges are described to the HTTP server
+	enum UploadProtocol { ContentRangePut = 0, QueryParameters };
+	static const int MAX_CHUNK_RETRIES = 3;
+	
+	bool isSegmented() const;
+	void startSegmented();
+	void stopSegmented();
+	void startChunks();
+	ChunkClient* findChunk(int index) const;
+	qint64 chunkedDone() const;
+	QString chunksToString() const;
+	void chunksFromString(QString str, int count);
+	
+	QByteArray targetUrl() const;
+	void setupHandle(CURL* curl);
 protected:
 	virtual CURL* curlHandle();
 	virtual void transferDone(CURLcode result);
 	virtual size_t readData(char* buffer, size_t maxData);
 	
-	static int seek_function(QFile* file, curl_off_t offset, int origin);
+	static int seek_function(ReadAheadBuffer* file, curl_off_t offset, int origin);
 	static int curl_debug_callback(CURL*, curl_infotype type, char* text, size_t bytes, CurlUpload* This);
 protected:
 	CURL* m_curl;
 	qint64 m_nDone, m_nTotal;
-	QFile m_file;
+	ReadAheadBuffer m_file;
 	QString m_strSource, m_strMessage, m_strName, m_strBindAddress;
 	QUrl m_strTarget;
 	FtpMode m_mode;
 	QUuid m_proxy;
 	char m_errorBuffer[CURL_ERROR_SIZE];
 	
+	// segmented HTTP mode
+	CurlPollingMaster* m_chunkMaster;
+	qint64 m_nChunkSize;
+	int m_nChunkSerial;
+	QVector<bool> m_chunksDone;
+	QMap<int,int> m_chunkRetries;
+	QList<ChunkClient*> m_chunkClients;
+	
 	friend class FtpUploadOptsForm;
 };
 
@@ -0,0 +1,291 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "CurlUploadTest.h"
+#include "CurlUpload.h"
+#include "Settings.h"
+#include "RuntimeException.h"
+#include <QTcpSocket>
+#include <QTemporaryFile>
+#include <QEventLoop>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QRegExp>
+#include <QDomDocument>
+#include <QtDebug>
+#include <iostream>
+
+// three full chunks of the smallest allowed size and a partial one
+static const int CHUNK_SIZE = 64*1024;
+static const int FILE_SIZE = 3*CHUNK_SIZE + 1234;
+static const int CHUNKS = (FILE_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE;
+// for each upload, in ms
+static const int UPLOAD_TIMEOUT = 30000;
+
+CurlUploadTest::CurlUploadTest()
+	: m_nProtocol(0), m_nRequests(0), m_nFailChunk(-1), m_loop(0)
+{
+	connect(&m_server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+int CurlUploadTest::run()
+{
+	if(!m_server.listen(QHostAddress::LocalHost))
+	{
+		std::cerr << "curlupload: cannot listen: " << m_server.errorString().toLocal8Bit().constData() << std::endl;
+		return 1;
+	}
+	
+	QTemporaryFile file;
+	if(!file.open())
+	{
+		std::cerr << "curlupload: cannot create a temporary file" << std::endl;
+		return 1;
+	}
+	
+	m_data.resize(FILE_SIZE);
+	for(int i=0;i<m_data.size();i++)
+		m_data[i] = char(qrand());
+	file.write(m_data);
+	file.flush();
+	
+	const char* keys[] = { "httpftp/upload_chunksize", "httpftp/upload_connections", "httpftp/upload_protocol" };
+	QVariant saved[3];
+	
+	for(int i=0;i<3;i++)
+		saved[i] = getSettingsValue(keys[i]);
+	setSettingsValue("httpftp/upload_chunksize", CHUNK_SIZE);
+	setSettingsValue("httpftp/upload_connections", 3);
+	
+	bool ok = runCase("Content-Range", file.fileName(), 0)
+		&& runCase("query parameters", file.fileName(), 1)
+		&& runCase("chunk retry", file.fileName(), 0, 1)
+		&& runCase("resume", file.fileName(), 0, -1, "0,2");
+	
+	for(int i=0;i<3;i++)
+		setSettingsValue(keys[i], saved[i]);
+	
+	if(ok)
+		std::cout << "curlupload: PASS" << std::endl;
+	else
+		std::cout << "curlupload: FAIL: " << m_strError.toLocal8Bit().constData() << std::endl;
+	return ok ? 0 : 1;
+}
+
+bool CurlUploadTest::runCase(QString name, QString file, int protocol, int failChunk, QString savedChunks)
+{
+	QEventLoop loop;
+	QTimer timer;
+	CurlUpload* upload = new CurlUpload;
+	const QString target = QString("http://127.0.0.1:%1/upload/").arg(m_server.serverPort());
+	
+	setSettingsValue("httpftp/upload_protocol", protocol);
+	m_nProtocol = protocol;
+	m_nRequests = 0;
+	m_nFailChunk = failChunk;
+	m_skipChunks.clear();
+	m_received = QByteArray(m_data.size(), 0);
+	m_strError.clear();
+	m_loop = &loop;
+	
+	try
+	{
+		if(savedChunks.isEmpty())
+			upload->init(file, target);
+		else
+		{
+			// the state an interrupted upload leaves behind
+			QDomDocument doc;
+			QDomElement elem = doc.createElement("download");
+			
+			Transfer::setXMLProperty(doc, elem, "source", file);
+			Transfer::setXMLProperty(doc, elem, "target", target);
+			Transfer::setXMLProperty(doc, elem, "chunksize", QString::number(CHUNK_SIZE));
+			Transfer::setXMLProperty(doc, elem, "chunks", savedChunks);
+			upload->load(elem);
+			
+			foreach(QString chunk, savedChunks.split(','))
+			{
+				const int index = chunk.toInt();
+				m_skipChunks << index;
+				m_received.replace(index*CHUNK_SIZE, qMin(CHUNK_SIZE, FILE_SIZE - index*CHUNK_SIZE),
+						   m_data.mid(index*CHUNK_SIZE, CHUNK_SIZE));
+			}
+		}
+	}
+	catch(const RuntimeException& e)
+	{
+		delete upload;
+		m_strError = name + ": " + e.what();
+		return false;
+	}
+	
+	connect(upload, SIGNAL(stateChanged(Transfer::State,Transfer::State)), this, SLOT(uploadStateChanged(Transfer::State,Transfer::State)));
+	connect(&timer, SIGNAL(timeout()), this, SLOT(uploadTimeout()));
+	timer.setSingleShot(true);
+	timer.start(UPLOAD_TIMEOUT);
+	
+	upload->setState(Transfer::Active);
+	loop.exec();
+	
+	m_loop = 0;
+	upload->disconnect(this);
+	if(upload->isActive())
+		upload->setState(Transfer::Paused);
+	upload->deleteLater();
+	
+	// one request per chunk not finished before, plus the refused one
+	const int expected = CHUNKS - m_skipChunks.size() + (failChunk >= 0 ? 1 : 0);
+	
+	if(m_strError.isEmpty() && upload->state() != Transfer::Completed)
+		m_strError = upload->message();
+	if(m_strError.isEmpty() && m_received != m_data)
+		m_strError = "the uploaded data differ from the file";
+	if(m_strError.isEmpty() && m_nRequests != expected)
+		m_strError = QString("expected %1 requests, got %2").arg(expected).arg(m_nRequests);
+	if(m_strError.isEmpty() && m_nFailChunk >= 0)
+		m_strError = "the refused chunk hasn't been sent at all";
+	
+	if(!m_strError.isEmpty())
+		m_strError = QString("%1: %2").arg(name).arg(m_strError);
+	return m_strError.isEmpty();
+}
+
+void CurlUploadTest::uploadStateChanged(Transfer::State, Transfer::State now)
+{
+	if(m_loop && (now == Transfer::Completed || now == Transfer::Failed))
+		m_loop->quit();
+}
+
+void CurlUploadTest::uploadTimeout()
+{
+	fail("the upload has timed out");
+}
+
+void CurlUploadTest::fail(QString error)
+{
+	if(m_strError.isEmpty())
+		m_strError = error;
+	if(m_loop)
+		m_loop->quit();
+}
+
+void CurlUploadTest::newConnection()
+{
+	while(QTcpSocket* socket = m_server.nextPendingConnection())
+	{
+		connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+		connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+		m_buffers[socket] = QByteArray();
+	}
+}
+
+void CurlUploadTest::readRequest()
+{
+	QTcpSocket* socket = static_cast<QTcpSocket*>(sender());
+	QByteArray& buffer = m_buffers[socket];
+	
+	buffer += socket->readAll();
+	if(processRequest(socket, buffer))
+		m_buffers.remove(socket);
+}
+
+bool CurlUploadTest::processRequest(QTcpSocket* socket, QByteArray& buffer)
+{
+	int end = buffer.indexOf("\r\n\r\n");
+	if(end < 0)
+		return false;
+	
+	QString head = QString::fromLatin1(buffer.left(end));
+	QStringList lines = head.split("\r\n");
+	QStringList request = lines.takeFirst().split(' ');
+	QMap<QString,QString> headers;
+	
+	foreach(QString line, lines)
+	{
+		int colon = line.indexOf(':');
+		if(colon > 0)
+			headers[line.left(colon).trimmed().toLower()] = line.mid(colon+1).trimmed();
+	}
+	
+	const qint64 length = headers["content-length"].toLongLong();
+	
+	// libcurl waits for this before sending larger bodies
+	if(buffer.size() == end+4 && headers["expect"].compare("100-continue", Qt::CaseInsensitive) == 0)
+	{
+		socket->write("HTTP/1.1 100 Continue\r\n\r\n");
+	}
+	
+	if(buffer.size() < end+4+length)
+		return false;
+	
+	QByteArray body = buffer.mid(end+4, length);
+	qint64 offset = -1;
+	
+	if(request.size() < 2 || request[0] != "PUT")
+		fail("unexpected request: " + request.join(" "));
+	else if(m_nProtocol == 0)
+	{
+		QRegExp re("bytes (\\d+)-(\\d+)/(\\d+)");
+		if(re.exactMatch(headers["content-range"]) && re.cap(3).toLongLong() == m_data.size()
+			&& re.cap(2).toLongLong() - re.cap(1).toLongLong() + 1 == length)
+			offset = re.cap(1).toLongLong();
+		else
+			fail("bad Content-Range: " + headers["content-range"]);
+	}
+	else
+	{
+		QUrlQuery query(QUrl(request[1]).query());
+		if(query.queryItemValue("length").toLongLong() == length && query.queryItemValue("total").toLongLong() == m_data.size())
+			offset = query.queryItemValue("offset").toLongLong();
+		else
+			fail("bad query: " + request[1]);
+	}
+	
+	const int chunk = (offset >= 0) ? int(offset / CHUNK_SIZE) : -1;
+	
+	if(chunk >= 0)
+		m_nRequests++;
+	if(m_skipChunks.contains(chunk))
+		fail(QString("chunk %1 has been resent after resuming").arg(chunk));
+	
+	if(chunk >= 0 && chunk == m_nFailChunk)
+	{
+		m_nFailChunk = -1;
+		socket->write("HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+	}
+	else if(chunk >= 0 && offset + length <= m_received.size())
+	{
+		m_received.replace(offset, length, body);
+		socket->write("HTTP/1.1 201 Created\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+	}
+	else
+		socket->write("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+	
+	socket->disconnectFromHost();
+	return true;
+}
@@ -0,0 +1,74 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef CURLUPLOADTEST_H
+#define CURLUPLOADTEST_H
+#include "Transfer.h"
+#include <QObject>
+#include <QTcpServer>
+#include <QHash>
+#include <QSet>
+#include <QByteArray>
+#include <QString>
+
+class QTcpSocket;
+class QEventLoop;
+
+// fatrat --test curlupload
+// Uploads a file in the segmented HTTP mode to a local HTTP server and checks
+// that the chunks put together give the file: once with each upload protocol,
+// once with the server failing a chunk, which must be retried, and once
+// resuming from a saved set of finished chunks, which must not be resent.
+class CurlUploadTest : public QObject
+{
+Q_OBJECT
+public:
+	CurlUploadTest();
+	
+	// 0 if all uploads arrived intact
+	int run();
+private slots:
+	void newConnection();
+	void readRequest();
+	void uploadStateChanged(Transfer::State prev, Transfer::State now);
+	void uploadTimeout();
+private:
+	// failChunk is refused once with an error, savedChunks are already finished
+	bool runCase(QString name, QString file, int protocol, int failChunk = -1, QString savedChunks = QString());
+	// false if the request is incomplete yet
+	bool processRequest(QTcpSocket* socket, QByteArray& buffer);
+	void fail(QString error);
+private:
+	QTcpServer m_server;
+	QHash<QTcpSocket*, QByteArray> m_buffers;
+	QByteArray m_data, m_received;
+	int m_nProtocol, m_nRequests, m_nFailChunk;
+	QSet<int> m_skipChunks;
+	QString m_strError;
+	QEventLoop* m_loop;
+};
+
+#endif
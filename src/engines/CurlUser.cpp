@@ -36,10 +36,14 @@ size_t CurlUser::read_function(char *ptr, size_t size, size_t nmemb, CurlUser* T
 	if (ptr)
 		bytes = This->readData(ptr, size*nmemb);
 
-	This->timeProcessUp(size*nmemb);
+	// nothing has been transferred, the data isn't available yet
+	if (bytes == CURL_READFUNC_PAUSE || bytes == CURL_READFUNC_ABORT)
+		return bytes;
+
+	This->timeProcessUp(bytes);
 
 	if(This->m_master != 0)
-		This->m_master->timeProcessUp(size*nmemb);
+		This->m_master->timeProcessUp(bytes);
 
 	return bytes;
 }
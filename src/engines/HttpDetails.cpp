@@ -30,6 +30,7 @@ respects for all of the code used other than "OpenSSL".
 #include "fatrat.h"
 #include "GeneralDownloadForms.h"
 #include "HttpMirrorsDlg.h"
+#include "MirrorProber.h"
 #include <QPainter>
 #include <QLinearGradient>
 #include <QFile>
@@ -361,7 +362,7 @@ void HttpDetails::GradientWidget::paintEvent(QPaintEvent* event)
 void HttpDetails::mirrorSearch()
 {
 	// get source and effective URLs
-	QSet<QString> urls;
+	QStringList urls;
 
 	for (int i=0;i<m_download->m_urls.size();i++)
 	{
@@ -371,80 +372,24 @@ void HttpDetails::mirrorSearch()
 		else
 			urls << obj.url.toString();
 	}
-	// find compatible mirror groups
-	QSet<QString> groups;
-	QMap<QString,QStringList> mirrors = loadMirrors();
-	QMap<QString,QString> append;
 
-	foreach (QString url, urls)
-	{
-		for(QMap<QString,QStringList>::iterator it=mirrors.begin(); it != mirrors.end(); it++)
-		{
-			foreach (QString murl, it.value())
-			{
-				if (url.startsWith(murl))
-				{
-					groups << it.key();
-					append[it.key()] = url.mid(murl.size());
-					it.value().removeAll(murl);
-					break;
-				}
-			}
-		}
-	}
+	QMap<QString,QStringList> mirrors = MirrorProber::findMirrors(urls);
 
-	if (groups.isEmpty())
+	if (mirrors.isEmpty())
 		QMessageBox::warning(listUrls->parentWidget(), "FatRat", tr("No mirrors found."));
 	else
 	{
 		HttpMirrorsDlg dlg(listUrls->parentWidget());
-		dlg.load(mirrors, groups);
+		dlg.load(mirrors);
 		if (dlg.exec() == QDialog::Accepted)
 		{
-			QMap<QString,QStringList> urls = dlg.pickedUrls();
-			for(QMap<QString,QStringList>::iterator it=urls.begin();it!=urls.end();it++)
+			foreach (QString url, dlg.pickedUrls())
 			{
-				QString app = append[it.key()];
-				foreach (QString url, it.value())
-				{
-					UrlClient::UrlObject obj;
-					obj.url = url + app;
-					m_download->m_urls << obj;
-				}
+				UrlClient::UrlObject obj;
+				obj.url = url;
+				m_download->m_urls << obj;
 			}
 			refresh();
 		}
 	}
 }
-
-QMap<QString,QStringList> HttpDetails::loadMirrors()
-{
-	QFile file;
-	QMap<QString,QStringList> rv;
-
-	if(!openDataFile(&file, "/data/mirrors.txt"))
-		return rv;
-	QString nextGrp;
-	QStringList list;
-	QRegExp re("\\[([^\\]]+)\\]");
-
-	while (!file.atEnd())
-	{
-		QString line = file.readLine().trimmed();
-		if (line.isEmpty())
-			continue;
-		if (re.exactMatch(line))
-		{
-			if (!nextGrp.isEmpty())
-				rv[nextGrp] = list;
-			list.clear();
-			nextGrp = re.cap(1);
-		}
-		else
-			list << line;
-	}
-	if (!list.isEmpty())
-		rv[nextGrp] = list;
-
-	return rv;
-}
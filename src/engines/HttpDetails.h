@@ -49,8 +49,6 @@ private slots:
 	void refresh();
 	void addSegmentUrl();
 	void mirrorSearch();
-protected:
-	static QMap<QString,QStringList> loadMirrors();
 private:
 	QTimer m_timer;
 	CurlDownload* m_download;
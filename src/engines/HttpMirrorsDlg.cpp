@@ -25,64 +25,75 @@ respects for all of the code used other than "OpenSSL".
 */
 
 #include "HttpMirrorsDlg.h"
+#include "MirrorProber.h"
 #include <QUrl>
-#include <QProcess>
-#include <QRegExp>
-#include <QtDebug>
 #include <climits>
 
 HttpMirrorsDlg::HttpMirrorsDlg(QWidget* parent)
-	: QDialog(parent), m_probeThread(0)
+	: QDialog(parent), m_prober(new MirrorProber(this))
 {
 	setupUi(this);
 	treeMirrors->setColumnWidth(0, 250);
 	treeMirrors->sortItems(2, Qt::AscendingOrder);
-}
 
-HttpMirrorsDlg::~HttpMirrorsDlg()
-{
-	if (m_probeThread)
-	{
-		m_probeThread->stop();
-		if (!m_probeThread->wait(1500))
-			m_probeThread->terminate();
-	}
+	connect(m_prober, SIGNAL(probed(QString,int,int)), this, SLOT(probed(QString,int,int)));
 }
 
-void HttpMirrorsDlg::load(const QMap<QString,QStringList>& mirrors, QSet<QString> compatible)
+void HttpMirrorsDlg::load(const QMap<QString,QStringList>& mirrors)
 {
-	QMap<QString,QTreeWidgetItem*> toProbe;
-	foreach(QString grp, compatible)
+	QStringList toProbe;
+	for(QMap<QString,QStringList>::const_iterator it = mirrors.begin(); it != mirrors.end(); it++)
 	{
 		QTreeWidgetItem* item = new QTreeWidgetItem(treeMirrors);
-		item->setText(0, grp);
+		item->setText(0, it.key());
 		treeMirrors->addTopLevelItem(item);
 		item->setExpanded(true);
 
-		const QStringList& servers = mirrors[grp];
-		foreach(QString server, servers)
+		foreach(QString server, it.value())
 		{
 			QUrl url = server;
-			QString host = url.host();
 
 			QTreeWidgetItem* sitem = new CSTreeWidgetItem(item);
-			sitem->setText(0, host);
-			sitem->setData(0, Qt::UserRole, url.toString());
+			sitem->setText(0, url.host());
+			sitem->setData(0, Qt::UserRole, server);
 			sitem->setData(1, Qt::UserRole, INT_MAX);
 			sitem->setData(2, Qt::UserRole, INT_MAX);
 			sitem->setFlags(sitem->flags() | Qt::ItemIsUserCheckable);
 			sitem->setCheckState(0, Qt::Unchecked);
-			toProbe[host] = sitem;
+
+			m_items[server] = sitem;
+			toProbe << server;
 		}
 	}
 
-	m_probeThread = new ProbeThread(toProbe, this);
-	m_probeThread->start();
+	m_prober->probe(toProbe);
+}
+
+void HttpMirrorsDlg::probed(QString url, int connect, int response)
+{
+	QTreeWidgetItem* item = m_items.value(url);
+	if (!item)
+		return;
+
+	if (response < 0)
+	{
+		item->setText(1, "?");
+		item->setText(2, "?");
+		item->setData(1, Qt::UserRole, INT_MAX-1);
+		item->setData(2, Qt::UserRole, INT_MAX-1);
+	}
+	else
+	{
+		item->setText(1, tr("%1 ms").arg(connect));
+		item->setText(2, tr("%1 ms").arg(response));
+		item->setData(1, Qt::UserRole, connect);
+		item->setData(2, Qt::UserRole, response);
+	}
 }
 
-QMap<QString,QStringList> HttpMirrorsDlg::pickedUrls() const
+QStringList HttpMirrorsDlg::pickedUrls() const
 {
-	QMap<QString,QStringList> rv;
+	QStringList rv;
 	for(int i=0;i<treeMirrors->topLevelItemCount();i++)
 	{
 		QTreeWidgetItem* root = treeMirrors->topLevelItem(i);
@@ -90,82 +101,12 @@ QMap<QString,QStringList> HttpMirrorsDlg::pickedUrls() const
 		{
 			QTreeWidgetItem* item = root->child(j);
 			if (item->checkState(0) == Qt::Checked)
-				rv[root->text(0)] << item->data(0, Qt::UserRole).toString();
+				rv << item->data(0, Qt::UserRole).toString();
 		}
 	}
 	return rv;
 }
 
-HttpMirrorsDlg::ProbeThread::ProbeThread(QMap<QString,QTreeWidgetItem*>& servers, QObject* parent)
-	: QThread(parent), m_servers(servers), m_bStop(false)
-{
-
-}
-
-HttpMirrorsDlg::ProbeThread::~ProbeThread()
-{
-}
-
-void HttpMirrorsDlg::ProbeThread::run()
-{
-	QRegExp reTime("time=([0-9\\.]+) ms");
-	QRegExp reTtl("ttl=(\\d+)");
-
-	for (QMap<QString,QTreeWidgetItem*>::iterator it = m_servers.begin(); it != m_servers.end(); it++)
-	{
-		QProcess prc;
-		int ttl = -1, ms = -1;
-
-		if (m_bStop)
-			break;
-
-		qDebug() << "ping" << it.key();
-		prc.start("ping", QStringList() << "-c1" << "-w1" << it.key(), QIODevice::ReadOnly);
-		prc.waitForFinished(2000);
-
-		while (!prc.atEnd())
-		{
-			QString line = prc.readLine();
-			//qDebug() << line;
-			if (reTime.indexIn(line) != -1)
-				ms = reTime.cap(1).toDouble();
-			if (reTtl.indexIn(line) != -1)
-				ttl = reTtl.cap(1).toInt();
-		}
-
-		QTreeWidgetItem* item = it.value();
-		if (ms == -1)
-		{
-			item->setText(1, "?");
-			item->setText(2, "?");
-			item->setData(1, Qt::UserRole, INT_MAX-1);
-			item->setData(2, Qt::UserRole, INT_MAX-1);
-		}
-		else
-		{
-			qDebug() << it.key() << "->" << ms;
-			item->setText(1, QString("%1 ms").arg(ms));
-			item->setData(1, Qt::UserRole, ms);
-
-			if (ttl == -1)
-				item->setText(2, "?");
-			else
-			{
-				// guess source TTL
-				int sttl;
-				if (ttl > 128)
-					sttl = 255;
-				else if (ttl > 64)
-					sttl = 128;
-				else
-					sttl = 64;
-				item->setText(2, QString::number(sttl-ttl));
-				item->setData(2, Qt::UserRole, sttl-ttl);
-			}
-		}
-	}
-}
-
 HttpMirrorsDlg::CSTreeWidgetItem::CSTreeWidgetItem(QTreeWidgetItem* parent)
 	: QTreeWidgetItem(parent)
 {
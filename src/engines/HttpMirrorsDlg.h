@@ -28,31 +28,24 @@ respects for all of the code used other than "OpenSSL".
 #define HTTPMIRRORSDLG_H
 #include <QDialog>
 #include <QMap>
-#include <QSet>
-#include <QThread>
+#include <QHash>
 #include "ui_HttpMirrorsDlg.h"
 
+class MirrorProber;
+
 class HttpMirrorsDlg : public QDialog, Ui_HttpMirrorsDlg
 {
 Q_OBJECT
 public:
 	HttpMirrorsDlg(QWidget* parent);
-	~HttpMirrorsDlg();
-	void load(const QMap<QString, QStringList>& mirrors, QSet<QString> compatible);
-	QMap<QString,QStringList> pickedUrls() const;
+	// mirror URLs by mirror group, see MirrorProber::findMirrors()
+	void load(const QMap<QString, QStringList>& mirrors);
+	QStringList pickedUrls() const;
+private slots:
+	void probed(QString url, int connect, int response);
 private:
-
-	class ProbeThread : public QThread
-	{
-	public:
-		ProbeThread(QMap<QString,QTreeWidgetItem*>& servers, QObject* parent);
-		~ProbeThread();
-		void stop() { m_bStop = true; }
-		virtual void run();
-	private:
-		QMap<QString,QTreeWidgetItem*> m_servers;
-		bool m_bStop;
-	} *m_probeThread;
+	MirrorProber* m_prober;
+	QHash<QString, QTreeWidgetItem*> m_items;
 
 	class CSTreeWidgetItem : public QTreeWidgetItem
 	{
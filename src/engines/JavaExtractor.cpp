@@ -201,7 +201,7 @@ void JavaExtractor::changeActive(bool nowActive)
 			m_reply = m_network->get(QNetworkRequest(m_strUrl));
 		else
 		{
-			logMessage(tr("JavaExtractor: Not an HTTP(S) URI, passing the URI directly to the extension"));
+			enterLogMessage(tr("JavaExtractor: Not an HTTP(S) URI, passing the URI directly to the extension"));
 			m_plugin->call("extractList", JSignature().addString().add("java.nio.ByteBuffer").add("java.util.Map"), m_strUrl, JObject(), JObject());
 		}
 	}
@@ -277,7 +277,7 @@ void JavaExtractor::finished(QNetworkReply* reply)
 	}
 
 	qDebug() << "JavaExtractor::finished:" << buf.toString();
-	logMessage(QLatin1String("JavaExtractor::finished(): OK"));
+	enterLogMessage(QLatin1String("JavaExtractor::finished(): OK"));
 
 	m_plugin->call("extractList", JSignature().addString().add("java.nio.ByteBuffer").add("java.util.Map"), m_strUrl, buf, map);
 }
@@ -169,8 +169,7 @@ void JavaUpload::changeActive(bool nowActive)
 	
 	if (nowActive)
 	{
-		m_file.setFileName(m_strSource);
-		if (!m_file.open(QIODevice::ReadOnly))
+		if (!m_file.open(m_strSource))
 		{
 			m_strMessage = m_file.errorString();
 			setState(Failed);
@@ -193,6 +192,7 @@ void JavaUpload::changeActive(bool nowActive)
 			curl_formfree(m_postData);
 			m_postData = 0;
 		}
+		m_file.close();
 		m_plugin->abort();
 	}
 }
@@ -313,10 +313,12 @@ void JavaUpload::checkResponse()
 size_t JavaUpload::readData(char* buffer, size_t maxData)
 {
 	qint64 read = m_file.read(buffer, maxData);
-	if (read < 0)
+	if (read == ReadAheadBuffer::WouldBlock)
+		return CURL_READFUNC_PAUSE;
+	else if (read < 0)
 	{
 		m_strMessage = m_file.errorString();
-		return 0;
+		return CURL_READFUNC_ABORT;
 	}
 	else
 		return size_t( read );
@@ -364,6 +366,7 @@ void JavaUpload::startUpload(QString url, QList<JavaUpload::MimePart>& parts, qi
 				m_nThisPart = m_nTotal;
 			m_nThisPart -= offset;
 
+			m_file.setCurlHandle(m_curl);
 			m_file.seek(offset);
 
 			strncpy(m_fileName, fileName.constData(), sizeof(m_fileName-1));
@@ -37,6 +37,7 @@ respects for all of the code used other than "OpenSSL".
 #include <QByteArray>
 #include "Transfer.h"
 #include "CurlUser.h"
+#include "ReadAheadBuffer.h"
 #include "java/JUploadPlugin.h"
 #include "java/JMap.h"
 #include "engines/StaticTransferMessage.h"
@@ -105,7 +106,7 @@ private:
 	JUploadPlugin* m_plugin;
 	qint64 m_nTotal, m_nDone, m_nThisPart;
 	CURL* m_curl;
-	QFile m_file;
+	ReadAheadBuffer m_file;
 	QByteArray m_buffer;
 	char m_errorBuffer[CURL_ERROR_SIZE];
 	curl_httppost* m_postData;
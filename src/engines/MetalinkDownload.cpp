@@ -35,6 +35,7 @@ respects for all of the code used other than "OpenSSL".
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QTemporaryFile>
+#include <QLocale>
 
 #include "RuntimeException.h"
 #include "Queue.h"
@@ -181,6 +182,7 @@ void MetalinkDownload::processMetalink(QString fileName)
 	}
 
 	QList<MetaFile> files;
+	const QString country = QLocale::system().name().section('_', 1).toLower();
 	QDomElement root = doc.documentElement();
 	QDomElement dfile = root.firstChildElement("file");
 	while (!dfile.isNull())
@@ -212,6 +214,8 @@ void MetalinkDownload::processMetalink(QString fileName)
 				if (elem.hasAttribute("preference"))
 					priority = -elem.attribute("preference").toInt();
 
+				bool local = !country.isEmpty() && elem.attribute("location").toLower() == country;
+
 				if (elem.attribute("type") == "bittorrent")
 				{
 					metaFile.urls << Link(url, priority, true);
@@ -219,7 +223,7 @@ void MetalinkDownload::processMetalink(QString fileName)
 				}
 				else if (url.startsWith("http://") || url.startsWith("ftp://"))
 				{
-					metaFile.urls << Link(url, priority, false);
+					metaFile.urls << Link(url, priority, false, local);
 					metaFile.hasHTTP = true;
 				}
 			}
@@ -277,7 +281,12 @@ void MetalinkDownload::processMetalink(QString fileName)
 		MetaFile& m = files[i];
 		int mode = getSettingsValue("metalink/mode").toInt();
 
-		qSort(m.urls);
+		qStableSort(m.urls);
+
+		// hybrid mode means a torrent with the mirrors as web seeds
+		bool hybrid = (mode == 2);
+		if (hybrid)
+			mode = 1;
 
 		if (mode == 0 && !m.hasHTTP)
 			mode = 1;
@@ -326,7 +335,7 @@ decide:
 					break;
 				}
 			}
-			for (int j=0;j<m.urls.size();j++)
+			for (int j=0;t && hybrid && j<m.urls.size();j++)
 			{
 				if (m.urls[j].isTorrent)
 					continue;
@@ -370,6 +379,8 @@ decide:
 					{
 						UrlClient::UrlObject obj;
 						obj.url = m.urls[j].url;
+						obj.proxy = t->m_urls[0].proxy;
+						obj.ftpMode = t->m_urls[0].ftpMode;
 						t->m_urls << obj;
 					}
 				}
@@ -377,6 +388,32 @@ decide:
 
 			if (t)
 			{
+				QList<Link> httpLinks;
+				foreach (const Link& link, m.urls)
+				{
+					if (!link.isTorrent)
+						httpLinks << link;
+				}
+
+				// use all mirrors at once, the preferred ones get more connections
+				t->m_listActiveSegments = weightedSegments(httpLinks, getSettingsValue("httpftp/mirror_connections").toInt());
+
+				// with the size known upfront, all segments start immediately
+				// and the file gets preallocated; whatever is already on the disk
+				// wasn't downloaded by us
+				if (m.fileSize > 0)
+				{
+					t->m_nTotal = m.fileSize;
+					t->m_bSegmentsKnown = true;
+				}
+				if (!m.name.isEmpty() && !m.name.contains('/'))
+				{
+					t->m_strFile = m.name;
+					t->m_bAutoName = false;
+				}
+				if (!m.comment.isEmpty())
+					t->setComment(m.comment);
+
 				if (!i)
 					this->replaceItself(t);
 				else
@@ -402,6 +439,28 @@ decide:
 
 }
 
+QList<int> MetalinkDownload::weightedSegments(const QList<Link>& urls, int connections)
+{
+	QList<int> rv;
+	connections = qMax(connections, 1);
+
+	// one segment per mirror, the list being already sorted by preference;
+	// the mirrors left out stay available for failover
+	for (int i = 0; i < urls.size() && rv.size() < connections; i++)
+		rv << i;
+
+	// the remaining connections go round-robin to the mirrors sharing
+	// the best priority and location
+	int best = 0;
+	while (best < urls.size() && urls[best].priority == urls[0].priority && urls[best].local == urls[0].local)
+		best++;
+
+	for (int i = 0; best && rv.size() < connections; i = (i+1) % best)
+		rv << i;
+
+	return rv;
+}
+
 QString MetalinkDownload::remoteURI() const
 {
 	return m_strSource;
@@ -65,17 +65,21 @@ protected:
 
 	struct Link
 	{
-		Link(QString _url, int _priority, bool _isTorrent) : url(_url), isTorrent(_isTorrent), priority(_priority)
+		Link(QString _url, int _priority, bool _isTorrent, bool _local = false) : url(_url), isTorrent(_isTorrent), priority(_priority), local(_local)
 		{
 		}
 
 		QString url;
 		bool isTorrent;
 		int priority;
+		// the mirror is located in the user's own country
+		bool local;
 
 		bool operator<(const Link& that) const
 		{
-			return priority < that.priority;
+			if (priority != that.priority)
+				return priority < that.priority;
+			return local && !that.local;
 		}
 	};
 	struct MetaFile
@@ -89,6 +93,9 @@ protected:
 		bool hasHTTP, hasTorrent;
 	};
 
+	// Builds the list of URL indices CurlDownload should open segments from
+	static QList<int> weightedSegments(const QList<Link>& urls, int connections);
+
 private:
 	QString m_strMessage, m_strSource, m_strTarget;
 	QNetworkAccessManager* m_network;
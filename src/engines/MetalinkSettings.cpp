@@ -38,6 +38,7 @@ MetalinkSettings::MetalinkSettings(QWidget* w, QObject* p)
 #endif
 #ifndef WITH_BITTORRENT
 	radioUseTorrent->setDisabled(true);
+	radioUseHybrid->setDisabled(true);
 #endif
 }
 
@@ -49,6 +50,8 @@ void MetalinkSettings::load()
 		radioUseHTTP->setChecked(true);
 	else if (mode == 1)
 		radioUseTorrent->setChecked(true);
+	else if (mode == 2)
+		radioUseHybrid->setChecked(true);
 }
 
 void MetalinkSettings::accepted()
@@ -56,6 +59,8 @@ void MetalinkSettings::accepted()
 	int mode = 0;
 	if (radioUseTorrent->isChecked())
 		mode = 1;
+	else if (radioUseHybrid->isChecked())
+		mode = 2;
 	setSettingsValue("metalink/mode", mode);
 }
 
@@ -0,0 +1,581 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "config.h"
+#include "MirrorDownload.h"
+#include "CurlPoller.h"
+#include "CurlPollingMaster.h"
+#include "Settings.h"
+#include "RuntimeException.h"
+#include "Auth.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QRegExp>
+#include <QtDebug>
+#include <errno.h>
+#include <cstring>
+#include <fcntl.h>
+#include <utime.h>
+
+#ifndef POSIX_LINUX
+#	define O_LARGEFILE 0
+#endif
+
+// protects against servers sending endless index pages
+static const int MAX_LISTING_SIZE = 32*1024*1024;
+
+MirrorDownload::MirrorDownload()
+	: m_master(0), m_nTotal(0), m_nDone(0), m_nFiles(0), m_nSkipped(0), m_nFailed(0), m_nMaxConnections(1)
+{
+}
+
+MirrorDownload::~MirrorDownload()
+{
+	if(isActive())
+		changeActive(false);
+}
+
+int MirrorDownload::acceptable(QString uri, bool)
+{
+	QUrl url = uri;
+	QString scheme = url.scheme();
+
+	if(!url.path().endsWith('/'))
+		return 0;
+	if(scheme == "ftp" || scheme == "ftps" || scheme == "sftp")
+		return 3;
+	else if(scheme == "http" || scheme == "https")
+		return 1; // more likely a web page than a directory index
+	else
+		return 0;
+}
+
+void MirrorDownload::init(QString uri, QString dest)
+{
+	UrlClient::UrlObject obj;
+
+	obj.url = QUrl::fromPercentEncoding(uri.toUtf8());
+
+	QString scheme = obj.url.scheme();
+	if(scheme != "http" && scheme != "ftp" && scheme != "ftps" && scheme != "sftp" && scheme != "https")
+		throw RuntimeException(tr("Unsupported protocol: \"%1\"").arg(scheme));
+
+	if(!obj.url.path().endsWith('/'))
+		obj.url.setPath(obj.url.path() + '/');
+
+	if(obj.url.userInfo().isEmpty())
+	{
+		Auth a;
+		if(Auth::find(uri, a))
+		{
+			obj.url.setUserName(a.strUser);
+			obj.url.setPassword(a.strPassword);
+
+			enterLogMessage(tr("Loaded stored authentication data, matched regexp %1").arg(a.strRegExp));
+		}
+	}
+
+	obj.proxy = getSettingsValue("httpftp/defaultproxy").toString();
+	obj.ftpMode = UrlClient::FtpPassive;
+
+	m_source = obj;
+	m_dir = dest;
+	m_dir.mkpath(".");
+}
+
+void MirrorDownload::setObject(QString target)
+{
+	QDir dirnew = target;
+	if(dirnew != m_dir)
+	{
+		if(QFile::exists(m_dir.filePath(name())) && !QFile::rename(m_dir.filePath(name()), dirnew.filePath(name())))
+			throw RuntimeException(tr("Cannot move the directory."));
+
+		m_dir = dirnew;
+	}
+}
+
+QString MirrorDownload::rootName(const QUrl& url)
+{
+	QStringList parts = url.path().split('/', QString::SkipEmptyParts);
+	if(parts.isEmpty())
+		return url.host();
+	else
+		return parts.last();
+}
+
+QString MirrorDownload::name() const
+{
+	return rootName(m_source.url);
+}
+
+QString MirrorDownload::remoteURI() const
+{
+	QUrl url = m_source.url;
+	url.setUserInfo(QString());
+	return url.toString();
+}
+
+QString MirrorDownload::localPath(const Job& job) const
+{
+	return m_dir.filePath(name() + '/' + job.path);
+}
+
+void MirrorDownload::changeActive(bool nowActive)
+{
+	if(nowActive)
+	{
+		m_strMessage.clear();
+		m_nTotal = m_nDone = 0;
+		m_nFiles = m_nSkipped = m_nFailed = 0;
+		m_listings.clear();
+		m_files.clear();
+		m_visited.clear();
+
+		if(!m_dir.mkpath(name()))
+		{
+			enterLogMessage(m_strMessage = tr("Cannot create the target directory"));
+			setState(Failed);
+			return;
+		}
+
+		m_nMaxConnections = qMax(1, getSettingsValue("httpftp/mirror_connections").toInt());
+
+		// All handles of a single master share its connection cache,
+		// so consecutive requests reuse the already open connections
+		m_master = new CurlPollingMaster;
+		m_master->setMaxConnections(m_nMaxConnections*2);
+		CurlPoller::instance()->addTransfer(m_master);
+		m_master->setMaxDown(m_nDownLimitInt);
+
+		Job root;
+		root.type = JobListing;
+		root.url = m_source.url;
+
+		m_visited << root.url.toString();
+		m_listings << root;
+
+		startJobs();
+	}
+	else if(m_master != 0)
+	{
+		foreach(Client* client, m_clients)
+		{
+			if(client->job.type == JobFile)
+				m_nDone += client->progress();
+			m_master->removeTransfer(client);
+			client->stop();
+		}
+		m_clients.clear();
+		m_listings.clear();
+		m_files.clear();
+
+		// the poller deletes the master and the clients removed from it
+		CurlPoller::instance()->removeTransfer(m_master);
+		m_master = 0;
+	}
+}
+
+void MirrorDownload::startJobs()
+{
+	while(m_clients.size() < m_nMaxConnections && isActive())
+	{
+		// directories go first so that the total size is known as soon as possible
+		if(!m_listings.isEmpty())
+			startJob(m_listings.dequeue());
+		else if(!m_files.isEmpty())
+			startJob(m_files.dequeue());
+		else
+			break;
+	}
+}
+
+void MirrorDownload::startJob(const Job& job)
+{
+	Client* client = new Client(job, m_source);
+	int file = -1;
+
+	if(job.type == JobFile)
+	{
+		QString path = localPath(job);
+
+		QFileInfo(path).dir().mkpath(".");
+
+		std::string spath = path.toStdString();
+		file = open(spath.c_str(), O_CREAT|O_RDWR|O_TRUNC|O_LARGEFILE, 0666);
+		if(file < 0)
+		{
+			enterLogMessage(tr("Failed to open %1: %2").arg(path).arg(strerror(errno)));
+			m_nFailed++;
+			delete client;
+			return;
+		}
+	}
+
+	client->setTargetObject(file);
+
+	connect(client, SIGNAL(done(QString)), this, SLOT(clientDone(QString)));
+	connect(client, SIGNAL(failure(QString)), this, SLOT(clientFailure(QString)));
+
+	client->setPollingMaster(m_master);
+	client->start();
+
+	CURL* curl = client->curlHandle();
+	if(job.type == JobProbe)
+		curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+	if(job.type != JobListing)
+		curl_easy_setopt(curl, CURLOPT_FILETIME, 1L);
+	// the verbose output of thousands of requests would flood the log
+	curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
+
+	m_clients << client;
+	m_master->addTransfer(static_cast<CurlUser*>(client));
+}
+
+void MirrorDownload::finishClient(Client* client)
+{
+	m_clients.removeOne(client);
+	m_master->removeTransfer(client);
+	client->stop();
+}
+
+void MirrorDownload::clientFailure(QString error)
+{
+	Client* client = static_cast<Client*>(sender());
+	if(!isActive() || !m_master || !m_clients.contains(client))
+		return;
+
+	enterLogMessage(tr("Failed to download %1: %2").arg(client->job.path).arg(error));
+	m_nFailed++;
+
+	finishClient(client);
+	startJobs();
+	checkCompleted();
+}
+
+void MirrorDownload::clientDone(QString error)
+{
+	Client* client = static_cast<Client*>(sender());
+	if(!isActive() || !m_master || !m_clients.contains(client))
+		return;
+
+	// the client gets deleted by the poller once removed
+	Job job = client->job;
+	QByteArray listing = client->listing;
+	qlonglong remoteSize = client->remoteSize, progress = client->progress();
+	time_t remoteTime = client->remoteTime;
+
+	finishClient(client);
+
+	if(!error.isNull())
+	{
+		enterLogMessage(tr("Failed to download %1: %2").arg(job.url.toString(QUrl::RemoveUserInfo)).arg(error));
+		m_nFailed++;
+	}
+	else if(job.type == JobListing)
+		processListing(job, listing);
+	else if(job.type == JobProbe)
+	{
+		QFileInfo fi(localPath(job));
+
+		if(job.size < 0 && remoteSize >= 0)
+		{
+			job.size = remoteSize;
+			m_nTotal += remoteSize;
+		}
+
+		if(fi.size() == job.size && (remoteTime < 0 || fi.lastModified().toTime_t() == uint(remoteTime)))
+		{
+			m_nDone += fi.size();
+			m_nSkipped++;
+		}
+		else
+		{
+			job.type = JobFile;
+			m_files.prepend(job);
+		}
+	}
+	else
+	{
+		if(remoteTime >= 0)
+		{
+			std::string spath = localPath(job).toStdString();
+			struct utimbuf times;
+
+			times.actime = times.modtime = remoteTime;
+			utime(spath.c_str(), &times);
+		}
+
+		m_nTotal += progress - qMax(job.size, 0LL);
+		m_nDone += progress;
+		m_nFiles++;
+	}
+
+	startJobs();
+	checkCompleted();
+}
+
+void MirrorDownload::checkCompleted()
+{
+	if(!m_clients.isEmpty() || !m_listings.isEmpty() || !m_files.isEmpty() || !isActive())
+		return;
+
+	if(m_nFailed)
+	{
+		m_strMessage = tr("%1 files could not be downloaded").arg(m_nFailed);
+		setState(Failed);
+	}
+	else
+	{
+		m_strMessage = tr("%1 files downloaded, %2 up to date").arg(m_nFiles).arg(m_nSkipped);
+		setState(Completed);
+	}
+}
+
+void MirrorDownload::processListing(const Job& job, const QByteArray& data)
+{
+	QString scheme = job.url.scheme();
+
+	if(scheme == "http" || scheme == "https")
+		parseHttpIndex(job, data);
+	else
+		parseFtpListing(job, data);
+}
+
+void MirrorDownload::parseFtpListing(const Job& job, const QByteArray& data)
+{
+	// UNIX style: drwxr-xr-x 2 owner group 4096 Jan 01 12:00 name
+	QRegExp unixLine("^([-dl])\\S+\\s+\\d+\\s+(?:\\S+\\s+)?\\S+\\s+(\\d+)\\s+\\w{3}\\s+\\d{1,2}\\s+(?:\\d{1,2}:\\d{2}|\\d{4})\\s(.+)$");
+	// DOS style: 01-01-20  12:00PM  <DIR>  name
+	QRegExp dosLine("^\\d{2}-\\d{2}-\\d{2,4}\\s+\\d{1,2}:\\d{2}(?:AM|PM)?\\s+(<DIR>|\\d+)\\s+(.+)$", Qt::CaseInsensitive);
+
+	foreach(QByteArray line, data.split('\n'))
+	{
+		if(line.endsWith('\r'))
+			line.chop(1);
+
+		QString text = QString::fromUtf8(line);
+
+		if(unixLine.exactMatch(text))
+		{
+			QString type = unixLine.cap(1);
+
+			if(type == "l")
+			{
+				qDebug() << "MirrorDownload: skipping a symlink" << unixLine.cap(3);
+				continue;
+			}
+
+			enqueueEntry(job, unixLine.cap(3), type == "d", unixLine.cap(2).toLongLong());
+		}
+		else if(dosLine.exactMatch(text))
+		{
+			bool isDir = dosLine.cap(1).compare("<DIR>", Qt::CaseInsensitive) == 0;
+			enqueueEntry(job, dosLine.cap(2), isDir, isDir ? -1 : dosLine.cap(1).toLongLong());
+		}
+		else if(!line.isEmpty() && !line.startsWith("total "))
+			qDebug() << "MirrorDownload: unknown listing line" << line;
+	}
+}
+
+void MirrorDownload::parseHttpIndex(const Job& job, const QByteArray& data)
+{
+	QString html = QString::fromUtf8(data);
+	QRegExp href("href\\s*=\\s*[\"']([^\"'#]+)[\"']", Qt::CaseInsensitive);
+	const QString base = job.url.path();
+	QSet<QString> seen;
+	int pos = 0;
+
+	while((pos = href.indexIn(html, pos)) != -1)
+	{
+		pos += href.matchedLength();
+
+		QString link = href.cap(1);
+
+		// column sorting links of generated index pages
+		if(link.contains('?'))
+			continue;
+
+		QUrl url = job.url.resolved(QUrl(link));
+		if(url.scheme() != job.url.scheme() || url.host() != job.url.host())
+			continue;
+
+		// only descend, never go up or sideways
+		QString path = url.path();
+		if(!path.startsWith(base) || path.size() <= base.size())
+			continue;
+
+		QString entry = path.mid(base.size());
+		bool isDir = entry.endsWith('/');
+
+		if(isDir)
+			entry.chop(1);
+		if(entry.contains('/') || seen.contains(entry))
+			continue;
+
+		seen << entry;
+		enqueueEntry(job, entry, isDir, -1);
+	}
+}
+
+void MirrorDownload::enqueueEntry(const Job& dir, QString name, bool isDir, qlonglong size)
+{
+	if(name.isEmpty() || name == "." || name == ".." || name.contains('/'))
+		return;
+
+	Job job;
+	job.url = dir.url;
+	job.url.setPath(dir.url.path() + name + (isDir ? "/" : ""));
+	job.path = dir.path.isEmpty() ? name : (dir.path + '/' + name);
+
+	if(isDir)
+	{
+		QString key = job.url.toString();
+		if(m_visited.contains(key))
+			return;
+
+		m_visited << key;
+		job.type = JobListing;
+		m_listings << job;
+	}
+	else
+	{
+		job.size = size;
+		if(size >= 0)
+			m_nTotal += size;
+		enqueueFile(job);
+	}
+}
+
+void MirrorDownload::enqueueFile(const Job& _job)
+{
+	Job job = _job;
+	QFileInfo fi(localPath(job));
+
+	// a local copy of a different size is never up to date,
+	// anything else needs the remote modification time
+	if(!fi.exists() || (job.size >= 0 && fi.size() != job.size))
+		job.type = JobFile;
+	else
+		job.type = JobProbe;
+
+	m_files << job;
+}
+
+void MirrorDownload::speeds(int& down, int& up) const
+{
+	down = up = 0;
+	if(m_master != 0)
+		m_master->speeds(down, up);
+}
+
+qulonglong MirrorDownload::done() const
+{
+	qlonglong d = m_nDone;
+
+	foreach(Client* client, m_clients)
+	{
+		if(client->job.type == JobFile)
+			d += client->progress();
+	}
+
+	return d;
+}
+
+void MirrorDownload::setSpeedLimits(int down, int)
+{
+	if(m_master != 0)
+		m_master->setMaxDown(down);
+}
+
+void MirrorDownload::load(const QDomNode& map)
+{
+	m_dir = getXMLProperty(map, "dir");
+	m_source.url = getXMLProperty(map, "address");
+	m_source.proxy = getXMLProperty(map, "proxy");
+	m_source.ftpMode = (UrlClient::FtpMode) getXMLProperty(map, "ftpmode").toInt();
+	m_source.strBindAddress = getXMLProperty(map, "bindip");
+
+	m_nTotal = getXMLProperty(map, "knowntotal").toLongLong();
+	m_nDone = getXMLProperty(map, "knowndone").toLongLong();
+	m_nFiles = getXMLProperty(map, "files").toInt();
+	m_nSkipped = getXMLProperty(map, "skipped").toInt();
+	m_nFailed = getXMLProperty(map, "failed").toInt();
+
+	Transfer::load(map);
+}
+
+void MirrorDownload::save(QDomDocument& doc, QDomNode& map) const
+{
+	Transfer::save(doc, map);
+
+	setXMLProperty(doc, map, "dir", m_dir.path());
+	setXMLProperty(doc, map, "address", m_source.url.toString());
+	setXMLProperty(doc, map, "proxy", m_source.proxy.toString());
+	setXMLProperty(doc, map, "ftpmode", QString::number( (int) m_source.ftpMode ));
+	setXMLProperty(doc, map, "bindip", m_source.strBindAddress);
+
+	setXMLProperty(doc, map, "knowntotal", QString::number(m_nTotal));
+	setXMLProperty(doc, map, "knowndone", QString::number(done()));
+	setXMLProperty(doc, map, "files", QString::number(m_nFiles));
+	setXMLProperty(doc, map, "skipped", QString::number(m_nSkipped));
+	setXMLProperty(doc, map, "failed", QString::number(m_nFailed));
+}
+
+/////////////////////////////////////////
+
+MirrorDownload::Client::Client(const Job& j, const UrlClient::UrlObject& source)
+	: job(j), remoteSize(-1), remoteTime(-1), m_object(source)
+{
+	m_object.url = job.url;
+	setSourceObject(m_object);
+}
+
+bool MirrorDownload::Client::writeData(const char* buffer, size_t bytes)
+{
+	if(job.type != JobListing)
+		return UrlClient::writeData(buffer, bytes);
+
+	if(listing.size() + bytes > size_t(MAX_LISTING_SIZE))
+		return false;
+
+	listing.append(buffer, int(bytes));
+	return true;
+}
+
+void MirrorDownload::Client::transferDone(CURLcode result)
+{
+	CURL* curl = curlHandle();
+	double length = -1;
+	long filetime = -1;
+
+	if(curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &length) == CURLE_OK && length >= 0)
+		remoteSize = qlonglong(length);
+	if(curl_easy_getinfo(curl, CURLINFO_FILETIME, &filetime) == CURLE_OK)
+		remoteTime = filetime;
+
+	UrlClient::transferDone(result);
+}
@@ -0,0 +1,124 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef MIRRORDOWNLOAD_H
+#define MIRRORDOWNLOAD_H
+#include "Transfer.h"
+#include "engines/UrlClient.h"
+#include "StaticTransferMessage.h"
+#include <QQueue>
+#include <QSet>
+#include <QDir>
+#include <ctime>
+
+class CurlPollingMaster;
+
+// Downloads a whole FTP directory or HTTP index page tree as a single transfer
+class MirrorDownload : public StaticTransferMessage<Transfer>
+{
+Q_OBJECT
+public:
+	MirrorDownload();
+	virtual ~MirrorDownload();
+
+	virtual void init(QString source, QString target);
+	virtual void changeActive(bool nowActive);
+	virtual void setObject(QString object);
+	virtual QString object() const { return m_dir.path(); }
+	virtual QString myClass() const { return "MirrorDownload"; }
+	virtual QString name() const;
+	virtual void speeds(int& down, int& up) const;
+	virtual qulonglong total() const { return m_nTotal; }
+	virtual qulonglong done() const;
+	virtual void load(const QDomNode& map);
+	virtual void save(QDomDocument& doc, QDomNode& map) const;
+	virtual void setSpeedLimits(int down, int up);
+	virtual QString remoteURI() const;
+
+	static int acceptable(QString uri, bool);
+	static Transfer* createInstance() { return new MirrorDownload; }
+protected:
+	enum JobType { JobListing, JobProbe, JobFile };
+
+	struct Job
+	{
+		Job() : type(JobFile), size(-1), mtime(-1) {}
+
+		JobType type;
+		QUrl url;
+		// path relative to the mirror root directory
+		QString path;
+		qlonglong size;
+		time_t mtime;
+	};
+
+	// UrlClient that can also keep directory listings in memory
+	// and that remembers the remote file size and modification time
+	class Client : public UrlClient
+	{
+	public:
+		Client(const Job& job, const UrlClient::UrlObject& source);
+
+		virtual bool writeData(const char* buffer, size_t bytes);
+		virtual void transferDone(CURLcode result);
+
+		Job job;
+		QByteArray listing;
+		qlonglong remoteSize;
+		time_t remoteTime;
+	private:
+		UrlClient::UrlObject m_object;
+	};
+protected slots:
+	void clientDone(QString error);
+	void clientFailure(QString error);
+private:
+	void startJobs();
+	void startJob(const Job& job);
+	void finishClient(Client* client);
+	void checkCompleted();
+	void processListing(const Job& job, const QByteArray& data);
+	void parseFtpListing(const Job& job, const QByteArray& data);
+	void parseHttpIndex(const Job& job, const QByteArray& data);
+	void enqueueEntry(const Job& dir, QString name, bool isDir, qlonglong size);
+	void enqueueFile(const Job& job);
+	QString localPath(const Job& job) const;
+	static QString rootName(const QUrl& url);
+private:
+	QDir m_dir;
+	UrlClient::UrlObject m_source;
+	CurlPollingMaster* m_master;
+
+	QQueue<Job> m_listings, m_files;
+	QList<Client*> m_clients;
+	QSet<QString> m_visited;
+
+	qlonglong m_nTotal, m_nDone;
+	int m_nFiles, m_nSkipped, m_nFailed;
+	int m_nMaxConnections;
+};
+
+#endif // MIRRORDOWNLOAD_H
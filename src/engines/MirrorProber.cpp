@@ -0,0 +1,292 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "MirrorProber.h"
+#include "fatrat.h"
+#include "config.h"
+#include <QSslSocket>
+#include <QUrl>
+#include <QFile>
+#include <QRegExp>
+#include <QSet>
+#include <QDateTime>
+
+// concurrent connections
+static const int MAX_PARALLEL = 24;
+// a mirror that doesn't respond in time is considered unreachable, in ms
+static const int PROBE_TIMEOUT = 5000;
+// how long a result is reused, in seconds
+static const int CACHE_TTL = 30*60;
+
+struct CachedResult
+{
+	int connect, response;
+	qint64 time;
+};
+static QHash<QString, CachedResult> g_cache;
+
+MirrorProber::MirrorProber(QObject* parent)
+	: QObject(parent)
+{
+	connect(&m_timer, SIGNAL(timeout()), this, SLOT(checkTimeouts()));
+}
+
+MirrorProber::~MirrorProber()
+{
+	foreach (QSslSocket* socket, m_active.keys())
+	{
+		socket->disconnect(this);
+		socket->abort();
+		delete socket;
+	}
+}
+
+void MirrorProber::probe(const QStringList& urls)
+{
+	foreach (QString url, urls)
+		m_queue.enqueue(url);
+	startNext();
+}
+
+void MirrorProber::startNext()
+{
+	const qint64 now = QDateTime::currentDateTime().toTime_t();
+
+	while (m_active.size() < MAX_PARALLEL && !m_queue.isEmpty())
+	{
+		QString url = m_queue.dequeue();
+		QUrl u(url);
+		const bool https = u.scheme() == "https";
+		const int port = u.port(https ? 443 : (u.scheme() == "ftp" ? 21 : 80));
+		// the status depends on the file, so the results are kept per URL
+		QHash<QString, CachedResult>::const_iterator it = g_cache.constFind(url);
+		if (it != g_cache.constEnd() && now - it->time < CACHE_TTL)
+		{
+			emit probed(url, it->connect, it->response);
+			continue;
+		}
+
+		QSslSocket* socket = new QSslSocket(this);
+		Probe& p = m_active[socket];
+
+		p.url = url;
+		p.connect = p.response = -1;
+
+		connect(socket, SIGNAL(connected()), this, SLOT(socketConnected()));
+		connect(socket, SIGNAL(encrypted()), this, SLOT(socketEncrypted()));
+		connect(socket, SIGNAL(readyRead()), this, SLOT(socketReadyRead()));
+		connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(socketError()));
+		// only the timing matters
+		connect(socket, SIGNAL(sslErrors(QList<QSslError>)), socket, SLOT(ignoreSslErrors()));
+
+		p.timer.start();
+		if (https)
+			socket->connectToHostEncrypted(u.host(), port);
+		else
+			socket->connectToHost(u.host(), port);
+	}
+
+	if (m_active.isEmpty())
+	{
+		m_timer.stop();
+		if (m_queue.isEmpty())
+			emit finished();
+	}
+	else if (!m_timer.isActive())
+		m_timer.start(500);
+}
+
+void MirrorProber::socketConnected()
+{
+	QSslSocket* socket = static_cast<QSslSocket*>(sender());
+	Probe& p = m_active[socket];
+
+	p.connect = p.timer.elapsed();
+
+	// HTTPS waits for the handshake, FTP servers greet on their own
+	if (QUrl(p.url).scheme() == "http")
+		sendRequest(socket);
+}
+
+void MirrorProber::socketEncrypted()
+{
+	sendRequest(static_cast<QSslSocket*>(sender()));
+}
+
+void MirrorProber::sendRequest(QSslSocket* socket)
+{
+	QUrl url(m_active[socket].url);
+	QByteArray path = url.path(QUrl::FullyEncoded).toLatin1();
+
+	if (path.isEmpty())
+		path = "/";
+	if (url.hasQuery())
+		path += '?' + url.query(QUrl::FullyEncoded).toLatin1();
+
+	QByteArray request = "HEAD " + path + " HTTP/1.1\r\n"
+		"Host: " + url.host().toLatin1() + "\r\n"
+		"User-Agent: FatRat/" VERSION "\r\n"
+		"Connection: close\r\n\r\n";
+	socket->write(request);
+}
+
+void MirrorProber::socketReadyRead()
+{
+	QSslSocket* socket = static_cast<QSslSocket*>(sender());
+	Probe& p = m_active[socket];
+
+	if (p.response < 0)
+		p.response = p.timer.elapsed();
+	p.reply += socket->readAll();
+
+	int eol = p.reply.indexOf('\n');
+	if (eol < 0)
+	{
+		// no status line in a reasonable amount of data
+		if (p.reply.size() > 1024)
+			finish(socket, false);
+		return;
+	}
+
+	finish(socket, statusOk(QUrl(p.url).scheme(), p.reply.left(eol).trimmed()));
+}
+
+bool MirrorProber::statusOk(const QString& scheme, const QByteArray& line)
+{
+	if (scheme == "ftp")
+		return line.startsWith("220");
+
+	// HTTP/1.1 200 OK
+	QList<QByteArray> parts = line.split(' ');
+	if (parts.size() < 2 || !parts[0].startsWith("HTTP/"))
+		return false;
+
+	// redirects are followed when downloading
+	const int code = parts[1].toInt();
+	return code >= 200 && code < 400;
+}
+
+void MirrorProber::socketError()
+{
+	finish(static_cast<QSslSocket*>(sender()), false);
+}
+
+void MirrorProber::checkTimeouts()
+{
+	foreach (QSslSocket* socket, m_active.keys())
+	{
+		if (m_active[socket].timer.elapsed() > PROBE_TIMEOUT)
+			finish(socket, false);
+	}
+}
+
+void MirrorProber::finish(QSslSocket* socket, bool ok)
+{
+	if (!m_active.contains(socket))
+		return;
+
+	Probe p = m_active.take(socket);
+	CachedResult result;
+
+	socket->disconnect(this);
+	socket->abort();
+	socket->deleteLater();
+
+	result.connect = ok ? p.connect : -1;
+	result.response = ok ? p.response : -1;
+	result.time = QDateTime::currentDateTime().toTime_t();
+	g_cache[p.url] = result;
+
+	emit probed(p.url, result.connect, result.response);
+
+	startNext();
+}
+
+QMap<QString,QStringList> MirrorProber::loadMirrors()
+{
+	QFile file;
+	QMap<QString,QStringList> rv;
+
+	if(!openDataFile(&file, "/data/mirrors.txt"))
+		return rv;
+	QString nextGrp;
+	QStringList list;
+	QRegExp re("\\[([^\\]]+)\\]");
+
+	while (!file.atEnd())
+	{
+		QString line = file.readLine().trimmed();
+		if (line.isEmpty())
+			continue;
+		if (re.exactMatch(line))
+		{
+			if (!nextGrp.isEmpty())
+				rv[nextGrp] = list;
+			list.clear();
+			nextGrp = re.cap(1);
+		}
+		else
+			list << line;
+	}
+	if (!list.isEmpty())
+		rv[nextGrp] = list;
+
+	return rv;
+}
+
+QMap<QString,QStringList> MirrorProber::findMirrors(const QStringList& urls)
+{
+	QMap<QString,QStringList> mirrors = loadMirrors(), rv;
+	QMap<QString,QString> append;
+	QMap<QString,QSet<QString> > used;
+
+	foreach (QString url, urls)
+	{
+		for (QMap<QString,QStringList>::iterator it = mirrors.begin(); it != mirrors.end(); it++)
+		{
+			foreach (QString murl, it.value())
+			{
+				if (url.startsWith(murl))
+				{
+					append[it.key()] = url.mid(murl.size());
+					used[it.key()] << murl;
+					break;
+				}
+			}
+		}
+	}
+
+	for (QMap<QString,QString>::iterator it = append.begin(); it != append.end(); it++)
+	{
+		foreach (QString murl, mirrors[it.key()])
+		{
+			if (!used[it.key()].contains(murl))
+				rv[it.key()] << murl + it.value();
+		}
+	}
+
+	return rv;
+}
@@ -0,0 +1,86 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef MIRRORPROBER_H
+#define MIRRORPROBER_H
+#include <QObject>
+#include <QMap>
+#include <QHash>
+#include <QQueue>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTimer>
+
+class QSslSocket;
+
+// Measures how fast mirrors respond: the TCP connect time and the time until
+// the status line of the reply to a HEAD request (or the FTP greeting) arrives.
+// Only a 2xx/3xx status or a 220 greeting counts as a success.
+// The mirrors are probed concurrently, results are cached per URL for a while.
+class MirrorProber : public QObject
+{
+Q_OBJECT
+public:
+	MirrorProber(QObject* parent = 0);
+	~MirrorProber();
+
+	void probe(const QStringList& urls);
+	bool isProbing() const { return !m_queue.isEmpty() || !m_active.isEmpty(); }
+
+	// Mirror groups from data/mirrors.txt
+	static QMap<QString,QStringList> loadMirrors();
+	// Mirrors serving the same files as urls, by mirror group; the URLs point to the files
+	static QMap<QString,QStringList> findMirrors(const QStringList& urls);
+signals:
+	// the times are in milliseconds, -1 if the mirror is unreachable
+	void probed(QString url, int connect, int response);
+	void finished();
+private slots:
+	void socketConnected();
+	void socketEncrypted();
+	void socketReadyRead();
+	void socketError();
+	void checkTimeouts();
+private:
+	void startNext();
+	void sendRequest(QSslSocket* socket);
+	void finish(QSslSocket* socket, bool ok);
+	static bool statusOk(const QString& scheme, const QByteArray& line);
+private:
+	struct Probe
+	{
+		QString url;
+		QElapsedTimer timer;
+		int connect, response;
+		QByteArray reply;
+	};
+
+	QQueue<QString> m_queue;
+	QHash<QSslSocket*, Probe> m_active;
+	QTimer m_timer;
+};
+
+#endif
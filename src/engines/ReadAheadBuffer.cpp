@@ -0,0 +1,264 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "config.h"
+#include "ReadAheadBuffer.h"
+#include "CurlPoller.h"
+#include <QtDebug>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+
+#ifndef POSIX_LINUX
+#	define O_LARGEFILE 0
+#	define pread64 pread
+#	define lseek64 lseek
+#endif
+
+ReadAheadBuffer::ReadAheadBuffer(int blockSize, int blocks)
+	: m_nBlockSize(blockSize), m_nHead(0), m_nFilled(0), m_nHeadOffset(0), m_file(-1),
+	  m_nSize(0), m_nPos(0), m_nReadPos(0), m_nEnd(-1), m_bAbort(false), m_bEOF(false), m_bStarved(false), m_curl(0), m_poller(0)
+{
+	m_blocks.resize(blocks);
+	m_blockFill.resize(blocks);
+}
+
+ReadAheadBuffer::~ReadAheadBuffer()
+{
+	close();
+}
+
+bool ReadAheadBuffer::open(QString path)
+{
+	close();
+
+	std::string spath = path.toStdString();
+	int file = ::open(spath.c_str(), O_RDONLY|O_LARGEFILE);
+
+	QMutexLocker l(&m_lock);
+	if(file < 0)
+	{
+		m_strError = strerror(errno);
+		return false;
+	}
+
+	m_nSize = lseek64(file, 0, SEEK_END);
+	if(m_nSize < 0)
+		m_nSize = 0;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	for(int i=0;i<m_blocks.size();i++)
+	{
+		if(m_blocks[i].size() != m_nBlockSize)
+			m_blocks[i].resize(m_nBlockSize);
+	}
+
+	m_file = file;
+	m_strError.clear();
+	return true;
+}
+
+void ReadAheadBuffer::close()
+{
+	stopThread();
+
+	QMutexLocker l(&m_lock);
+	if(m_file >= 0)
+	{
+		::close(m_file);
+		m_file = -1;
+	}
+	m_nFilled = m_nHeadOffset = 0;
+	m_nPos = m_nReadPos = 0;
+	m_nEnd = -1;
+	m_bEOF = m_bStarved = false;
+	m_curl = 0;
+	m_poller = 0;
+}
+
+bool ReadAheadBuffer::isOpen() const
+{
+	QMutexLocker l(&m_lock);
+	return m_file >= 0;
+}
+
+void ReadAheadBuffer::stopThread()
+{
+	m_lock.lock();
+	m_bAbort = true;
+	m_spaceAvailable.wakeAll();
+	m_lock.unlock();
+
+	wait();
+
+	m_bAbort = false;
+}
+
+void ReadAheadBuffer::seek(qint64 offset, qint64 length)
+{
+	stopThread();
+
+	QMutexLocker l(&m_lock);
+	if(m_file < 0)
+		return;
+
+	m_nHead = m_nFilled = m_nHeadOffset = 0;
+	m_nPos = m_nReadPos = offset;
+	m_nEnd = (length >= 0) ? offset + length : -1;
+	m_bEOF = false;
+
+	start();
+}
+
+void ReadAheadBuffer::setCurlHandle(CURL* handle, CurlPoller* poller)
+{
+	QMutexLocker l(&m_lock);
+	m_curl = handle;
+	m_poller = poller;
+	m_bStarved = false;
+}
+
+qint64 ReadAheadBuffer::read(char* buffer, qint64 maxData)
+{
+	QMutexLocker l(&m_lock);
+	qint64 copied = 0;
+
+	if(m_file < 0)
+		return Error;
+
+	while(copied < maxData && m_nFilled > 0)
+	{
+		const QByteArray& block = m_blocks[m_nHead];
+		int avail = m_blockFill[m_nHead] - m_nHeadOffset;
+		int now = int(qMin<qint64>(avail, maxData - copied));
+
+		memcpy(buffer + copied, block.constData() + m_nHeadOffset, now);
+		copied += now;
+		m_nHeadOffset += now;
+
+		if(m_nHeadOffset >= m_blockFill[m_nHead])
+		{
+			m_nHead = (m_nHead + 1) % m_blocks.size();
+			m_nFilled--;
+			m_nHeadOffset = 0;
+			m_spaceAvailable.wakeOne();
+		}
+	}
+
+	m_nPos += copied;
+
+	if(copied)
+		return copied;
+	else if(!m_strError.isEmpty())
+		return Error;
+	else if(m_bEOF)
+		return 0;
+
+	// the I/O thread will unpause the handle once it has filled a block
+	m_bStarved = true;
+	return WouldBlock;
+}
+
+qint64 ReadAheadBuffer::pos() const
+{
+	QMutexLocker l(&m_lock);
+	return m_nPos;
+}
+
+qint64 ReadAheadBuffer::size() const
+{
+	QMutexLocker l(&m_lock);
+	return m_nSize;
+}
+
+QString ReadAheadBuffer::errorString() const
+{
+	QMutexLocker l(&m_lock);
+	return m_strError;
+}
+
+void ReadAheadBuffer::run()
+{
+	QMutexLocker l(&m_lock);
+
+	while(!m_bAbort && !m_bEOF)
+	{
+		while(m_nFilled == m_blocks.size() && !m_bAbort)
+			m_spaceAvailable.wait(&m_lock);
+		if(m_bAbort)
+			break;
+
+		int tail = (m_nHead + m_nFilled) % m_blocks.size();
+		qint64 offset = m_nReadPos;
+		char* data = m_blocks[tail].data();
+		size_t toRead = m_nBlockSize;
+
+		if(m_nEnd >= 0)
+			toRead = size_t(qBound<qint64>(0, m_nEnd - offset, m_nBlockSize));
+
+		// the consumer never touches blocks beyond m_nFilled
+		l.unlock();
+		ssize_t rd = toRead ? pread64(m_file, data, toRead, offset) : 0;
+#ifdef POSIX_FADV_DONTNEED
+		// uploaded data is not going to be read again
+		if(rd > 0 && offset > 0)
+			posix_fadvise(m_file, 0, offset, POSIX_FADV_DONTNEED);
+#endif
+		l.relock();
+
+		if(m_bAbort)
+			break;
+
+		if(rd < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			m_strError = strerror(errno);
+		}
+		else if(rd == 0)
+			m_bEOF = true;
+		else
+		{
+			m_blockFill[tail] = int(rd);
+			m_nReadPos += rd;
+			m_nFilled++;
+		}
+
+		if(m_bStarved && m_curl)
+		{
+			m_bStarved = false;
+			(m_poller ? m_poller : CurlPoller::instance())->resumeTransfer(m_curl);
+		}
+
+		if(!m_strError.isEmpty())
+			break;
+	}
+}
@@ -0,0 +1,84 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef READAHEADBUFFER_H
+#define READAHEADBUFFER_H
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+#include <curl/curl.h>
+
+class CurlPoller;
+
+// Reads a file sequentially on its own thread into a ring of large blocks,
+// so that the libcurl read callback on the poller thread never touches the disk.
+class ReadAheadBuffer : public QThread
+{
+public:
+	ReadAheadBuffer(int blockSize = 1024*1024, int blocks = 4);
+	virtual ~ReadAheadBuffer();
+
+	enum { WouldBlock = -1, Error = -2 };
+
+	bool open(QString path);
+	void close();
+	bool isOpen() const;
+	// Discards the buffered data and starts prefetching at the given offset,
+	// a non-negative length makes read() report the end after as many bytes
+	void seek(qint64 offset, qint64 length = -1);
+	// Returns WouldBlock if no data is ready yet, 0 at the end of the file
+	qint64 read(char* buffer, qint64 maxData);
+	// Position of the next byte returned by read()
+	qint64 pos() const;
+	qint64 size() const;
+	QString errorString() const;
+
+	// The handle to unpause once a read returning WouldBlock may succeed,
+	// poller is the (sub)poller the handle has been added to
+	void setCurlHandle(CURL* handle, CurlPoller* poller = 0);
+protected:
+	virtual void run();
+	void stopThread();
+private:
+	mutable QMutex m_lock;
+	QWaitCondition m_spaceAvailable;
+	QVector<QByteArray> m_blocks;
+	QVector<int> m_blockFill;
+	int m_nBlockSize;
+	int m_nHead, m_nFilled, m_nHeadOffset;
+
+	int m_file;
+	qint64 m_nSize, m_nPos, m_nReadPos, m_nEnd;
+	bool m_bAbort, m_bEOF, m_bStarved;
+	QString m_strError;
+	CURL* m_curl;
+	CurlPoller* m_poller;
+};
+
+#endif // READAHEADBUFFER_H
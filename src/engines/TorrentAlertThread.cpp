@@ -0,0 +1,278 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "TorrentAlertThread.h"
+#include "TorrentDownload.h"
+#include "Logger.h"
+#include <libtorrent/alert_types.hpp>
+#include <libtorrent/time.hpp>
+#include <QElapsedTimer>
+#include <memory>
+#include <iostream>
+
+TorrentAlertThread::TorrentAlertThread(libtorrent::session* session)
+	: m_session(session), m_bAbort(false), m_events(0)
+{
+}
+
+void TorrentAlertThread::stop()
+{
+	m_bAbort = true;
+	wait();
+	
+	TorrentEvent* ev = takeEvents();
+	while(ev)
+	{
+		TorrentEvent* next = ev->next;
+		delete ev;
+		ev = next;
+	}
+}
+
+void TorrentAlertThread::run()
+{
+	while(!m_bAbort)
+	{
+		// the timeout only serves to notice stop()
+		if(!m_session->wait_for_alert(libtorrent::milliseconds(500)))
+			continue;
+		
+		while(true)
+		{
+			std::unique_ptr<libtorrent::alert> a = m_session->pop_alert();
+			
+			if(!a.get())
+				break;
+			
+			processAlert(a.get());
+		}
+	}
+}
+
+void TorrentAlertThread::post(TorrentEvent* ev)
+{
+	TorrentEvent* head;
+	
+	do
+	{
+		head = m_events.load();
+		ev->next = head;
+	}
+	while(!m_events.testAndSetRelease(head, ev));
+	
+	// the GUI thread has emptied the list, it needs to be told again
+	if(!head)
+		emit eventsPending();
+}
+
+TorrentEvent* TorrentAlertThread::takeEvents()
+{
+	TorrentEvent* ev = m_events.fetchAndStoreAcquire(0);
+	TorrentEvent* ordered = 0;
+	
+	// the list is built by prepending
+	while(ev)
+	{
+		TorrentEvent* next = ev->next;
+		ev->next = ordered;
+		ordered = ev;
+		ev = next;
+	}
+	
+	return ordered;
+}
+
+void TorrentAlertThread::processAlert(libtorrent::alert* aaa)
+{
+	const int type = aaa->type();
+	TorrentEvent* ev = 0;
+	
+	switch(type)
+	{
+		case libtorrent::save_resume_data_alert::alert_type:
+		{
+			libtorrent::save_resume_data_alert* alert = static_cast<libtorrent::save_resume_data_alert*>(aaa);
+			QByteArray data = TorrentDownload::bencode_simple(*alert->resume_data);
+			
+			if(!resumeDataArrived(alert->handle, data))
+			{
+				ev = new TorrentEvent(type);
+				ev->data = data;
+			}
+			break;
+		}
+		case libtorrent::save_resume_data_failed_alert::alert_type:
+			std::cout << "Save data failed\n";
+			if(!resumeDataArrived(static_cast<libtorrent::torrent_alert*>(aaa)->handle, QByteArray("")))
+				ev = new TorrentEvent(type);
+			break;
+		case libtorrent::read_piece_alert::alert_type:
+		{
+			libtorrent::read_piece_alert* alert = static_cast<libtorrent::read_piece_alert*>(aaa);
+			QByteArray data;
+			
+			if(!alert->ec && alert->buffer)
+				data = QByteArray(alert->buffer.get(), alert->size);
+			pieceArrived(alert->handle, alert->piece, data);
+			break;
+		}
+		case libtorrent::state_update_alert::alert_type:
+			ev = new TorrentEvent(type);
+			ev->status.swap(static_cast<libtorrent::state_update_alert*>(aaa)->status);
+			break;
+		case libtorrent::piece_finished_alert::alert_type:
+			ev = new TorrentEvent(type);
+			ev->value = static_cast<libtorrent::piece_finished_alert*>(aaa)->piece_index;
+			break;
+		case libtorrent::tracker_error_alert::alert_type:
+		{
+			libtorrent::tracker_error_alert* alert = static_cast<libtorrent::tracker_error_alert*>(aaa);
+			ev = new TorrentEvent(type);
+			ev->value = alert->times_in_row;
+			ev->value2 = alert->status_code;
+			break;
+		}
+		case libtorrent::file_error_alert::alert_type:
+		case libtorrent::tracker_announce_alert::alert_type:
+		case libtorrent::tracker_warning_alert::alert_type:
+		case libtorrent::fastresume_rejected_alert::alert_type:
+		case libtorrent::metadata_failed_alert::alert_type:
+		case libtorrent::metadata_received_alert::alert_type:
+			ev = new TorrentEvent(type);
+			break;
+#ifdef LIBTORRENT_0_15
+		case libtorrent::dht_announce_alert::alert_type:
+		case libtorrent::dht_get_peers_alert::alert_type:
+			break;
+#endif
+		default:
+			// other torrent alerts are of no interest, the rest goes to the log
+			if(!dynamic_cast<libtorrent::torrent_alert*>(aaa))
+				Logger::global()->enterLogMessage("BitTorrent", aaa->message().c_str());
+	}
+	
+	if(ev)
+	{
+		if(type != libtorrent::state_update_alert::alert_type)
+		{
+			std::string smsg = aaa->message();
+			ev->handle = static_cast<libtorrent::torrent_alert*>(aaa)->handle;
+			ev->message = QString::fromUtf8(smsg.c_str());
+		}
+		post(ev);
+	}
+}
+
+void TorrentAlertThread::expectResumeData(const libtorrent::sha1_hash& hash)
+{
+	QMutexLocker l(&m_mutexWait);
+	m_resumeData[TorrentWorker::hashKey(hash)] = QByteArray();
+}
+
+bool TorrentAlertThread::waitForResumeData(const libtorrent::sha1_hash& hash, QByteArray& data, int timeout)
+{
+	QByteArray key = TorrentWorker::hashKey(hash);
+	QElapsedTimer timer;
+	QMutexLocker l(&m_mutexWait);
+	
+	timer.start();
+	while(m_resumeData.value(key).isNull())
+	{
+		int left = timeout - timer.elapsed();
+		
+		if(left <= 0 || !m_condWait.wait(&m_mutexWait, left))
+			break;
+	}
+	
+	// a late result is dropped once the key is gone
+	data = m_resumeData.take(key);
+	return !data.isEmpty();
+}
+
+bool TorrentAlertThread::resumeDataArrived(const libtorrent::torrent_handle& handle, const QByteArray& data)
+{
+	QByteArray key = TorrentWorker::hashKey(handle.info_hash());
+	QMutexLocker l(&m_mutexWait);
+	
+	// a waiter that already has its result doesn't take another one
+	if(!m_resumeData.contains(key) || !m_resumeData[key].isNull())
+		return false;
+	
+	m_resumeData[key] = data;
+	m_condWait.wakeAll();
+	return true;
+}
+
+QByteArray TorrentAlertThread::pieceKey(const libtorrent::sha1_hash& hash, int piece)
+{
+	QByteArray key = TorrentWorker::hashKey(hash);
+	key.append((const char*) &piece, sizeof(piece));
+	return key;
+}
+
+void TorrentAlertThread::expectPiece(const libtorrent::sha1_hash& hash, int piece)
+{
+	QMutexLocker l(&m_mutexWait);
+	m_pieceReads[pieceKey(hash, piece)].waiters++;
+}
+
+bool TorrentAlertThread::waitForPiece(const libtorrent::sha1_hash& hash, int piece, QByteArray& data, int timeout)
+{
+	QByteArray key = pieceKey(hash, piece);
+	QElapsedTimer timer;
+	QMutexLocker l(&m_mutexWait);
+	
+	timer.start();
+	while(!m_pieceReads[key].done)
+	{
+		int left = timeout - timer.elapsed();
+		
+		if(left <= 0 || !m_condWait.wait(&m_mutexWait, left))
+			break;
+	}
+	
+	PieceRead& read = m_pieceReads[key];
+	
+	data = read.data;
+	if(--read.waiters <= 0)
+		m_pieceReads.remove(key);
+	
+	return !data.isEmpty();
+}
+
+void TorrentAlertThread::pieceArrived(const libtorrent::torrent_handle& handle, int piece, const QByteArray& data)
+{
+	QByteArray key = pieceKey(handle.info_hash(), piece);
+	QMutexLocker l(&m_mutexWait);
+	QHash<QByteArray, PieceRead>::iterator it = m_pieceReads.find(key);
+	
+	if(it != m_pieceReads.end())
+	{
+		it->data = data;
+		it->done = true;
+		m_condWait.wakeAll();
+	}
+}
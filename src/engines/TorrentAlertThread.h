@@ -0,0 +1,117 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef TORRENTALERTTHREAD_H
+#define TORRENTALERTTHREAD_H
+#include "config.h"
+
+#ifndef WITH_BITTORRENT
+#	error This file is not supposed to be included!
+#endif
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicPointer>
+#include <QHash>
+#include <QByteArray>
+#include <QString>
+#include <vector>
+#include <libtorrent/session.hpp>
+#include <libtorrent/torrent_handle.hpp>
+
+// What the GUI thread needs to know about an alert, copied out on the alert thread
+struct TorrentEvent
+{
+	TorrentEvent(int t) : type(t), value(0), value2(0), next(0) {}
+	
+	// the libtorrent alert type id
+	int type;
+	libtorrent::torrent_handle handle;
+	QString message;
+	int value, value2;
+	std::vector<libtorrent::torrent_status> status;
+	// resume data nobody has been waiting for, empty if saving failed
+	QByteArray data;
+	
+	TorrentEvent* next;
+};
+
+// Sleeps in wait_for_alert() and drains the alert queue as soon as something arrives.
+// Events are handed over through a lock-free list; eventsPending() is emitted
+// whenever the list stops being empty.
+class TorrentAlertThread : public QThread
+{
+Q_OBJECT
+public:
+	TorrentAlertThread(libtorrent::session* session);
+	
+	void run();
+	void stop();
+	
+	// Returns the pending events in the order they were posted, the caller deletes them
+	TorrentEvent* takeEvents();
+	
+	// Call before save_resume_data(), then wait for the result.
+	// Resume data that hasn't been expected is posted as an event.
+	void expectResumeData(const libtorrent::sha1_hash& hash);
+	bool waitForResumeData(const libtorrent::sha1_hash& hash, QByteArray& data, int timeout);
+	
+	// The same for pieces requested with read_piece() or a deadline with alert_when_available
+	void expectPiece(const libtorrent::sha1_hash& hash, int piece);
+	bool waitForPiece(const libtorrent::sha1_hash& hash, int piece, QByteArray& data, int timeout);
+signals:
+	void eventsPending();
+private:
+	void processAlert(libtorrent::alert* aaa);
+	void post(TorrentEvent* ev);
+	// returns false if there's no waiter for the data
+	bool resumeDataArrived(const libtorrent::torrent_handle& handle, const QByteArray& data);
+	void pieceArrived(const libtorrent::torrent_handle& handle, int piece, const QByteArray& data);
+	static QByteArray pieceKey(const libtorrent::sha1_hash& hash, int piece);
+private:
+	struct PieceRead
+	{
+		PieceRead() : waiters(0), done(false) {}
+		
+		int waiters;
+		bool done;
+		QByteArray data;
+	};
+	
+	libtorrent::session* m_session;
+	volatile bool m_bAbort;
+	QAtomicPointer<TorrentEvent> m_events;
+	
+	// info-hash -> resume data; a null array while pending, an empty one when saving failed
+	QHash<QByteArray, QByteArray> m_resumeData;
+	// several readers may wait for the same piece
+	QHash<QByteArray, PieceRead> m_pieceReads;
+	QMutex m_mutexWait;
+	QWaitCondition m_condWait;
+};
+
+#endif
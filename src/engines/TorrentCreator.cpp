@@ -0,0 +1,387 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "TorrentCreator.h"
+#include "RuntimeException.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QMap>
+#include <QMutex>
+#include <QUuid>
+#include <QDateTime>
+#include <QRunnable>
+#include <QtDebug>
+#include <cstring>
+#include <iterator>
+#include <libtorrent/bencode.hpp>
+#include <libtorrent/hasher.hpp>
+
+#ifdef WITH_WEBINTERFACE
+#	include "remote/XmlRpcService.h"
+#endif
+
+// the amount of data read at once, pieces are hashed in blocks of this size
+static const qint64 BLOCK_SIZE = 16*1024*1024;
+
+// jobs started through XML-RPC
+struct CreatorJob
+{
+	CreatorJob(TorrentCreator* c = 0) : creator(c), lastPoll(QDateTime::currentDateTime().toTime_t()) {}
+
+	TorrentCreator* creator;
+	uint lastPoll;
+};
+static QMap<QString, CreatorJob> g_jobs;
+static QMutex g_mutexJobs;
+// seconds after which a job nobody asks about gets aborted and forgotten
+static const uint JOB_EXPIRY = 10*60;
+
+class TorrentCreator::HashJob : public QRunnable
+{
+public:
+	HashJob(TorrentCreator* creator, int first, const QByteArray& data)
+		: m_creator(creator), m_nFirst(first), m_data(data)
+	{
+	}
+	virtual void run()
+	{
+		const int pieceLength = m_creator->m_info->piece_length();
+		const char* p = m_data.constData();
+		int count = 0;
+
+		for (qint64 pos = 0; pos < m_data.size() && !m_creator->m_bAbort.load(); pos += pieceLength, count++)
+		{
+			int len = int(qMin<qint64>(pieceLength, m_data.size() - pos));
+			libtorrent::hasher h(p + pos, len);
+			m_creator->m_hashes[m_nFirst + count] = h.final();
+		}
+
+		// free the block before letting the reader allocate another one
+		m_data.clear();
+		m_creator->m_semBlocks.release();
+
+		int done = m_creator->m_nDone.fetchAndAddOrdered(count) + count;
+		emit m_creator->progress(done);
+	}
+private:
+	TorrentCreator* m_creator;
+	int m_nFirst;
+	QByteArray m_data;
+};
+
+TorrentCreator::TorrentCreator(QString dataPath, int pieceSize, QObject* parent)
+	: QThread(parent), m_info(0), m_bAbort(0), m_nDone(0),
+	  m_semBlocks(2 * qMax(1, QThread::idealThreadCount())), m_nFile(0), m_nFileOffset(0)
+{
+	QFileInfo info(dataPath);
+	QList<QPair<QString, qint64> > files;
+
+	if (dataPath.isEmpty() || !info.exists())
+		throw RuntimeException(tr("The data path is invalid."));
+
+	if (!info.isDir())
+	{
+		m_strBaseDir = info.absolutePath();
+		files << QPair<QString, qint64>(info.fileName(), info.size());
+	}
+	else
+	{
+		QDir dir(dataPath);
+		recurseDir(files, dir.dirName() + '/', dataPath);
+		dir.cdUp();
+
+		m_strBaseDir = dir.absolutePath();
+	}
+
+	qint64 total = 0;
+	for (int i = 0; i < files.size(); i++)
+	{
+		QByteArray name = files[i].first.toUtf8();
+		m_fs.add_file(name.data(), files[i].second);
+		total += files[i].second;
+	}
+
+	if (!total)
+		throw RuntimeException(tr("There is no data to create a torrent from."));
+
+	m_info = new libtorrent::create_torrent(m_fs, pieceSize);
+	m_info->set_creator("FatRat " VERSION);
+
+	m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+}
+
+TorrentCreator::~TorrentCreator()
+{
+	abort();
+	wait();
+	delete m_info;
+}
+
+void TorrentCreator::recurseDir(QList<QPair<QString, qint64> >& list, QString prefix, QString path)
+{
+	QDir dir(path);
+	QFileInfoList flist = dir.entryInfoList();
+
+	for(int i=0;i<flist.size();i++)
+	{
+		if(flist[i].fileName() == "." || flist[i].fileName() == "..")
+			continue;
+
+		if(flist[i].isDir())
+			recurseDir(list, prefix + flist[i].fileName() + '/', flist[i].absoluteFilePath());
+		else
+			list << QPair<QString, qint64>(prefix + flist[i].fileName(), flist[i].size());
+	}
+}
+
+void TorrentCreator::run()
+{
+	const int num = m_info->num_pieces();
+	const int pieceLength = m_info->piece_length();
+	const int perBlock = int(qMax<qint64>(1, BLOCK_SIZE / pieceLength));
+
+	m_hashes.assign(num, libtorrent::sha1_hash());
+	m_nDone.store(0);
+	m_nFile = 0;
+	m_nFileOffset = 0;
+
+	for (int first = 0; first < num && !m_bAbort.load(); first += perBlock)
+	{
+		const int count = qMin(perBlock, num - first);
+		const qint64 bytes = qint64(count-1) * pieceLength + m_info->piece_size(first + count - 1);
+
+		m_semBlocks.acquire();
+
+		QByteArray block(int(bytes), Qt::Uninitialized);
+		if (!readBlock(block.data(), bytes))
+		{
+			m_semBlocks.release();
+			break;
+		}
+
+		m_pool.start(new HashJob(this, first, block));
+	}
+
+	m_pool.waitForDone();
+	m_file.close();
+
+	if (m_bAbort.load() && m_strError.isEmpty())
+		m_strError = tr("The torrent creation has been aborted.");
+	if (!m_strError.isEmpty())
+		return;
+
+	// set in order, create_torrent isn't thread safe
+	for (int i = 0; i < num; i++)
+		m_info->set_hash(i, m_hashes[i]);
+
+	if (!m_strOutput.isEmpty())
+	{
+		QFile file(m_strOutput);
+		if (!file.open(QIODevice::WriteOnly) || file.write(generate()) < 0)
+			m_strError = tr("Failed to save the torrent: %1").arg(file.errorString());
+	}
+}
+
+bool TorrentCreator::readBlock(char* buf, qint64 bytes)
+{
+	const libtorrent::file_storage& fs = m_info->files();
+
+	while (bytes > 0)
+	{
+		if (m_nFile >= fs.num_files())
+		{
+			m_strError = tr("The data is shorter than expected.");
+			return false;
+		}
+
+		const libtorrent::file_entry fe = fs.at(m_nFile);
+		const qint64 chunk = qMin<qint64>(fe.size - m_nFileOffset, bytes);
+
+		if (fe.pad_file)
+			memset(buf, 0, chunk);
+		else if (chunk > 0)
+		{
+			if (!m_file.isOpen())
+			{
+				m_file.setFileName(m_strBaseDir + '/' + QString::fromUtf8(fe.path.c_str()));
+				if (!m_file.open(QIODevice::ReadOnly))
+				{
+					m_strError = tr("Failed to open %1: %2").arg(m_file.fileName()).arg(m_file.errorString());
+					return false;
+				}
+			}
+			if (m_file.read(buf, chunk) != chunk)
+			{
+				m_strError = tr("Failed to read %1: %2").arg(m_file.fileName()).arg(m_file.errorString());
+				return false;
+			}
+		}
+
+		buf += chunk;
+		bytes -= chunk;
+		m_nFileOffset += chunk;
+
+		if (m_nFileOffset >= fe.size)
+		{
+			m_file.close();
+			m_nFile++;
+			m_nFileOffset = 0;
+		}
+	}
+
+	return true;
+}
+
+QByteArray TorrentCreator::generate() const
+{
+	QByteArray data;
+	libtorrent::entry e = m_info->generate();
+
+	libtorrent::bencode(std::back_inserter(data), e);
+	return data;
+}
+
+void TorrentCreator::globalInit()
+{
+#ifdef WITH_WEBINTERFACE
+	XmlRpcService::registerFunction("TorrentCreator.create", createTorrent,
+					QVector<QVariant::Type>() << QVariant::String << QVariant::String << QVariant::StringList
+					<< QVariant::String << QVariant::Bool << QVariant::Int);
+	XmlRpcService::registerFunction("TorrentCreator.getProgress", getProgress,
+					QVector<QVariant::Type>() << QVariant::String);
+	XmlRpcService::registerFunction("TorrentCreator.cancel", cancel,
+					QVector<QVariant::Type>() << QVariant::String);
+#endif
+}
+
+void TorrentCreator::expireJobs()
+{
+	QMutexLocker l(&g_mutexJobs);
+	const uint now = QDateTime::currentDateTime().toTime_t();
+
+	for (QMap<QString, CreatorJob>::iterator it = g_jobs.begin(); it != g_jobs.end();)
+	{
+		if (now - it->lastPoll < JOB_EXPIRY)
+		{
+			++it;
+			continue;
+		}
+
+		// a running job is only told to stop, it goes away on a later call
+		if (!it->creator->isFinished())
+		{
+			it->creator->abort();
+			++it;
+		}
+		else
+		{
+			delete it->creator;
+			it = g_jobs.erase(it);
+		}
+	}
+}
+
+#ifdef WITH_WEBINTERFACE
+
+// Arguments: data path, torrent file to save, trackers, comment, private flag, piece size (0 = auto)
+// Returns the job ID to be passed to TorrentCreator.getProgress
+QVariant TorrentCreator::createTorrent(QList<QVariant>& args)
+{
+	TorrentCreator* creator;
+
+	try
+	{
+		creator = new TorrentCreator(args[0].toString(), args[5].toInt());
+	}
+	catch (const RuntimeException& e)
+	{
+		throw XmlRpcService::XmlRpcError(406, e.what());
+	}
+
+	QStringList trackers = args[2].toStringList();
+	foreach (QString tracker, trackers)
+	{
+		if (tracker.startsWith("http://") || tracker.startsWith("https://") || tracker.startsWith("udp://"))
+			creator->info()->add_tracker(tracker.toStdString());
+	}
+
+	QByteArray comment = args[3].toString().toUtf8();
+	creator->info()->set_comment(comment.constData());
+	creator->info()->set_priv(args[4].toBool());
+	creator->setOutputFile(args[1].toString());
+
+	QString id = QUuid::createUuid().toString();
+	{
+		QMutexLocker l(&g_mutexJobs);
+		g_jobs[id] = CreatorJob(creator);
+	}
+
+	creator->start(QThread::LowPriority);
+	return id;
+}
+
+// Returns a map with "done", "total", "finished" and "error"; finished jobs are forgotten
+QVariant TorrentCreator::getProgress(QList<QVariant>& args)
+{
+	QMutexLocker l(&g_mutexJobs);
+	QVariantMap rv;
+	QMap<QString, CreatorJob>::iterator it = g_jobs.find(args[0].toString());
+
+	if (it == g_jobs.end())
+		throw XmlRpcService::XmlRpcError(407, tr("Invalid job ID"));
+
+	TorrentCreator* creator = it->creator;
+	it->lastPoll = QDateTime::currentDateTime().toTime_t();
+
+	rv["done"] = creator->piecesDone();
+	rv["total"] = creator->numPieces();
+	rv["finished"] = creator->isFinished();
+	rv["error"] = QString();
+
+	if (creator->isFinished())
+	{
+		rv["error"] = creator->error();
+		g_jobs.erase(it);
+		delete creator;
+	}
+
+	return rv;
+}
+
+// Stops the hashing; TorrentCreator.getProgress then reports the job as finished with an error
+QVariant TorrentCreator::cancel(QList<QVariant>& args)
+{
+	QMutexLocker l(&g_mutexJobs);
+	QMap<QString, CreatorJob>::iterator it = g_jobs.find(args[0].toString());
+
+	if (it == g_jobs.end())
+		throw XmlRpcService::XmlRpcError(407, tr("Invalid job ID"));
+
+	it->creator->abort();
+	return QVariant();
+}
+
+#endif
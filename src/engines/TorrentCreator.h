@@ -0,0 +1,105 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef TORRENTCREATOR_H
+#define TORRENTCREATOR_H
+#include "config.h"
+
+#ifndef WITH_BITTORRENT
+#	error This file is not supposed to be included!
+#endif
+
+#include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QVariant>
+#include <QFile>
+#include <QPair>
+#include <vector>
+#include <libtorrent/create_torrent.hpp>
+
+// Hashes the data of a new torrent. The files are read sequentially in large
+// blocks by this thread, the pieces within are hashed on a pool of workers.
+// Used by CreateTorrentDlg and by the XML-RPC interface.
+class TorrentCreator : public QThread
+{
+Q_OBJECT
+public:
+	// pieceSize 0 lets libtorrent pick one
+	TorrentCreator(QString dataPath, int pieceSize = 0, QObject* parent = 0);
+	~TorrentCreator();
+
+	virtual void run();
+	void abort() { m_bAbort.store(1); }
+
+	const QString& error() const { return m_strError; }
+	libtorrent::create_torrent* info() { return m_info; }
+	int numPieces() const { return m_info->num_pieces(); }
+	int piecesDone() const { return m_nDone.load(); }
+
+	// bencoded torrent, only valid after successful hashing
+	QByteArray generate() const;
+	// the torrent is saved here once hashed, if set
+	void setOutputFile(QString file) { m_strOutput = file; }
+
+	static void globalInit();
+	// aborts and forgets the XML-RPC jobs nobody has polled for a while
+	static void expireJobs();
+signals:
+	void progress(int pos);
+protected:
+	class HashJob;
+
+	static void recurseDir(QList<QPair<QString, qint64> >& list, QString prefix, QString path);
+	bool readBlock(char* buf, qint64 bytes);
+
+#ifdef WITH_WEBINTERFACE
+	static QVariant createTorrent(QList<QVariant>& args);
+	static QVariant getProgress(QList<QVariant>& args);
+	static QVariant cancel(QList<QVariant>& args);
+#endif
+private:
+	libtorrent::file_storage m_fs;
+	libtorrent::create_torrent* m_info;
+	QString m_strBaseDir, m_strError, m_strOutput;
+	QAtomicInt m_bAbort, m_nDone;
+
+	std::vector<libtorrent::sha1_hash> m_hashes;
+	QThreadPool m_pool;
+	// limits the number of blocks held in memory
+	QSemaphore m_semBlocks;
+
+	// the file being read by readBlock()
+	QFile m_file;
+	int m_nFile;
+	qint64 m_nFileOffset;
+};
+
+#endif
@@ -39,13 +39,17 @@ respects for all of the code used other than "OpenSSL".
 #include <libtorrent/magnet_uri.hpp>
 #include <libtorrent/peer_info.hpp>
 
+static const int HIDDEN_TAB_REFRESH = 5;
+
 
 TorrentDetails::TorrentDetails(QWidget* me, TorrentDownload* obj)
-	: m_download(obj), m_bFilled(false)
+	: m_download(obj), m_bFilled(false), m_bPiecesChanged(false), m_nTicks(0), m_nLastState(-1)
 {
 	connect(obj, SIGNAL(destroyed(QObject*)), this, SLOT(deleteLater()));
+	connect(obj, SIGNAL(pieceFinished(int)), this, SLOT(pieceFinished(int)));
 	setupUi(me);
 	TorrentDownload::m_worker->setDetailsObject(this);
+	connect(tabWidget, SIGNAL(currentChanged(int)), this, SLOT(refresh()));
 	
 	m_pPiecesModel = new TorrentPiecesModel(treePieces, obj);
 	treePieces->setModel(m_pPiecesModel);
@@ -111,7 +115,8 @@ void TorrentDetails::setPriority(int p)
 {
 	foreach(int i, m_selFiles)
 		m_download->m_vecPriorities[i] = p;
-	m_download->m_handle.prioritize_files(m_download->m_vecPriorities);
+	if(m_download->m_handle.is_valid())
+		m_download->m_handle.prioritize_files(m_download->m_vecPriorities);
 }
 
 void TorrentDetails::openFile()
@@ -146,7 +151,7 @@ void TorrentDetails::peerInfo()
 
 void TorrentDetails::fileContext(const QPoint&)
 {
-	if(m_download && m_download->m_handle.is_valid())
+	if(m_download && m_download->m_info)
 	{
 		int numFiles = m_download->m_info->num_files();
 		QModelIndexList list = treeFiles->selectionModel()->selectedRows();
@@ -178,7 +183,8 @@ void TorrentDetails::destroy()
 
 void TorrentDetails::fill()
 {
-	if(m_download && m_download->m_handle.is_valid() && m_download->m_info)
+	// dormant torrents have their metadata loaded only now
+	if(m_download && m_download->ensureMetadata())
 	{
 		m_bFilled = true;
 		
@@ -197,8 +203,7 @@ void TorrentDetails::fill()
 		lineCreator->setText(m_download->m_info->creator().c_str());
 		linePrivate->setText( m_download->m_info->priv() ? tr("yes") : tr("no"));
 		
-		QString magnet = QString::fromStdString(libtorrent::make_magnet_uri(m_download->m_handle));
-		lineMagnet->setText(magnet);
+		lineMagnet->setText(m_download->remoteURI());
 		
 		m_pFilesModel->fill();
 	}
@@ -206,11 +211,15 @@ void TorrentDetails::fill()
 
 void TorrentDetails::refresh()
 {
+	if(m_download && !m_bFilled)
+		fill();
+	
+	// tabs that aren't being looked at only get refreshed every few seconds
+	const bool slowTick = (m_nTicks++ % HIDDEN_TAB_REFRESH) == 0;
+	QWidget* current = tabWidget->currentWidget();
+	
 	if(m_download && m_download->m_handle.is_valid() && m_download->m_info)
-	{
-		if(!m_bFilled)
-			fill();
-		
+	{		
 		// GENERAL
 		boost::posix_time::time_duration& next = m_download->m_status.next_announce;
 		boost::posix_time::time_duration& intv = m_download->m_status.announce_interval;
@@ -232,21 +241,36 @@ void TorrentDetails::refresh()
 				.arg(next.hours()).arg(next.minutes(),2,10,QChar('0')).arg(next.seconds(),2,10,QChar('0'))
 				.arg(intv.hours()).arg(intv.minutes(),2,10,QChar('0')).arg(intv.seconds(),2,10,QChar('0')));
 		
-		libtorrent::bitfield pieces = m_download->m_status.pieces;
-		
-		if(pieces.empty() && m_download->m_info->total_size() == m_download->m_status.total_done)
+		// piece_finished alerts keep the map up to date. The posted status lags
+		// behind them, so the map is only built again when it shows more pieces
+		// than the status (a recheck, lost data) or when the state changes.
+		const int state = m_download->m_status.state;
+		if(int(m_vecPieces.size()) != m_download->m_info->num_pieces()
+			|| widgetCompletition->finishedPieces() > m_download->m_status.num_pieces
+			|| state != m_nLastState)
 		{
-			pieces.resize(m_download->m_info->num_pieces());
-			pieces.set_all();
+			libtorrent::bitfield pieces = m_download->m_status.pieces;
+			
+			if(pieces.empty() && m_download->m_info->total_size() == m_download->m_status.total_done)
+			{
+				pieces.resize(m_download->m_info->num_pieces());
+				pieces.set_all();
+			}
+			
+			if(!pieces.empty())
+			{
+				widgetCompletition->generate(pieces);
+				m_vecPieces = pieces;
+				m_bPiecesChanged = true;
+			}
+			m_nLastState = state;
 		}
 		
-		if(!pieces.empty() && !bitfieldsEqual(m_vecPieces, pieces))
+		if(m_bPiecesChanged && (current == tab_4 || slowTick))
 		{
-			widgetCompletition->generate(pieces);
-			m_vecPieces = pieces;
-			
 			// FILES
 			m_pFilesModel->refresh(&m_vecPieces);
+			m_bPiecesChanged = false;
 		}
 		
 		std::vector<int> avail;
@@ -269,28 +293,35 @@ void TorrentDetails::refresh()
 		lineTotalDownload->setText(formatSize(d));
 		lineTotalUpload->setText(formatSize(u));
 		
+		// DISK CACHE, shared by the whole session
+		if(current == tab || slowTick)
+		{
+			const libtorrent::cache_status cs = TorrentDownload::m_session->get_cache_status();
+			const qint64 limit = TorrentDownload::m_session->settings().cache_size;
+			
+			lineDiskCache->setText(tr("%1 of %2 used, %3% of reads from the cache, %4 queued disk jobs")
+					.arg(formatSize(qint64(cs.cache_size)*16*1024)).arg(formatSize(limit*16*1024))
+					.arg(cs.blocks_read ? 100*cs.blocks_read_hit/cs.blocks_read : 0)
+					.arg(cs.job_queue_length));
+		}
+		
 		// PIECES IN PROGRESS
-		m_pPiecesModel->refresh();
+		if(current == tab_3 || slowTick)
+			m_pPiecesModel->refresh();
 		
 		// CONNECTED PEERS
-		m_pPeersModel->refresh();
+		if(current == tab_2 || slowTick)
+			m_pPeersModel->refresh();
 	}
 }
 
-bool TorrentDetails::bitfieldsEqual(const libtorrent::bitfield& b1, const libtorrent::bitfield& b2)
+void TorrentDetails::pieceFinished(int piece)
 {
-	const char* pb1, *pb2;
-	
-	pb1 = b1.bytes();
-	pb2 = b2.bytes();
+	if(piece < 0 || piece >= int(m_vecPieces.size()) || m_vecPieces[piece])
+		return;
 	
-	if(!pb1 && !pb2)
-		return true;
-	else if((pb1 && !pb2) || (!pb1 && pb2))
-		return false;
-	else if(b1.size() != b2.size())
-		return false;
-	else
-		return memcmp(pb1, pb2, b1.size()/2) == 0;
+	m_vecPieces.set_bit(piece);
+	widgetCompletition->setPieceFinished(piece);
+	m_bPiecesChanged = true;
 }
 
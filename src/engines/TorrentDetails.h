@@ -42,9 +42,9 @@ public:
 	virtual ~TorrentDetails();
 	void fill(); // only constant data
 	void setPriority(int p);
-	static bool bitfieldsEqual(const libtorrent::bitfield& b1, const libtorrent::bitfield& b2);
 public slots:
 	void refresh();
+	void pieceFinished(int piece);
 	void destroy();
 	void fileContext(const QPoint&);
 	void peerContext(const QPoint&);
@@ -58,7 +58,10 @@ public slots:
 	void peerInfo();
 private:
 	TorrentDownload* m_download;
-	bool m_bFilled;
+	bool m_bFilled, m_bPiecesChanged;
+	int m_nTicks;
+	// the torrent state the piece map was last built in
+	int m_nLastState;
 	libtorrent::bitfield m_vecPieces;
 	TorrentPiecesModel* m_pPiecesModel;
 	TorrentPeersModel* m_pPeersModel;
@@ -30,10 +30,15 @@ respects for all of the code used other than "OpenSSL".
 #include "Settings.h"
 #include "Queue.h"
 #include "TorrentDownload.h"
+#include "TorrentAlertThread.h"
+#include "TorrentStream.h"
+#include "TorrentCreator.h"
+#include "TorrentIPFilter.h"
 #include "TorrentSettings.h"
 #include "TorrentDetails.h"
 #include "TorrentOptsWidget.h"
 #include "RuntimeException.h"
+#include "TickService.h"
 #include "rss/RssFetcher.h"
 #include "TorrentProgressWidget.h"
 
@@ -47,6 +52,7 @@ respects for all of the code used other than "OpenSSL".
 
 #include <fstream>
 #include <stdexcept>
+#include <unistd.h>
 #include <memory>
 
 #include <QIcon>
@@ -55,6 +61,7 @@ respects for all of the code used other than "OpenSSL".
 #include <QDir>
 #include <QUrl>
 #include <QFile>
+#include <QFileInfo>
 #include <QVector>
 #include <QLabel>
 #include <QBuffer>
@@ -62,6 +69,11 @@ respects for all of the code used other than "OpenSSL".
 #include <QtDebug>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QWaitCondition>
+#include <QSet>
+#include <QDateTime>
 
 #ifdef WITH_WEBINTERFACE
 #	define XMLRPCSERVICE_AVOID_SHA_CONFLICT
@@ -85,11 +97,27 @@ TorrentWorker* TorrentDownload::m_worker = 0;
 bool TorrentDownload::m_bDHT = false;
 QList<QRegExp> TorrentDownload::m_listBTLinks;
 QLabel* TorrentDownload::m_labelDHTStats = 0;
-QMutex TorrentDownload::m_mutexAlerts;
+TorrentAlertThread* TorrentDownload::m_alertThread = 0;
+TorrentIPFilter* TorrentDownload::m_ipFilter = 0;
 
 const char* TORRENT_FILE_STORAGE = ".local/share/fatrat/torrents";
 const char* MAGNET_PREFIX = "magnet:?xt=urn:btih:";
 
+// minutes after which a paused torrent leaves the session
+static const CachedSetting<int> g_detachAfter("torrent/detach_after");
+static const CachedSetting<int> g_prefetchLimit("torrent/metadata_prefetch");
+// a background metadata retrieval gives way to other magnet links after this many seconds
+static const uint PREFETCH_TIMEOUT = 5*60;
+
+static const CachedSetting<bool> g_cacheAuto("torrent/cache_auto");
+// how often the disk cache is tuned, in seconds
+static const int CACHE_TUNE_INTERVAL = 10;
+// in 16 KiB blocks
+static const int CACHE_MIN_SIZE = 256;
+static const int READ_LINE_MIN = 32, READ_LINE_MAX = 256;
+// disk jobs waiting in the queue that mean the disk can't keep up
+static const int CACHE_QUEUE_HIGH = 32;
+
 void* g_pGeoIP = 0;
 QLibrary g_geoIPLib;
 void* (*GeoIP_new_imp)(int);
@@ -98,18 +126,28 @@ const char* (*GeoIP_country_code_by_addr_imp)(void*, const char*);
 void (*GeoIP_delete_imp)(void*);
 
 TorrentDownload::TorrentDownload(bool bAuto)
-	:  m_info(0), m_bHasHashCheck(false), m_bAuto(bAuto), m_bSuperSeeding(false), m_pFileDownload(0)
-		, m_pFileDownloadTemp(0)
+	:  m_info(0), m_bHasHashCheck(false), m_bAuto(bAuto), m_bSuperSeeding(false), m_bStoredLists(false),
+		m_nInactiveSince(0), m_nDetachRequested(0), m_nPrefetchStarted(0), m_nPrefetchTried(0), m_nLimitDown(0), m_nLimitUp(0), m_pFileDownload(0), m_pFileDownloadTemp(0)
 {
 	m_worker->addObject(this);
 }
 
+static void dropPreloaded(QString path);
+
 TorrentDownload::~TorrentDownload()
 {
 	m_worker->removeObject(this);
 	if(m_handle.is_valid())
 		m_session->remove_torrent(m_handle);
 	//delete m_info;
+	
+	// removed before it has ever needed the metadata
+	if(!m_info && !m_strTorrentFile.isEmpty())
+	{
+		QDir dir = QDir::home();
+		dir.cd(TORRENT_FILE_STORAGE);
+		dropPreloaded(dir.absoluteFilePath(m_strTorrentFile));
+	}
 }
 
 int TorrentDownload::acceptable(QString uri, bool)
@@ -177,7 +215,8 @@ void TorrentDownload::globalInit()
 		lend = lstart;
 	
 	m_session = new libtorrent::session(fp, std::pair<int,int>(lstart,lend));
-	m_session->set_alert_mask(libtorrent::alert::all_categories);
+	// per-torrent stats are never used and would flood the queue every second
+	m_session->set_alert_mask(libtorrent::alert::all_categories & ~libtorrent::alert::stats_notification);
 	
 	if(programHasGUI())
 		m_labelDHTStats = new QLabel;
@@ -194,6 +233,10 @@ void TorrentDownload::globalInit()
 	
 	m_worker = new TorrentWorker;
 	
+	m_alertThread = new TorrentAlertThread(m_session);
+	QObject::connect(m_alertThread, SIGNAL(eventsPending()), m_worker, SLOT(processEvents()), Qt::QueuedConnection);
+	m_alertThread->start();
+	
 	g_geoIPLib.setFileName("libGeoIP");
 	if(g_geoIPLib.load())
 	{
@@ -228,6 +271,7 @@ void TorrentDownload::globalInit()
 	// register XML-RPC functions
 	XmlRpcService::registerFunction("TorrentDownload.setFilePriorities", setFilePriorities,
 					QVector<QVariant::Type>() << QVariant::String << QVariant::Map);
+	TorrentCreator::globalInit();
 
 	si.webSettingsScript = "/scripts/settings/bittorrent.js";
 	si.webSettingsIconURL = "/img/settings/bittorrent.png";
@@ -349,7 +393,15 @@ void TorrentDownload::applySettings()
 	settings.max_failcount = 7;
 	settings.request_queue_time = 30.f;
 	settings.max_out_request_queue = 100;
-	settings.cache_size = getSettingsValue("torrent/cache_size").toInt();
+	if(g_cacheAuto)
+	{
+		// keep what the tuner has arrived at so far
+		const libtorrent::session_settings current = m_session->settings();
+		settings.cache_size = qBound(CACHE_MIN_SIZE, current.cache_size, diskCacheBudget());
+		settings.read_cache_line_size = qBound(READ_LINE_MIN, current.read_cache_line_size, READ_LINE_MAX);
+	}
+	else
+		settings.cache_size = getSettingsValue("torrent/cache_size").toInt();
 	settings.disk_io_write_mode = getSettingsValue("torrent/disk_io_write_mode").toInt();
 	settings.disk_io_read_mode = getSettingsValue("torrent/disk_io_read_mode").toInt();
 
@@ -393,6 +445,33 @@ void TorrentDownload::applySettings()
 	ps.prefer_rc4 = getSettingsValue("torrent/enc_rc4_prefer").toBool();
 	m_session->set_pe_settings(ps);
 	
+	// IP filter, reloaded only when the blocklist or its contents change
+	static QString strIPFilterActive;
+	QString ipfilter;
+	
+	if(getSettingsValue("torrent/ipfilter_enable").toBool())
+	{
+		QFileInfo info(getSettingsValue("torrent/ipfilter").toString());
+		if(info.exists())
+			ipfilter = info.absoluteFilePath() + '@' + QString::number(info.lastModified().toMSecsSinceEpoch());
+	}
+	if(ipfilter != strIPFilterActive)
+	{
+		// the GUI thread mustn't wait for a previous load
+		if(m_ipFilter)
+			TorrentIPFilter::detach(m_ipFilter);
+		m_ipFilter = 0;
+		
+		if(!ipfilter.isEmpty())
+		{
+			m_ipFilter = new TorrentIPFilter(m_session, getSettingsValue("torrent/ipfilter").toString());
+			m_ipFilter->start(QThread::LowPriority);
+		}
+		else
+			m_session->set_ip_filter(libtorrent::ip_filter());
+		strIPFilterActive = ipfilter;
+	}
+	
 	// Proxy settings
 	QUuid proxy;
 	libtorrent::proxy_settings ltproxy;
@@ -456,6 +535,13 @@ void TorrentDownload::globalExit()
 	s.tracker_completion_timeout = s.tracker_receive_timeout = 5;
 	m_session->set_settings(s);
 
+	m_alertThread->stop();
+	delete m_alertThread;
+	if(m_ipFilter)
+		TorrentIPFilter::detach(m_ipFilter);
+	m_ipFilter = 0;
+	TorrentIPFilter::waitForDetached();
+	
 	m_session->abort();
 
 	delete m_worker;
@@ -465,6 +551,74 @@ void TorrentDownload::globalExit()
 		GeoIP_delete_imp(g_pGeoIP);
 }
 
+// torrent files being parsed ahead of TorrentDownload::load()
+static QMutex m_mutexPreload;
+static QWaitCondition m_condPreload;
+static QSet<QString> m_preloading;
+static QMap<QString, boost::intrusive_ptr<libtorrent::torrent_info> > m_preloaded;
+
+class TorrentPreloader : public QRunnable
+{
+public:
+	TorrentPreloader(QString file) : m_strFile(file) {}
+	virtual void run()
+	{
+		boost::intrusive_ptr<libtorrent::torrent_info> ti;
+		
+		try
+		{
+			ti = new libtorrent::torrent_info(m_strFile.toStdString());
+		}
+		catch(...)
+		{
+			// load() will parse the file again and report the error
+		}
+		
+		QMutexLocker l(&m_mutexPreload);
+		// nobody wants the file anymore if it's been dropped meanwhile
+		if(m_preloading.remove(m_strFile) && ti)
+			m_preloaded[m_strFile] = ti;
+		m_condPreload.wakeAll();
+	}
+private:
+	QString m_strFile;
+};
+
+void TorrentDownload::preloadTorrentFiles(QStringList files)
+{
+	QDir dir = QDir::home();
+	dir.cd(TORRENT_FILE_STORAGE);
+	
+	QMutexLocker l(&m_mutexPreload);
+	foreach(QString file, files)
+	{
+		QString path = dir.absoluteFilePath(file);
+		if(m_preloading.contains(path) || m_preloaded.contains(path))
+			continue;
+		
+		m_preloading << path;
+		QThreadPool::globalInstance()->start(new TorrentPreloader(path));
+	}
+}
+
+static boost::intrusive_ptr<libtorrent::torrent_info> takePreloaded(QString path)
+{
+	QMutexLocker l(&m_mutexPreload);
+	
+	while(m_preloading.contains(path))
+		m_condPreload.wait(&m_mutexPreload);
+	return m_preloaded.take(path);
+}
+
+static void dropPreloaded(QString path)
+{
+	QMutexLocker l(&m_mutexPreload);
+	
+	m_preloading.remove(path);
+	m_preloaded.remove(path);
+	m_condPreload.wakeAll();
+}
+
 QString TorrentDownload::name() const
 {
 	if(m_handle.is_valid())
@@ -480,13 +634,17 @@ QString TorrentDownload::name() const
 	}
 	else if(m_pFileDownload != 0)
 		return tr("Downloading the .torrent file...");
+	else if(!m_strName.isEmpty())
+		return m_strName;
+	else if(m_info)
+		return QString::fromUtf8(m_info->name().c_str());
 	else
 		return "*INVALID*";
 }
 
 QString TorrentDownload::dataPath(bool bDirect) const
 {
-	if (!m_handle.is_valid())
+	if (!m_handle.is_valid() && !isDormant())
 		return QString();
 	else
 		return Transfer::dataPath(bDirect);
@@ -547,28 +705,11 @@ void TorrentDownload::init(QString source, QString target)
 					params.flags |= libtorrent::add_torrent_params::flag_paused;
 				
 				m_handle = m_session->add_torrent(params);
+				m_nLimitDown = m_nLimitUp = 0;
 				//m_handle = m_session->add_torrent(m_info, target.toStdString(), libtorrent::entry(), storageMode, !isActive());
 			}
 			else
-			{
-				libtorrent::add_torrent_params params;
-				QByteArray path = source.toUtf8();
-				std::string ss = path.constData();
-
-				params.name = ss.c_str();
-				path = target.toUtf8();
-				params.save_path = path.constData();
-				params.storage_mode = storageMode;
-				params.paused = !isActive();
-				params.auto_managed = false;
-				params.url = ss;
-				params.flags = libtorrent::add_torrent_params::flag_duplicate_is_error;
-
-				if (!isActive())
-					params.flags |= libtorrent::add_torrent_params::flag_paused;
-
-				m_handle = m_session->add_torrent(params);
-			}
+				addMagnet(source);
 			
 			
 			{
@@ -586,8 +727,9 @@ void TorrentDownload::init(QString source, QString target)
 				m_bHasHashCheck = true;
 				
 				createDefaultPriorityList();
-				m_worker->doWork();
+				m_status = m_handle.status();
 				storeTorrent(source);
+				m_strTorrentFile = storedTorrentName();
 				
 				if(!m_bAuto)
 					RssFetcher::performManualCheck(name());
@@ -608,6 +750,28 @@ void TorrentDownload::init(QString source, QString target)
 	}
 }
 
+void TorrentDownload::addMagnet(QString uri)
+{
+	libtorrent::add_torrent_params params;
+	QByteArray path = uri.toUtf8();
+	std::string ss = path.constData();
+
+	params.name = ss.c_str();
+	path = m_strTarget.toUtf8();
+	params.save_path = path.constData();
+	params.storage_mode = (libtorrent::storage_mode_t) getSettingsValue("torrent/allocation").toInt();
+	params.paused = !isActive();
+	params.auto_managed = false;
+	params.url = ss;
+	params.flags = libtorrent::add_torrent_params::flag_duplicate_is_error;
+
+	if (!isActive())
+		params.flags |= libtorrent::add_torrent_params::flag_paused;
+
+	m_handle = m_session->add_torrent(params);
+	m_nLimitDown = m_nLimitUp = 0;
+}
+
 void TorrentDownload::downloadTorrent(QString source)
 {
 	qDebug() << "downloadTorrent()";
@@ -744,7 +908,7 @@ void TorrentDownload::torrentFileDone(QNetworkReply* reply)
 				init(m_pFileDownloadTemp->fileName(), m_strTarget);
 
 				foreach (const QString& url, m_urlSeeds)
-					m_handle.add_http_seed(url.toStdString());
+					m_handle.add_url_seed(url.toUtf8().constData());
 				m_urlSeeds.clear();
 			}
 			catch(const RuntimeException& e)
@@ -763,6 +927,9 @@ void TorrentDownload::torrentFileDone(QNetworkReply* reply)
 
 void TorrentDownload::setObject(QString target)
 {
+	if(isDormant() && target != m_strTarget)
+		attachToSession();
+	
 	if(m_handle.is_valid() && target != m_strTarget)
 	{
 		QByteArray path = target.toUtf8();
@@ -788,10 +955,20 @@ void TorrentDownload::changeActive(bool nowActive)
 {
 //	bool bEnableRecheck = false;
 	
-	if(m_handle.is_valid())
+	if(nowActive && isDormant())
+	{
+		// attachToSession() resumes the torrent itself
+		if(attachToSession())
+			QTimer::singleShot(10000, this, SLOT(forceReannounce()));
+		else
+			setState(Failed);
+	}
+	else if(m_handle.is_valid())
 	{
 		if(nowActive)
 		{
+			stopPrefetch();
+			m_nInactiveSince = 0;
 			m_handle.resume();
 			QTimer::singleShot(10000, this, SLOT(forceReannounce()));
 		}
@@ -800,6 +977,7 @@ void TorrentDownload::changeActive(bool nowActive)
 			//m_nPrevDownload = totalDownload();
 			//m_nPrevUpload = totalUpload();
 //			bEnableRecheck = true;
+			m_nInactiveSince = QDateTime::currentDateTime().toTime_t();
 			m_handle.pause();
 		}
 	}
@@ -821,12 +999,14 @@ void TorrentDownload::setSpeedLimits(int down, int up)
 		
 		m_handle.set_upload_limit(up);
 		m_handle.set_download_limit(down);
+		m_nLimitDown = down;
+		m_nLimitUp = up;
 	}
 }
 
 qulonglong TorrentDownload::done() const
 {
-	if(m_handle.is_valid())
+	if(m_handle.is_valid() || isDormant())
 		return qMax<qint64>(0, m_status.total_wanted_done);
 	else
 		return 0;
@@ -834,7 +1014,7 @@ qulonglong TorrentDownload::done() const
 
 qulonglong TorrentDownload::total() const
 {
-	if(m_handle.is_valid())
+	if(m_handle.is_valid() || isDormant())
 		return m_status.total_wanted;
 	else
 		return 0;
@@ -844,9 +1024,8 @@ void TorrentDownload::speeds(int& down, int& up) const
 {
 	if(m_handle.is_valid())
 	{
-		libtorrent::torrent_status status = m_handle.status();
-		down = status.download_payload_rate;
-		up = status.upload_payload_rate;
+		down = m_status.download_payload_rate;
+		up = m_status.upload_payload_rate;
 	}
 	else
 		down = up = 0;
@@ -898,7 +1077,6 @@ void TorrentDownload::load(const QDomNode& map)
 	
 	try
 	{
-		QByteArray torrent_resume;
 		QString str;
 		QDir dir = QDir::home();
 	
@@ -915,97 +1093,167 @@ void TorrentDownload::load(const QDomNode& map)
 
 		m_bSuperSeeding = getXMLProperty(map, "superseeding").toInt() != 0;
 		
-		m_strTarget = str = getXMLProperty(map, "target");
+		m_strTarget = getXMLProperty(map, "target");
+		m_strTorrentFile = getXMLProperty(map, "torrent_file");
 		
-		QString sfile = dir.absoluteFilePath( getXMLProperty(map, "torrent_file") );
+		str = getXMLProperty(map, "magnet");
+		if(m_strTorrentFile.isEmpty() && !str.isEmpty())
+		{
+			// saved before the metadata could be retrieved
+			addMagnet(str);
+			return;
+		}
+		
+		QString sfile = dir.absoluteFilePath(m_strTorrentFile);
 		
 		if(!QFile(sfile).open(QIODevice::ReadOnly))
 		{
+			m_strTorrentFile.clear();
 			m_strError = tr("Unable to open the file!");
 			setState(Failed);
 			return;
 		}
 		
-		libtorrent::torrent_info* ti;
+		m_resumeData = QByteArray::fromBase64(getXMLProperty(map, "torrent_resume").toUtf8());
 		
-		ti = new libtorrent::torrent_info(sfile.toStdString());
-		m_info.reset(ti);
+		std::cout << "Loaded " << m_resumeData.size() << " bytes of resume data\n";
 		
-		torrent_resume = QByteArray::fromBase64(getXMLProperty(map, "torrent_resume").toUtf8());
-		
-		std::cout << "Loaded " << getXMLProperty(map, "torrent_resume").size() << " bytes of resume data\n";
-		
-		libtorrent::add_torrent_params params;
-		std::vector<char> torrent_resume2 = std::vector<char>(torrent_resume.data(), torrent_resume.data()+torrent_resume.size());
-		
-		//params.storage_mode = (libtorrent::storage_mode_t) getSettingsValue("torrent/allocation").toInt();
-		params.storage_mode = libtorrent::storage_mode_sparse; // don't force full allocation upon load
-		params.ti = ti;
-		
-		QByteArray path = str.toUtf8();
-		params.save_path = path.constData();
-		if(!torrent_resume2.empty())
-			params.resume_data = torrent_resume2;
-		params.paused = true;
-		params.auto_managed = false;
-		
-		m_handle = m_session->add_torrent(params);
-		
-		m_handle.set_max_uploads(getSettingsValue("torrent/maxuploads").toInt());
-		m_handle.set_max_connections(getSettingsValue("torrent/maxconnections").toInt());
+		// what is displayed until the torrent enters the session
+		m_strName = getXMLProperty(map, "name");
+		m_status.paused = true;
+		m_status.total_wanted = getXMLProperty(map, "total_wanted").toLongLong();
+		m_status.total_wanted_done = getXMLProperty(map, "total_wanted_done").toLongLong();
+		m_status.all_time_download = getXMLProperty(map, "downloaded").toLongLong();
+		m_status.all_time_upload = getXMLProperty(map, "uploaded").toLongLong();
 		
 		//m_nPrevDownload = getXMLProperty(map, "downloaded").toLongLong();
 		//m_nPrevUpload = getXMLProperty(map, "uploaded").toLongLong();
 		
+		// checked against the file count in ensureMetadata()
 		str = getXMLProperty(map, "priorities");
-		
-		if(str.isEmpty())
-			createDefaultPriorityList();
-		else
+		if(!str.isEmpty())
 		{
 			QStringList priorities = str.split('|');
-			int numFiles = m_info->num_files();
-			
-			if(numFiles != priorities.size())
-				createDefaultPriorityList();
-			else
-			{
-				m_vecPriorities.resize(numFiles);
-				
-				for(int i=0;i<numFiles;i++)
-					m_vecPriorities[i] = priorities[i].toInt();
-			}
 			
-			m_handle.prioritize_files(m_vecPriorities);
+			m_vecPriorities.resize(priorities.size());
+			for(int i=0;i<priorities.size();i++)
+				m_vecPriorities[i] = priorities[i].toInt();
 		}
 		
-		std::vector<libtorrent::announce_entry> trackers;
 		QDomElement n = map.firstChildElement("trackers");
 		if(!n.isNull())
 		{
 			QDomElement tracker = n.firstChildElement("tracker");
 			while(!tracker.isNull())
 			{
-				QByteArray url = tracker.firstChild().toText().data().toUtf8();
-				trackers.push_back(libtorrent::announce_entry(url.data()));
+				m_listTrackers << tracker.firstChild().toText().data();
 				tracker = tracker.nextSiblingElement("tracker");
 			}
-			m_handle.replace_trackers(trackers);
+			m_bStoredLists = true;
 		}
 		
-		std::set<std::string> cur_seeds = m_handle.url_seeds();
-		std::set<std::string> now_seeds;
-		
 		n = map.firstChildElement("url_seeds");
 		if(!n.isNull())
 		{
 			QDomElement seed = n.firstChildElement("url");
 			while(!seed.isNull())
 			{
-				QByteArray url = seed.firstChild().toText().data().toUtf8();
-				now_seeds.insert(url.constData());
+				m_listUrlSeeds << seed.firstChild().toText().data();
 				seed = seed.nextSiblingElement("url");
 			}
+			m_bStoredLists = true;
+		}
+		
+		// transfers saved by older versions don't have the cached state,
+		// they get it from the session before they're detached
+		if(isActive() || m_strName.isEmpty())
+		{
+			if(!attachToSession())
+				setState(Failed);
+		}
+	}
+	catch(const std::exception& e)
+	{
+		m_strError = e.what();
+		setState(Failed);
+	}
+}
+
+bool TorrentDownload::ensureMetadata()
+{
+	if(m_info)
+		return true;
+	if(m_strTorrentFile.isEmpty())
+		return false;
+	
+	QDir dir = QDir::home();
+	dir.cd(TORRENT_FILE_STORAGE);
+	
+	QString sfile = dir.absoluteFilePath(m_strTorrentFile);
+	
+	try
+	{
+		boost::intrusive_ptr<libtorrent::torrent_info> ti = takePreloaded(sfile);
+		
+		if(!ti)
+			ti = new libtorrent::torrent_info(sfile.toStdString());
+		m_info = ti;
+	}
+	catch(const std::exception& e)
+	{
+		m_strError = e.what();
+		return false;
+	}
+	
+	if(m_vecPriorities.size() != size_t(m_info->num_files()))
+		createDefaultPriorityList();
+	
+	return true;
+}
+
+bool TorrentDownload::attachToSession()
+{
+	if(m_handle.is_valid())
+		return true;
+	if(!ensureMetadata())
+		return false;
+	
+	try
+	{
+		libtorrent::add_torrent_params params;
+		std::vector<char> torrent_resume = std::vector<char>(m_resumeData.constData(), m_resumeData.constData()+m_resumeData.size());
+		
+		//params.storage_mode = (libtorrent::storage_mode_t) getSettingsValue("torrent/allocation").toInt();
+		params.storage_mode = libtorrent::storage_mode_sparse; // don't force full allocation upon load
+		params.ti = boost::const_pointer_cast<libtorrent::torrent_info>(m_info);
+		
+		QByteArray path = m_strTarget.toUtf8();
+		params.save_path = path.constData();
+		if(!torrent_resume.empty())
+			params.resume_data = torrent_resume;
+		params.paused = true;
+		params.auto_managed = false;
+		
+		m_handle = m_session->add_torrent(params);
+		m_nLimitDown = m_nLimitUp = 0;
+		
+		m_handle.set_max_uploads(getSettingsValue("torrent/maxuploads").toInt());
+		m_handle.set_max_connections(getSettingsValue("torrent/maxconnections").toInt());
+		m_handle.prioritize_files(m_vecPriorities);
+		
+		if(m_bStoredLists)
+		{
+			std::vector<libtorrent::announce_entry> trackers;
+			foreach(QString url, m_listTrackers)
+				trackers.push_back(libtorrent::announce_entry(url.toUtf8().constData()));
+			if(!trackers.empty())
+				m_handle.replace_trackers(trackers);
+			
+			std::set<std::string> cur_seeds = m_handle.url_seeds();
+			std::set<std::string> now_seeds;
+			
+			foreach(QString url, m_listUrlSeeds)
+				now_seeds.insert(url.toUtf8().constData());
 			
 			std::set<std::string> diff;
 			
@@ -1021,21 +1269,105 @@ void TorrentDownload::load(const QDomNode& map)
 		}
 		
 		if(isActive())
+		{
+			m_nInactiveSince = 0;
 			m_handle.resume();
+		}
+		else
+			m_nInactiveSince = QDateTime::currentDateTime().toTime_t();
 		
-		m_worker->doWork();
+		m_status = m_handle.status();
 	}
 	catch(const std::exception& e)
 	{
+		m_handle = libtorrent::torrent_handle();
 		m_strError = e.what();
-		setState(Failed);
+		return false;
 	}
+	
+	return true;
+}
+
+void TorrentDownload::detachFromSession()
+{
+	if(!m_handle.is_valid() || m_strTorrentFile.isEmpty())
+		return;
+	
+	m_nDetachRequested = QDateTime::currentDateTime().toTime_t();
+	
+	if(m_status.state == libtorrent::torrent_status::downloading_metadata)
+		finishDetach(QByteArray());
+	else
+	{
+		// the alert arrives as an event, waiting for it here would block the GUI
+		m_handle.save_resume_data();
+	}
+}
+
+void TorrentDownload::finishDetach(const QByteArray& resume)
+{
+	if(!m_nDetachRequested)
+		return;
+	m_nDetachRequested = 0;
+	
+	// the torrent may have been started in the meantime
+	if(!m_handle.is_valid() || !m_nInactiveSince || isActive() || isPrefetching())
+		return;
+	
+	if(!resume.isEmpty())
+		m_resumeData = resume;
+	
+	m_strName = name();
+	m_status.paused = true;
+	m_status.download_payload_rate = m_status.upload_payload_rate = 0;
+	
+	m_listTrackers.clear();
+	std::vector<libtorrent::announce_entry> trackers = m_handle.trackers();
+	for(size_t i=0;i<trackers.size();i++)
+		m_listTrackers << QString::fromUtf8(trackers[i].url.c_str());
+	
+	m_listUrlSeeds.clear();
+	std::set<std::string> seeds = m_handle.url_seeds();
+	for(std::set<std::string>::iterator it=seeds.begin(); it != seeds.end(); it++)
+		m_listUrlSeeds << QString::fromUtf8(it->c_str());
+	m_bStoredLists = true;
+	
+	m_session->remove_torrent(m_handle);
+	m_handle = libtorrent::torrent_handle();
+	m_nInactiveSince = 0;
+	
+	enterLogMessage(tr("The torrent has been removed from the session while inactive"));
+}
+
+QByteArray TorrentDownload::fetchResumeData() const
+{
+	QByteArray data;
+	
+	if(!m_handle.is_valid() || m_status.state == libtorrent::torrent_status::downloading_metadata)
+		return data;
+	
+	// the alert thread picks up the result
+	libtorrent::sha1_hash hash = m_handle.info_hash();
+	m_alertThread->expectResumeData(hash);
+	m_handle.save_resume_data();
+	
+	if(!m_alertThread->waitForResumeData(hash, data, 3000))
+		std::cout << "Torrent state did not get saved!\n";
+	
+	return data;
 }
 
 void TorrentDownload::addUrlSeed(QString str)
 {
-	if (!m_handle.is_valid())
-		m_handle.add_url_seed(str.toStdString());
+	// BEP 19 web seeds; libtorrent requests piece-aligned ranges from them
+	// and verifies the data against the piece hashes like any peer's
+	if (m_handle.is_valid())
+		m_handle.add_url_seed(str.toUtf8().constData());
+	else if (isDormant())
+	{
+		m_listUrlSeeds << str;
+		m_bStoredLists = true;
+	}
 	else
 		m_urlSeeds << str;
 }
@@ -1044,49 +1376,23 @@ void TorrentDownload::save(QDomDocument& doc, QDomNode& map) const
 {
 	Transfer::save(doc, map);
 	
-	if(m_info != 0)
+	if(m_info != 0 || !m_strTorrentFile.isEmpty())
 	{
-		setXMLProperty(doc, map, "torrent_file", storedTorrentName());
+		setXMLProperty(doc, map, "torrent_file", m_strTorrentFile.isEmpty() ? storedTorrentName() : m_strTorrentFile);
 		
-		if(m_handle.is_valid() && m_status.state != libtorrent::torrent_status::downloading_metadata)
-		{
-			m_mutexAlerts.lock();
-			m_handle.save_resume_data();
-			
-			int i;
-			for(i = 0; i < 3;)
-			{
-				libtorrent::alert* aaa;
-				std::unique_ptr<libtorrent::alert> a = TorrentDownload::m_session->pop_alert();
-	
-				if((aaa = a.get()) == 0)
-				{
-					Sleeper::msleep(250);
-					i++;
-					continue;
-				}
-				
-				if(libtorrent::save_resume_data_alert* alert = dynamic_cast<libtorrent::save_resume_data_alert*>(aaa))
-				{
-					setXMLProperty(doc, map, "torrent_resume", bencode(*alert->resume_data));
-					break;
-				}
-				else if(dynamic_cast<libtorrent::save_resume_data_failed_alert*>(aaa))
-				{
-					std::cout << "Save data failed\n";
-					break;
-				}
-				else
-					m_worker->processAlert(aaa);
-			}
-			m_mutexAlerts.unlock();
-
-			if (i == 3)
-				std::cout << "Torrent state did not get saved!\n";
-		}
+		QByteArray resume = m_handle.is_valid() ? fetchResumeData() : QByteArray();
+		if(resume.isEmpty())
+			resume = m_resumeData;
+		if(!resume.isEmpty())
+			setXMLProperty(doc, map, "torrent_resume", resume.toBase64());
 	}
+	else if(m_handle.is_valid())
+		setXMLProperty(doc, map, "magnet", remoteURI());
 	
 	setXMLProperty(doc, map, "target", object());
+	setXMLProperty(doc, map, "name", (m_handle.is_valid() || isDormant()) ? name() : QString());
+	setXMLProperty(doc, map, "total_wanted", QString::number(total()));
+	setXMLProperty(doc, map, "total_wanted_done", QString::number(done()));
 	setXMLProperty(doc, map, "downloaded", QString::number( totalDownload() ));
 	setXMLProperty(doc, map, "uploaded", QString::number( totalUpload() ));
 	
@@ -1112,6 +1418,7 @@ void TorrentDownload::save(QDomDocument& doc, QDomNode& map) const
 		{
 			setXMLProperty(doc, sub, "tracker", QString::fromUtf8(trackers[i].url.c_str()));
 		}
+		map.appendChild(sub);
 		
 		sub = doc.createElement("url_seeds");
 		std::set<std::string> seeds = m_handle.url_seeds();
@@ -1119,6 +1426,19 @@ void TorrentDownload::save(QDomDocument& doc, QDomNode& map) const
 		{
 			setXMLProperty(doc, sub, "url", QString::fromUtf8(it->c_str()));
 		}
+		map.appendChild(sub);
+	}
+	else if(m_bStoredLists)
+	{
+		QDomElement sub = doc.createElement("trackers");
+		foreach(QString url, m_listTrackers)
+			setXMLProperty(doc, sub, "tracker", url);
+		map.appendChild(sub);
+		
+		sub = doc.createElement("url_seeds");
+		foreach(QString url, m_listUrlSeeds)
+			setXMLProperty(doc, sub, "url", url);
+		map.appendChild(sub);
 	}
 }
 
@@ -1202,7 +1522,25 @@ void TorrentDownload::process(QString method, QMap<QString,QString> args, WriteB
 {
 	qDebug() << "TorrentDownload::process" << method;
 
-	if (m_handle.is_valid() && m_info)
+	if (isDormant() && ensureMetadata())
+	{
+		// the piece map isn't known outside the session
+		if (method == "progress" || method == "availability")
+		{
+			QImage img(800, 1, QImage::Format_RGB32);
+			QBuffer bbuf;
+
+			img.fill((method == "progress" && m_status.total_wanted_done == m_status.total_wanted) ? 0xff0000ff : 0xffffffff);
+			img.save(&bbuf, "PNG");
+			wb->setContentType("image/png");
+
+			wb->write(bbuf.buffer().data(), bbuf.size());
+			wb->send();
+		}
+		else
+			wb->writeFail("Unknown request");
+	}
+	else if (m_handle.is_valid() && m_info)
 	{
 		const int WIDTH = 800;
 		if (method == "progress")
@@ -1249,6 +1587,21 @@ void TorrentDownload::process(QString method, QMap<QString,QString> args, WriteB
 	}
 }
 
+TransferHttpService::Stream* TorrentDownload::openStream(int file, QString& error)
+{
+	if (!m_info || file < 0 || file >= m_info->num_files())
+		return 0;
+	
+	// nothing would be downloaded, the reads would only time out
+	if (!m_handle.is_valid())
+		error = tr("The torrent is not in the session, start it first");
+	else if (!isActive() || m_status.paused)
+		error = tr("The torrent is paused");
+	else
+		return new TorrentStream(m_handle, m_info, file);
+	return 0;
+}
+
 const char* TorrentDownload::detailsScript() const
 {
 	return "/scripts/transfers/TorrentDownload.js";
@@ -1258,7 +1611,7 @@ QVariantMap TorrentDownload::properties() const
 {
 	QVariantMap rv;
 	
-	if (!m_info)
+	if (!const_cast<TorrentDownload*>(this)->ensureMetadata())
 		return rv;
 	
 	qint64 d, u;
@@ -1285,7 +1638,15 @@ QVariantMap TorrentDownload::properties() const
 	QVariantList files;
 	std::vector<libtorrent::size_type> progresses;
 
-	m_handle.file_progress(progresses);
+	if (m_handle.is_valid())
+		m_handle.file_progress(progresses);
+	else
+	{
+		// only complete dormant torrents have a known per-file progress
+		const bool complete = m_status.total_wanted_done == m_status.total_wanted;
+		for (int i = 0; i < m_info->num_files(); i++)
+			progresses.push_back((complete && m_vecPriorities[i]) ? m_info->file_at(i).size : 0);
+	}
 
 	// num_files(), file_at()
 	for (int i = 0; i < m_info->num_files(); i++)
@@ -1308,9 +1669,9 @@ QVariantMap TorrentDownload::properties() const
 #endif
 
 TorrentWorker::TorrentWorker()
+	: m_nCacheTicks(0), m_nCacheReads(0), m_nCacheHits(0)
 {
-	m_timer.start(1000);
-	connect(&m_timer, SIGNAL(timeout()), this, SLOT(doWork()));
+	connect(TickService::instance(), SIGNAL(secondTick()), this, SLOT(doWork()));
 }
 
 void TorrentWorker::addObject(TorrentDownload* d)
@@ -1323,91 +1684,150 @@ void TorrentWorker::removeObject(TorrentDownload* d)
 {
 	QMutexLocker l(&m_mutex);
 	m_objects.removeAll(d);
+	
+	for(QHash<QByteArray, TorrentDownload*>::iterator it = m_byHash.begin(); it != m_byHash.end();)
+	{
+		if(it.value() == d)
+			it = m_byHash.erase(it);
+		else
+			it++;
+	}
+}
+
+QByteArray TorrentWorker::hashKey(const libtorrent::sha1_hash& hash)
+{
+	return QByteArray((const char*) hash.begin(), libtorrent::sha1_hash::size);
 }
 
 TorrentDownload* TorrentWorker::getByHandle(libtorrent::torrent_handle handle) const
 {
+	if(!handle.is_valid())
+		return 0;
+	return getByHash(handle.info_hash(), handle);
+}
+
+TorrentDownload* TorrentWorker::getByHash(const libtorrent::sha1_hash& hash, const libtorrent::torrent_handle& handle) const
+{
+	QByteArray key = hashKey(hash);
+	TorrentDownload* d = m_byHash.value(key);
+	
+	if(d && d->m_handle == handle)
+		return d;
+	
+	// not seen yet or the torrent has been added to the session again
 	foreach(TorrentDownload* d, m_objects)
 	{
 		if(d->m_handle == handle)
+		{
+			m_byHash[key] = d;
 			return d;
+		}
 	}
 	return 0;
 }
 
-void TorrentWorker::processAlert(libtorrent::alert* aaa)
+void TorrentWorker::processStatus(const std::vector<libtorrent::torrent_status>& status)
 {
-#define IS_ALERT(type) libtorrent::type* alert = dynamic_cast<libtorrent::type*>(aaa)
-#define IS_ALERT_S(type) dynamic_cast<libtorrent::type*>(aaa) != 0
-
-	if(IS_ALERT(torrent_alert))
+	for(size_t i = 0; i < status.size(); i++)
 	{
-		TorrentDownload* d = getByHandle(alert->handle);
-		std::string smsg = aaa->message();
-		QString errmsg = QString::fromUtf8(smsg.c_str());
-			
+		const libtorrent::torrent_status& st = status[i];
+		TorrentDownload* d = getByHash(st.info_hash, st.handle);
+		
 		if(!d)
-			return;
-			
-		if(IS_ALERT_S(file_error_alert))
-		{
+			continue;
+		
+		d->m_status = st;
+		
+		if(!d->m_info && st.has_metadata)
+			d->m_info = d->m_handle.torrent_file();
+	}
+}
+
+void TorrentWorker::processEvents()
+{
+	QMutexLocker l(&m_mutex);
+	TorrentEvent* ev = TorrentDownload::m_alertThread->takeEvents();
+	
+	while(ev)
+	{
+		TorrentEvent* next = ev->next;
+		processEvent(ev);
+		delete ev;
+		ev = next;
+	}
+}
+
+void TorrentWorker::processEvent(TorrentEvent* ev)
+{
+	if(ev->type == libtorrent::state_update_alert::alert_type)
+	{
+		processStatus(ev->status);
+		return;
+	}
+	
+	TorrentDownload* d = getByHandle(ev->handle);
+	const QString& errmsg = ev->message;
+	
+	if(!d)
+		return;
+	
+	switch(ev->type)
+	{
+		case libtorrent::file_error_alert::alert_type:
 			d->setState(Transfer::Failed);
 			d->m_strError = errmsg;
 			d->enterLogMessage(tr("File error: %1").arg(errmsg));
-		}
-		else if(IS_ALERT_S(tracker_announce_alert))
-		{
+			break;
+		case libtorrent::piece_finished_alert::alert_type:
+			emit d->pieceFinished(ev->value);
+			break;
+		case libtorrent::tracker_announce_alert::alert_type:
 			d->enterLogMessage(tr("Tracker announce: %1").arg(errmsg));
-		}
-		else if(IS_ALERT(tracker_error_alert))
+			break;
+		case libtorrent::tracker_error_alert::alert_type:
 		{
 			QString desc = tr("Tracker failure: %1, %2 times in a row ")
 					.arg(errmsg)
-					.arg(alert->times_in_row);
-				
-			if(alert->status_code != 0)
-				desc += tr("(error %1)").arg(alert->status_code);
+					.arg(ev->value);
+			
+			if(ev->value2 != 0)
+				desc += tr("(error %1)").arg(ev->value2);
 			else
 				desc += tr("(timeout)");
 			d->enterLogMessage(desc);
+			break;
 		}
-		else if(IS_ALERT_S(tracker_warning_alert))
-		{
+		case libtorrent::tracker_warning_alert::alert_type:
 			d->enterLogMessage(tr("Tracker warning: %1").arg(errmsg));
-		}
-		else if(IS_ALERT_S(fastresume_rejected_alert))
-		{
+			break;
+		case libtorrent::fastresume_rejected_alert::alert_type:
 			d->enterLogMessage(tr("The fast-resume data have been rejected: %1").arg(errmsg));
-		}
-		else if(IS_ALERT_S(metadata_failed_alert))
-		{
+			break;
+		case libtorrent::metadata_failed_alert::alert_type:
 			d->enterLogMessage(tr("Failed to retrieve the metadata"));
-		}
-		else if(IS_ALERT_S(metadata_received_alert))
-		{
+			break;
+		case libtorrent::save_resume_data_alert::alert_type:
+		case libtorrent::save_resume_data_failed_alert::alert_type:
+			d->finishDetach(ev->data);
+			break;
+		case libtorrent::metadata_received_alert::alert_type:
 			d->enterLogMessage(tr("Successfully retrieved the metadata"));
-			d->storeTorrent();
 
 			if (!d->m_info)
 				d->m_info = d->m_handle.torrent_file();
 
+			if (d->storeTorrent())
+				d->m_strTorrentFile = d->storedTorrentName();
 			d->createDefaultPriorityList();
-		}
-	}
-	else
-	{
-#ifdef LIBTORRENT_0_15
-		if (!IS_ALERT_S(dht_announce_alert) && !IS_ALERT_S(dht_get_peers_alert))
-		{
-			Logger::global()->enterLogMessage("BitTorrent", aaa->message().c_str());
-		}
-#else
-		Logger::global()->enterLogMessage("BitTorrent", aaa->message().c_str());
-#endif
-
-#undef IS_ALERT
-#undef IS_ALERT_S
-
+			d->notifyTextChanged();
+			
+			if(d->isPrefetching())
+			{
+				// sizes and files are known now, the rest waits for the queue
+				d->stopPrefetch();
+				d->m_nInactiveSince = QDateTime::currentDateTime().toTime_t();
+			}
+			break;
 	}
 }
 
@@ -1415,21 +1835,6 @@ void TorrentWorker::doWork()
 {
 	QMutexLocker l(&m_mutex);
 	
-	foreach(TorrentDownload* d, m_objects)
-	{
-		if(!d->m_handle.is_valid())
-			continue;
-		
-		d->m_status = d->m_handle.status();
-		
-		if(!d->m_info)
-		{
-            if(!d->m_status.has_metadata)
-				continue;
-			d->m_info = d->m_handle.torrent_file();
-		}
-	}
-	
 	foreach(TorrentDownload* d, m_objects)
 	{
 		if(!d->m_handle.is_valid() || !d->m_info)
@@ -1456,7 +1861,8 @@ void TorrentWorker::doWork()
 					d->enterLogMessage(tr("Requested parts of the torrent have been downloaded"));
 					d->setMode(Transfer::Upload);
 				}
-				d->m_handle.super_seeding(d->m_bSuperSeeding);
+				if(d->m_status.super_seeding != d->m_bSuperSeeding)
+					d->m_handle.super_seeding(d->m_bSuperSeeding);
 			}
 			if(d->mode() == Transfer::Upload)
 			{
@@ -1475,33 +1881,46 @@ void TorrentWorker::doWork()
 					d->m_handle.super_seeding(d->m_bSuperSeeding);
 			}
 			
-			int down, up, sdown, sup;
-			
-			down = d->m_handle.download_limit();
-			up = d->m_handle.upload_limit();
+			int sdown, sup;
 			
 			d->internalSpeedLimits(sdown, sup);
 			
 			if(!sdown) sdown--;
 			if(!sup) sup--;
 			
-			if(down != sdown || up != sup)
+			// compare with what we applied last instead of asking the session thread
+			if(d->m_nLimitDown != sdown || d->m_nLimitUp != sup)
 				d->setSpeedLimits(sdown, sup);
 		}
 	}
 	
-	QMutexLocker ll(&TorrentDownload::m_mutexAlerts);
-	while(true)
+	const int detachAfter = g_detachAfter;
+	if(detachAfter >= 0)
 	{
-		libtorrent::alert* aaa;
-		std::unique_ptr<libtorrent::alert> a = TorrentDownload::m_session->pop_alert();
+		const uint now = QDateTime::currentDateTime().toTime_t();
 		
-		if((aaa = a.get()) == 0)
-			break;
-		
-		processAlert(aaa);
+		foreach(TorrentDownload* d, m_objects)
+		{
+			if(!d->m_handle.is_valid() || !d->m_nInactiveSince || d->isActive() || d->m_bHasHashCheck)
+				continue;
+			// still waiting for the resume data, ask again if they got lost
+			if(d->m_nDetachRequested && now - d->m_nDetachRequested < 60)
+				continue;
+			if(d->m_status.state == libtorrent::torrent_status::checking_files
+				|| d->m_status.state == libtorrent::torrent_status::queued_for_checking)
+				continue;
+			if(now - d->m_nInactiveSince >= uint(detachAfter)*60)
+				d->detachFromSession();
+		}
 	}
 	
+	schedulePrefetch();
+	tuneDiskCache();
+	TorrentCreator::expireJobs();
+	
+	// only torrents whose status has changed will be reported, through the alert thread
+	TorrentDownload::m_session->post_torrent_updates();
+	
 	libtorrent::session_status st = TorrentDownload::m_session->status();
 	if(TorrentDownload::m_bDHT && TorrentDownload::m_labelDHTStats)
 	{
@@ -1510,6 +1929,97 @@ void TorrentWorker::doWork()
 	}
 }
 
+void TorrentWorker::tuneDiskCache()
+{
+	if(!g_cacheAuto || ++m_nCacheTicks < CACHE_TUNE_INTERVAL)
+		return;
+	m_nCacheTicks = 0;
+	
+	const libtorrent::cache_status cs = TorrentDownload::m_session->get_cache_status();
+	const qint64 reads = cs.blocks_read - m_nCacheReads;
+	const qint64 hits = cs.blocks_read_hit - m_nCacheHits;
+	
+	m_nCacheReads = cs.blocks_read;
+	m_nCacheHits = cs.blocks_read_hit;
+	
+	libtorrent::session_settings settings = TorrentDownload::m_session->settings();
+	const int budget = TorrentDownload::diskCacheBudget();
+	const bool congested = cs.job_queue_length >= CACHE_QUEUE_HIGH;
+	const bool missing = reads > 0 && hits*2 < reads;
+	int size = settings.cache_size, line = settings.read_cache_line_size;
+	
+	if(congested || missing)
+	{
+		// the disk is the bottleneck: if the cache is being used up,
+		// give it more memory and read further ahead
+		if(cs.cache_size >= size*9/10)
+			size = qMin(budget, size + size/2);
+		if(congested)
+			line = qMin(READ_LINE_MAX, line*2);
+	}
+	else if(cs.cache_size < size/2)
+	{
+		// mostly idle, return some of the memory
+		size = qMax(CACHE_MIN_SIZE, size*3/4);
+		line = qMax(READ_LINE_MIN, line/2);
+	}
+	
+	if(size != settings.cache_size || line != settings.read_cache_line_size)
+	{
+		settings.cache_size = size;
+		settings.read_cache_line_size = line;
+		TorrentDownload::m_session->set_settings(settings);
+	}
+}
+
+int TorrentDownload::diskCacheBudget()
+{
+	qint64 bytes = qint64(getSettingsValue("torrent/cache_budget").toInt()) * 1024*1024;
+	
+	if(bytes <= 0)
+	{
+		// an eighth of the physical memory, up to 1 GiB
+		bytes = 128*1024*1024;
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+		const qint64 pages = sysconf(_SC_PHYS_PAGES), pageSize = sysconf(_SC_PAGESIZE);
+		if(pages > 0 && pageSize > 0)
+			bytes = qBound<qint64>(bytes, pages*pageSize/8, 1024*1024*1024);
+#endif
+	}
+	
+	return int(qMax<qint64>(CACHE_MIN_SIZE, bytes / (16*1024)));
+}
+
+void TorrentDownload::startPrefetch()
+{
+	// upload mode keeps the torrent from requesting pieces, the metadata exchange still works
+	m_handle.set_upload_mode(true);
+	m_handle.resume();
+	m_nPrefetchStarted = QDateTime::currentDateTime().toTime_t();
+	
+	enterLogMessage(tr("Retrieving the metadata in the background"));
+}
+
+void TorrentDownload::stopPrefetch()
+{
+	if(!isPrefetching())
+		return;
+	
+	m_nPrefetchStarted = 0;
+	m_nPrefetchTried = QDateTime::currentDateTime().toTime_t();
+	
+	if(!m_handle.is_valid())
+		return;
+	
+	m_handle.set_upload_mode(false);
+	if(!isActive())
+	{
+		m_handle.pause();
+		// lets the worker detach it again later
+		m_nInactiveSince = QDateTime::currentDateTime().toTime_t();
+	}
+}
+
 void TorrentDownload::forceReannounce()
 {
 	if(!m_handle.is_valid())
@@ -1529,7 +2039,7 @@ void TorrentDownload::forceReannounce()
 
 void TorrentDownload::forceRecheck()
 {
-	if(isActive() || !m_handle.is_valid())
+	if(isActive() || !attachToSession())
 		return;
 	
 	m_bHasHashCheck = false;
@@ -1560,10 +2070,12 @@ WidgetHostChild* TorrentDownload::createOptionsWidget(QWidget* w)
 
 QString TorrentDownload::remoteURI() const
 {
-	if (!m_handle.is_valid())
-		return QString();
-	else
+	if (m_handle.is_valid())
 		return QString::fromStdString(libtorrent::make_magnet_uri(m_handle));
+	else if (const_cast<TorrentDownload*>(this)->ensureMetadata())
+		return QString::fromStdString(libtorrent::make_magnet_uri(*m_info));
+	else
+		return QString();
 }
 
 #ifdef WITH_WEBINTERFACE
@@ -1579,7 +2091,7 @@ QVariant TorrentDownload::setFilePriorities(QList<QVariant>& args)
 	if (!t)
 		throw XmlRpcService::XmlRpcError(102, "Invalid transfer UUID");
 
-	if (! (td = dynamic_cast<TorrentDownload*>(t)) || !td->m_handle.is_valid())
+	if (! (td = dynamic_cast<TorrentDownload*>(t)) || !td->ensureMetadata())
 	{
 		q->unlock();
 		g_queuesLock.unlock();
@@ -1599,7 +2111,8 @@ QVariant TorrentDownload::setFilePriorities(QList<QVariant>& args)
 				; // TODO throw exception
 		}
 
-		td->m_handle.prioritize_files(td->m_vecPriorities);
+		if (td->m_handle.is_valid())
+			td->m_handle.prioritize_files(td->m_vecPriorities);
 	}
 	catch (...)
 	{
@@ -1615,7 +2128,51 @@ QVariant TorrentDownload::setFilePriorities(QList<QVariant>& args)
 }
 #endif
 
+void TorrentWorker::schedulePrefetch()
+{
+	const int limit = g_prefetchLimit;
+	const uint now = QDateTime::currentDateTime().toTime_t();
+	int running = 0;
+	
+	foreach(TorrentDownload* d, m_objects)
+	{
+		if(!d->isPrefetching())
+			continue;
+		
+		// only waiting transfers prefetch, a paused one mustn't keep its peers
+		if(d->state() != Transfer::Waiting || d->m_info || !d->m_handle.is_valid())
+			d->stopPrefetch();
+		else if(now - d->m_nPrefetchStarted >= PREFETCH_TIMEOUT)
+		{
+			d->enterLogMessage(tr("The metadata couldn't be retrieved in the background yet"));
+			d->stopPrefetch();
+		}
+		else
+			running++;
+	}
+	
+	while(running < limit)
+	{
+		TorrentDownload* next = 0;
+		
+		// the ones that have waited longest since their last attempt go first
+		foreach(TorrentDownload* d, m_objects)
+		{
+			if(d->isPrefetching() || d->m_info || !d->m_handle.is_valid() || d->state() != Transfer::Waiting)
+				continue;
+			if(!next || d->m_nPrefetchTried < next->m_nPrefetchTried)
+				next = d;
+		}
+		
+		if(!next)
+			break;
+		
+		next->startPrefetch();
+		running++;
+	}
+}
+
 void TorrentWorker::setDetailsObject(TorrentDetails* d)
 {
-	connect(&m_timer, SIGNAL(timeout()), d, SLOT(refresh()));
+	connect(TickService::instance(), SIGNAL(secondTick()), d, SLOT(refresh()));
 }
@@ -39,6 +39,8 @@ respects for all of the code used other than "OpenSSL".
 #include <QMutex>
 #include <QTemporaryFile>
 #include <QRegExp>
+#include <QHash>
+#include <QByteArray>
 #include <vector>
 #include <libtorrent/session.hpp>
 #include <libtorrent/torrent_handle.hpp>
@@ -48,6 +50,9 @@ respects for all of the code used other than "OpenSSL".
 #endif
 
 class TorrentWorker;
+class TorrentIPFilter;
+class TorrentAlertThread;
+struct TorrentEvent;
 class TorrentDetails;
 class RssFetcher;
 class QLabel;
@@ -74,6 +79,10 @@ public:
 	static void applySettings();
 	static void globalExit();
 	
+	// Parses the stored torrent files on the thread pool, load() then
+	// picks up the results instead of parsing the files itself
+	static void preloadTorrentFiles(QStringList files);
+	
 	static QByteArray bencode_simple(libtorrent::entry& e);
 	static QString bencode(libtorrent::entry& e);
 	static libtorrent::entry bdecode_simple(QByteArray d);
@@ -115,14 +124,36 @@ public:
 	virtual void process(QString method, QMap<QString,QString> args, WriteBack* wb);
 	virtual const char* detailsScript() const;
 	virtual QVariantMap properties() const;
+	virtual Stream* openStream(int file, QString& error);
 #endif
 public slots:
 	void downloadTorrent(QString source);
+signals:
+	// a piece has passed the hash check
+	void pieceFinished(int piece);
 private:
 	void createDefaultPriorityList();
+	// Parses the stored .torrent file of a dormant torrent
+	bool ensureMetadata();
+	// Dormant torrents are only kept as metadata and resume data,
+	// they enter the session when they're activated
+	bool attachToSession();
+	// Asks for the resume data, finishDetach() completes the detach once the data arrive
+	void detachFromSession();
+	void finishDetach(const QByteArray& resume);
+	bool isDormant() const { return !m_handle.is_valid() && !m_strTorrentFile.isEmpty(); }
+	// A waiting magnet link may fetch its metadata ahead of being activated
+	void startPrefetch();
+	void stopPrefetch();
+	bool isPrefetching() const { return m_nPrefetchStarted != 0; }
+	// m_strTarget has to be set
+	void addMagnet(QString uri);
+	QByteArray fetchResumeData() const;
 	bool storeTorrent(QString orig);
 	bool storeTorrent();
 	QString storedTorrentName() const;
+	// the most the automatically tuned disk cache may take, in 16 KiB blocks
+	static int diskCacheBudget();
 private slots:
 	void torrentFileDone(QNetworkReply* reply);
 	void torrentFileReadyRead();
@@ -143,6 +174,15 @@ protected:
 	bool m_bHasHashCheck, m_bAuto, m_bSuperSeeding;
 	QList<QString> m_urlSeeds;
 	
+	// the state of a torrent outside the session
+	QString m_strTorrentFile, m_strName;
+	QByteArray m_resumeData;
+	QStringList m_listTrackers, m_listUrlSeeds;
+	bool m_bStoredLists;
+	uint m_nInactiveSince, m_nDetachRequested;
+	uint m_nPrefetchStarted, m_nPrefetchTried;
+	int m_nLimitDown, m_nLimitUp; // last limits set on m_handle, 0 if none
+	
 	QNetworkAccessManager* m_pFileDownload;
 	QNetworkReply* m_pReply;
 	QTemporaryFile* m_pFileDownloadTemp;
@@ -156,9 +196,11 @@ protected:
 	static bool m_bDHT;
 	static QList<QRegExp> m_listBTLinks;
 	static QLabel* m_labelDHTStats;
-	static QMutex m_mutexAlerts;
+	static TorrentAlertThread* m_alertThread;
+	static TorrentIPFilter* m_ipFilter;
 	
 	friend class TorrentWorker;
+	friend class TorrentStream;
 	friend class TorrentDetails;
 	friend class TorrentPiecesModel;
 	friend class TorrentPeersModel;
@@ -176,16 +218,29 @@ public:
 	TorrentWorker();
 	void addObject(TorrentDownload* d);
 	void removeObject(TorrentDownload* d);
-	// To reduce QTimer usage
+	// Refreshed along with the worker
 	void setDetailsObject(TorrentDetails* d);
 	TorrentDownload* getByHandle(libtorrent::torrent_handle handle) const;
-	void processAlert(libtorrent::alert* aaa);
+	static QByteArray hashKey(const libtorrent::sha1_hash& hash);
 public slots:
 	void doWork();
+	// Handles what TorrentAlertThread has posted
+	void processEvents();
+private:
+	TorrentDownload* getByHash(const libtorrent::sha1_hash& hash, const libtorrent::torrent_handle& handle) const;
+	void processStatus(const std::vector<libtorrent::torrent_status>& status);
+	void processEvent(TorrentEvent* ev);
+	void schedulePrefetch();
+	// adapts the disk cache size and read-ahead to the cache statistics
+	void tuneDiskCache();
 private:
-	QTimer m_timer;
 	QMutex m_mutex;
 	QList<TorrentDownload*> m_objects;
+	// filled in lazily, entries are checked against the handle on every lookup
+	mutable QHash<QByteArray, TorrentDownload*> m_byHash;
+	// the disk cache statistics at the previous tuning
+	int m_nCacheTicks;
+	qint64 m_nCacheReads, m_nCacheHits;
 };
 
 #endif
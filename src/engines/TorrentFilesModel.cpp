@@ -161,11 +161,41 @@ void TorrentFilesModel::refresh(const libtorrent::bitfield* pieces)
 			dataChanged(createIndex(i, 2), createIndex(i, m_columns.size())); // refresh the view
 		}
 	}*/
+	std::vector<libtorrent::size_type> progresses;
+	
 	m_pieces = pieces;
 	
-	if(m_download->m_handle.is_valid())
-		m_download->m_handle.file_progress(m_progresses);
-	dataChanged(createIndex(0, 2), createIndex(m_files.size(), m_columns.size())); // refresh the view
+	if(!m_download->m_handle.is_valid())
+		return;
+	
+	m_download->m_handle.file_progress(progresses);
+	if(progresses.size() != m_progresses.size())
+	{
+		m_progresses.swap(progresses);
+		if(!m_files.isEmpty())
+			dataChanged(createIndex(0, 2), createIndex(m_files.size()-1, m_columns.size()-1));
+		return;
+	}
+	
+	// only files whose progress has moved need to be repainted
+	m_progresses.swap(progresses);
+	
+	int from = -1;
+	const int count = qMin<int>(m_files.size(), progresses.size());
+	for(int i=0;i<count;i++)
+	{
+		bool changed = progresses[i] != m_progresses[i];
+		
+		if(changed && from < 0)
+			from = i;
+		else if(!changed && from >= 0)
+		{
+			dataChanged(createIndex(from, 2), createIndex(i-1, m_columns.size()-1));
+			from = -1;
+		}
+	}
+	if(from >= 0)
+		dataChanged(createIndex(from, 2), createIndex(count-1, m_columns.size()-1));
 }
 
 void TorrentProgressDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
@@ -25,36 +25,343 @@ respects for all of the code used other than "OpenSSL".
 */
 
 #include "TorrentIPFilter.h"
+#include "Logger.h"
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QMutex>
+#include <QtDebug>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
 
-bool loadIPFilter(QString textFile, libtorrent::ip_filter* filter)
+static const char CACHE_MAGIC[8] = { 'F', 'R', 'I', 'P', 'F', 'L', 'T', '1' };
+
+struct CacheHeader
 {
-	QFile file(textFile);
-	
-	if(!file.open(QIODevice::ReadOnly))
+	char magic[8];
+	// identify the blocklist the cache was built from
+	qint64 sourceSize, sourceModified;
+	quint32 count, reserved;
+};
+
+// inclusive, host byte order
+typedef std::pair<quint32, quint32> Range;
+
+// lines or ranges between checks for an abort
+static const int ABORT_CHECK_INTERVAL = 4096;
+
+// serializes the session updates with TorrentIPFilter::detach()
+static QMutex g_sessionLock;
+
+QList<TorrentIPFilter*> TorrentIPFilter::m_detached;
+
+static inline bool aborted(const volatile bool* abort, size_t i)
+{
+	return abort && i % ABORT_CHECK_INTERVAL == 0 && *abort;
+}
+
+static QString cachePath(QString source)
+{
+	QDir dir = QDir::home();
+	QByteArray hash = QCryptographicHash::hash(source.toUtf8(), QCryptographicHash::Md5).toHex();
+
+	dir.mkpath(".local/share/fatrat");
+	return dir.absoluteFilePath(".local/share/fatrat/ipfilter-" + QString::fromLatin1(hash.left(16)) + ".cache");
+}
+
+static bool parseIPv4(const char*& p, quint32& out)
+{
+	out = 0;
+	for (int octet = 0; octet < 4; octet++)
+	{
+		int value = 0, digits = 0;
+
+		if (octet && *p++ != '.')
+			return false;
+		while (*p >= '0' && *p <= '9' && digits < 3)
+		{
+			value = value*10 + (*p++ - '0');
+			digits++;
+		}
+		if (!digits || value > 255)
+			return false;
+		out = (out << 8) | value;
+	}
+	return true;
+}
+
+static inline void skipSpaces(const char*& p)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+}
+
+// first - last, IPv4 only
+static bool parseRange(const char*& p, Range& range)
+{
+	skipSpaces(p);
+	if (!parseIPv4(p, range.first))
+		return false;
+	skipSpaces(p);
+	if (*p++ != '-')
+		return false;
+	skipSpaces(p);
+	if (!parseIPv4(p, range.second))
+		return false;
+	skipSpaces(p);
+	return true;
+}
+
+// Accepts both formats: DAT lines start with the range and carry an access
+// level, where 128+ means allowed, the range in P2P lines follows the last
+// colon. DAT descriptions may contain colons too, hence the order.
+static bool parseLine(const char* line, Range& range)
+{
+	const char* p = line;
+
+	skipSpaces(p);
+	if (!*p || *p == '#' || *p == '/' || *p == '\r' || *p == '\n')
+		return false;
+
+	const char* dat = p;
+	if (parseRange(dat, range))
+	{
+		if (*dat == ',')
+		{
+			dat++;
+			skipSpaces(dat);
+			if (atoi(dat) >= 128)
+				return false;
+		}
+	}
+	else
+	{
+		const char* colon = strrchr(p, ':');
+		if (!colon)
+			return false;
+
+		p = colon+1;
+		if (!parseRange(p, range))
+			return false;
+	}
+
+	if (range.first > range.second)
+		std::swap(range.first, range.second);
+	return true;
+}
+
+static bool parseBlocklist(QString file, std::vector<Range>& ranges, QString* error, const volatile bool* abort)
+{
+	QByteArray path = QFile::encodeName(file);
+	gzFile gz = gzopen(path.constData(), "rb"); // reads uncompressed files as well
+	char line[1024];
+	size_t lines = 0;
+
+	if (!gz)
+	{
+		if (error)
+			*error = QObject::tr("Failed to open %1").arg(file);
+		return false;
+	}
+
+	gzbuffer(gz, 128*1024);
+
+	while (gzgets(gz, line, sizeof(line)))
+	{
+		Range range;
+		size_t len = strlen(line);
+
+		if (aborted(abort, ++lines))
+		{
+			gzclose(gz);
+			return false;
+		}
+
+		// an overlong line, drop the rest of it
+		if (len == sizeof(line)-1 && line[len-1] != '\n')
+		{
+			int c;
+			while ((c = gzgetc(gz)) != -1 && c != '\n')
+				;
+		}
+
+		if (parseLine(line, range))
+			ranges.push_back(range);
+	}
+
+	int err;
+	const char* msg = gzerror(gz, &err);
+	if (err != Z_OK && err != Z_STREAM_END)
+	{
+		if (error)
+			*error = QObject::tr("Failed to read %1: %2").arg(file).arg(msg);
+		gzclose(gz);
+		return false;
+	}
+
+	gzclose(gz);
+
+	// sort and merge overlapping or adjacent ranges
+	std::sort(ranges.begin(), ranges.end());
+
+	size_t out = 0;
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		if (out && quint64(ranges[i].first) <= quint64(ranges[out-1].second) + 1)
+			ranges[out-1].second = std::max(ranges[out-1].second, ranges[i].second);
+		else
+			ranges[out++] = ranges[i];
+	}
+	ranges.resize(out);
+
+	return true;
+}
+
+static void writeCache(QString path, const QFileInfo& source, const std::vector<Range>& ranges)
+{
+	QSaveFile file(path);
+	CacheHeader header;
+
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.sourceSize = source.size();
+	header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+	header.count = ranges.size();
+	header.reserved = 0;
+
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		quint32 pair[2] = { ranges[i].first, ranges[i].second };
+		file.write(reinterpret_cast<const char*>(pair), sizeof(pair));
+	}
+
+	if (!file.commit())
+		qDebug() << "Failed to write the IP filter cache" << path;
+}
+
+static inline void addRange(libtorrent::ip_filter* filter, quint32 first, quint32 last)
+{
+	filter->add_rule(libtorrent::address_v4(first), libtorrent::address_v4(last), libtorrent::ip_filter::blocked);
+}
+
+// returns false if there's no up-to-date cache
+static bool loadCache(QString path, const QFileInfo& source, libtorrent::ip_filter* filter, const volatile bool* abort)
+{
+	QFile file(path);
+
+	if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(CacheHeader)))
+		return false;
+
+	const uchar* data = file.map(0, file.size());
+	if (!data)
+		return false;
+
+	const CacheHeader* header = reinterpret_cast<const CacheHeader*>(data);
+	bool valid = !memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC))
+		&& header->sourceSize == source.size()
+		&& header->sourceModified == source.lastModified().toMSecsSinceEpoch()
+		&& file.size() == qint64(sizeof(CacheHeader) + header->count * 2 * sizeof(quint32));
+
+	if (valid)
+	{
+		const quint32* ranges = reinterpret_cast<const quint32*>(data + sizeof(CacheHeader));
+		for (quint32 i = 0; i < header->count && !aborted(abort, i); i++)
+			addRange(filter, ranges[i*2], ranges[i*2+1]);
+	}
+
+	file.unmap(const_cast<uchar*>(data));
+	return valid;
+}
+
+bool loadIPFilter(QString file, libtorrent::ip_filter* filter, QString* error, const volatile bool* abort)
+{
+	QFileInfo source(file);
+	QString cache = cachePath(source.absoluteFilePath());
+
+	if (!source.exists())
+	{
+		if (error)
+			*error = QObject::tr("The file %1 doesn't exist").arg(file);
 		return false;
+	}
+
+	if (loadCache(cache, source, filter, abort))
+		return !(abort && *abort);
+
+	std::vector<Range> ranges;
+	if (!parseBlocklist(file, ranges, error, abort))
+		return false;
+
+	writeCache(cache, source, ranges);
+
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		if (aborted(abort, i))
+			return false;
+		addRange(filter, ranges[i].first, ranges[i].second);
+	}
+	return true;
+}
+
+TorrentIPFilter::TorrentIPFilter(libtorrent::session* session, QString file)
+	: m_session(session), m_strFile(file), m_bAbort(false)
+{
+}
+
+TorrentIPFilter::~TorrentIPFilter()
+{
+	wait();
+	m_detached.removeAll(this);
+}
+
+void TorrentIPFilter::detach(TorrentIPFilter* filter)
+{
+	{
+		QMutexLocker l(&g_sessionLock);
+		filter->m_bAbort = true;
+	}
 	
-	while(file.canReadLine())
+	m_detached << filter;
+	connect(filter, SIGNAL(finished()), filter, SLOT(deleteLater()));
+	
+	if (filter->isFinished())
+		delete filter;
+}
+
+void TorrentIPFilter::waitForDetached()
+{
+	while (!m_detached.isEmpty())
+		delete m_detached.first();
+}
+
+void TorrentIPFilter::run()
+{
+	libtorrent::ip_filter filter;
+	QString error;
+	QElapsedTimer time;
+
+	time.start();
+
+	if (loadIPFilter(m_strFile, &filter, &error, &m_bAbort))
 	{
-		QByteArray line = file.readLine();
-		QByteArray from, to;
-		
-		int colon, dash;
+		QMutexLocker l(&g_sessionLock);
 		
-		colon = line.indexOf(':') + 1;
-		if(!colon)
-			continue;
+		// a newer loader may have taken over meanwhile
+		if (m_bAbort)
+			return;
 		
-		dash = line.indexOf('-', colon+1);
-		if(dash < 0)
-			continue;
-		
-		from = line.mid(colon, dash-colon);
-		to = line.mid(dash+1);
-		
-		filter->add_rule(libtorrent::address::from_string(from.data()),
-				 libtorrent::address::from_string(to.data()), libtorrent::ip_filter::blocked);
+		m_session->set_ip_filter(filter);
+		Logger::global()->enterLogMessage("BitTorrent", tr("Loaded the IP filter in %1 ms").arg(time.elapsed()));
 	}
-	
-	return true;
+	else if (!m_bAbort)
+		Logger::global()->enterLogMessage(Logger::LevelWarning, "BitTorrent", tr("Failed to load the IP filter: %1").arg(error));
 }
@@ -27,8 +27,38 @@ respects for all of the code used other than "OpenSSL".
 #ifndef TORRENTIPFILTER_H
 #define TORRENTIPFILTER_H
 #include <QString>
+#include <QThread>
+#include <QList>
 #include <libtorrent/ip_filter.hpp>
+#include <libtorrent/session.hpp>
 
-bool loadIPFilter(QString textFile, libtorrent::ip_filter* filter);
+// Reads a P2P (name:first-last) or DAT (first - last , level , name) blocklist,
+// optionally gzipped. The merged ranges are cached in a binary file that is
+// memory-mapped on later calls, until the blocklist changes.
+// Returns false without an error once *abort becomes true.
+bool loadIPFilter(QString file, libtorrent::ip_filter* filter, QString* error = 0, const volatile bool* abort = 0);
+
+// Loads a blocklist into the session without blocking the caller
+class TorrentIPFilter : public QThread
+{
+Q_OBJECT
+public:
+	TorrentIPFilter(libtorrent::session* session, QString file);
+	~TorrentIPFilter();
+
+	virtual void run();
+	
+	// Stops the loader without waiting for it, it won't touch the session
+	// anymore and deletes itself once the thread ends
+	static void detach(TorrentIPFilter* filter);
+	// waits for all detached loaders, before the session is destroyed
+	static void waitForDetached();
+private:
+	libtorrent::session* m_session;
+	QString m_strFile;
+	volatile bool m_bAbort;
+	
+	static QList<TorrentIPFilter*> m_detached;
+};
 
 #endif
@@ -55,6 +55,9 @@ void TorrentOptsWidget::startInvalid()
 
 void TorrentOptsWidget::handleInvalid()
 {
+	if(m_download->isDormant())
+		m_download->attachToSession();
+	
 	if(m_download->m_info && m_download->m_handle.is_valid())
 	{
 		m_timer.stop();
@@ -76,6 +79,10 @@ void TorrentOptsWidget::handleInvalid()
 
 void TorrentOptsWidget::load()
 {
+	// trackers and web seeds are edited on the handle
+	if(m_download->isDormant())
+		m_download->attachToSession();
+	
 	if(!m_download->m_info || !m_download->m_handle.is_valid())
 	{
 		startInvalid();
@@ -30,6 +30,7 @@ respects for all of the code used other than "OpenSSL".
 #include <QIcon>
 #include <libtorrent/peer_info.hpp>
 #include <QtDebug>
+#include <map>
 
 extern void* g_pGeoIP;
 
@@ -38,8 +39,44 @@ extern const char* ( *GeoIP_country_code_by_addr_imp ) ( void*, const char* );
 
 static QMap<QString,QIcon> g_mapFlags;
 
+// Formatting the address and asking GeoIP is far too slow to be done on every paint
+struct PeerAddress
+{
+	QString ip, country, code;
+};
+static std::map<libtorrent::address, PeerAddress> g_mapAddresses;
+
+static const PeerAddress& peerAddress ( const libtorrent::address& addr )
+{
+	std::map<libtorrent::address, PeerAddress>::iterator it = g_mapAddresses.find ( addr );
+	if ( it != g_mapAddresses.end() )
+		return it->second;
+	
+	if ( g_mapAddresses.size() >= 4096 )
+		g_mapAddresses.clear();
+	
+	PeerAddress& pa = g_mapAddresses[addr];
+	std::string ip = addr.to_string();
+	
+	pa.ip = QString ( ip.c_str() );
+	if ( g_pGeoIP != 0 )
+	{
+		const char* country = GeoIP_country_name_by_addr_imp ( g_pGeoIP, ip.c_str() );
+		const char* code = GeoIP_country_code_by_addr_imp ( g_pGeoIP, ip.c_str() );
+		
+		if ( country != 0 )
+			pa.country = QString ( country );
+		if ( code != 0 && code[0] && code[1] )
+		{
+			char ct[3] = { (char) tolower ( code[0] ), (char) tolower ( code[1] ), 0 };
+			pa.code = ct;
+		}
+	}
+	return pa;
+}
+
 TorrentPeersModel::TorrentPeersModel ( QObject* parent, TorrentDownload* d )
-		: QAbstractListModel ( parent ), m_download ( d ), m_nLastRowCount ( 0 )
+		: QAbstractListModel ( parent ), m_download ( d )
 {
 	m_columns << tr ( "IP address" ) << tr ( "Country" ) << tr ( "Client" );
 	m_columns << tr ( "Encryption" ) << tr ( "Source" ) << tr ( "Download" ) << tr ( "Upload" );
@@ -62,7 +99,7 @@ QModelIndex TorrentPeersModel::parent ( const QModelIndex& ) const
 
 int TorrentPeersModel::rowCount ( const QModelIndex& ) const
 {
-	return m_nLastRowCount;
+	return m_peers.size();
 }
 
 QVariant TorrentPeersModel::headerData ( int section, Qt::Orientation orientation, int role ) const
@@ -83,22 +120,9 @@ QVariant TorrentPeersModel::data ( const QModelIndex &index, int role ) const
 		switch ( index.column() )
 		{
 			case 0:
-			{
-				std::string ip = info.ip.address().to_string();
-				return QString ( ip.c_str() );
-			}
+				return peerAddress ( info.ip.address() ).ip;
 			case 1:
-			{
-				const char* country = 0;
-				std::string ip = info.ip.address().to_string();
-
-				if ( g_pGeoIP != 0 )
-					country = GeoIP_country_name_by_addr_imp ( g_pGeoIP, ip.c_str() );
-				if ( country != 0 )
-					return QString ( country );
-				else
-					return QString();
-			}
+				return peerAddress ( info.ip.address() ).country;
 			case 2:
 				return QString::fromUtf8 ( info.client.c_str() );
 			case 3:
@@ -164,10 +188,7 @@ QVariant TorrentPeersModel::data ( const QModelIndex &index, int role ) const
 				}
 			case 10:
 			{
-				int pcs = 0;
-				for ( ssize_t i=0;i<info.pieces.size();i++ )
-					if ( info.pieces[i] )
-						pcs++;
+				int pcs = info.pieces.count();
 				QString pct = QString ( "%1%" ).arg ( ( int ) ( 100.0/double ( info.pieces.size() ) *pcs ) );
 				
 				if(info.flags & libtorrent::peer_info::seed)
@@ -180,20 +201,12 @@ QVariant TorrentPeersModel::data ( const QModelIndex &index, int role ) const
 	{
 		if ( index.column() == 1 && g_pGeoIP != 0 )
 		{
-			std::string ip = info.ip.address().to_string();
-			const char* country = GeoIP_country_code_by_addr_imp ( g_pGeoIP, ip.c_str() );
+			const QString& ct = peerAddress ( info.ip.address() ).code;
 
-			if ( country != 0 )
+			if ( !ct.isEmpty() )
 			{
-				char ct[3] = { (char) tolower ( country[0] ), (char) tolower ( country[1] ), 0 };
-
 				if ( !g_mapFlags.contains ( ct ) )
-				{
-					char flag[] = ":/flags/xx.gif";
-					flag[8] = ct[0];
-					flag[9] = ct[1];
-					g_mapFlags[ct] = QIcon ( flag );
-				}
+					g_mapFlags[ct] = QIcon ( QString ( ":/flags/%1.gif" ).arg ( ct ) );
 				return g_mapFlags[ct];
 			}
 		}
@@ -207,28 +220,73 @@ bool TorrentPeersModel::hasChildren ( const QModelIndex & parent ) const
 	return !parent.isValid();
 }
 
+bool TorrentPeersModel::peerChanged ( const libtorrent::peer_info& a, const libtorrent::peer_info& b )
+{
+	return a.flags != b.flags || a.source != b.source || a.connection_type != b.connection_type
+		|| a.down_speed != b.down_speed || a.up_speed != b.up_speed
+		|| a.total_download != b.total_download || a.total_upload != b.total_upload
+		|| a.num_pieces != b.num_pieces || a.client != b.client;
+}
+
 void TorrentPeersModel::refresh()
 {
-	int count = 0;
+	std::vector<libtorrent::peer_info> peers;
+	std::map<libtorrent::tcp::endpoint, int> incoming;
 
 	if ( m_download->m_handle.is_valid() )
+		m_download->m_handle.get_peer_info ( peers );
+
+	for ( size_t i=0;i<peers.size();i++ )
+		incoming[peers[i].ip] = i;
+
+	// drop the peers that have gone away, bottom up so that the row numbers stay valid
+	for ( int i = int ( m_peers.size() ) - 1; i >= 0; i-- )
 	{
-		m_peers.clear();
-		m_download->m_handle.get_peer_info ( m_peers );
-		count = m_peers.size();
+		if ( incoming.count ( m_peers[i].ip ) )
+			continue;
+
+		int last = i;
+		while ( i > 0 && !incoming.count ( m_peers[i-1].ip ) )
+			i--;
+
+		beginRemoveRows ( QModelIndex(), i, last );
+		m_peers.erase ( m_peers.begin() + i, m_peers.begin() + last + 1 );
+		endRemoveRows();
 	}
 
-	if ( count > m_nLastRowCount )
+	// update the remaining ones in place and signal only the rows that differ
+	int from = -1;
+	for ( size_t i=0;i<m_peers.size();i++ )
 	{
-		beginInsertRows ( QModelIndex(), m_nLastRowCount, count-1 );
-		endInsertRows();
+		std::map<libtorrent::tcp::endpoint, int>::iterator it = incoming.find ( m_peers[i].ip );
+		const libtorrent::peer_info& now = peers[it->second];
+		bool changed = peerChanged ( m_peers[i], now );
+
+		m_peers[i] = now;
+		incoming.erase ( it );
+
+		if ( changed && from < 0 )
+			from = i;
+		else if ( !changed && from >= 0 )
+		{
+			dataChanged ( createIndex ( from, 0 ), createIndex ( i-1, m_columns.size()-1 ) );
+			from = -1;
+		}
 	}
-	else if ( count < m_nLastRowCount )
+	if ( from >= 0 )
+		dataChanged ( createIndex ( from, 0 ), createIndex ( m_peers.size()-1, m_columns.size()-1 ) );
+
+	// whatever is left is new
+	if ( !incoming.empty() )
 	{
-		beginRemoveRows ( QModelIndex(), 0, m_nLastRowCount-count-1 );
-		endRemoveRows();
-	}
-	m_nLastRowCount = count;
+		int first = m_peers.size();
 
-	dataChanged ( createIndex ( 0,0 ), createIndex ( count, m_columns.size() ) ); // refresh the view
+		beginInsertRows ( QModelIndex(), first, first + incoming.size() - 1 );
+		for ( size_t i=0;i<peers.size();i++ )
+		{
+			if ( incoming.count ( peers[i].ip ) )
+				m_peers.push_back ( peers[i] );
+		}
+		endInsertRows();
+	}
 }
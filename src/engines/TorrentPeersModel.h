@@ -50,10 +50,12 @@ public:
 	
 	void refresh();
 protected:
+	// rows keep their position for as long as the peer stays connected
 	std::vector<libtorrent::peer_info> m_peers;
 private:
+	static bool peerChanged(const libtorrent::peer_info& a, const libtorrent::peer_info& b);
+	
 	TorrentDownload* m_download;
-	int m_nLastRowCount;
 	QStringList m_columns;
 	
 	friend class TorrentDetails;
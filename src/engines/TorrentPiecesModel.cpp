@@ -27,9 +27,10 @@ respects for all of the code used other than "OpenSSL".
 #include "TorrentPiecesModel.h"
 #include "TorrentDownload.h"
 #include <QPainter>
+#include <map>
 
 TorrentPiecesModel::TorrentPiecesModel(QObject* parent, TorrentDownload* d)
-: QAbstractListModel(parent), m_download(d), m_nLastRowCount(0)
+: QAbstractListModel(parent), m_download(d)
 {
 	m_columns << tr("Piece ID") << tr("State") << tr("Block count");
 	m_columns << tr("Completed blocks") << tr("Requested blocks") << tr("Block view");
@@ -106,30 +107,73 @@ bool TorrentPiecesModel::hasChildren(const QModelIndex & parent) const
 	return !parent.isValid();
 }
 
+bool TorrentPiecesModel::pieceChanged(const libtorrent::partial_piece_info& a, const libtorrent::partial_piece_info& b)
+{
+	// the block arrays can't be compared, libtorrent reuses their buffer on every call
+	return a.piece_state != b.piece_state || a.blocks_in_piece != b.blocks_in_piece
+		|| a.finished != b.finished || a.writing != b.writing || a.requested != b.requested;
+}
+
 void TorrentPiecesModel::refresh()
 {
-	int count = 0;
+	std::vector<libtorrent::partial_piece_info> pieces;
+	std::map<int, int> incoming;
 	
 	if(m_download->m_handle.is_valid())
+		m_download->m_handle.get_download_queue(pieces);
+	
+	for(size_t i=0;i<pieces.size();i++)
+		incoming[pieces[i].piece_index] = i;
+	
+	// remove completed pieces, bottom up so that the row numbers stay valid
+	for(int i = int(m_pieces.size()) - 1; i >= 0; i--)
 	{
-		m_pieces.clear();
-		m_download->m_handle.get_download_queue(m_pieces);
-		count = m_pieces.size();
+		if(incoming.count(m_pieces[i].piece_index))
+			continue;
+		
+		int last = i;
+		while(i > 0 && !incoming.count(m_pieces[i-1].piece_index))
+			i--;
+		
+		beginRemoveRows(QModelIndex(), i, last);
+		m_pieces.erase(m_pieces.begin() + i, m_pieces.begin() + last + 1);
+		endRemoveRows();
 	}
 	
-	if(count > m_nLastRowCount)
+	// every entry is replaced to get valid block pointers, but only the rows that differ are signalled
+	int from = -1;
+	for(size_t i=0;i<m_pieces.size();i++)
 	{
-		beginInsertRows(QModelIndex(), m_nLastRowCount, count-1);
-		endInsertRows();
+		std::map<int, int>::iterator it = incoming.find(m_pieces[i].piece_index);
+		const libtorrent::partial_piece_info& now = pieces[it->second];
+		bool changed = pieceChanged(m_pieces[i], now);
+		
+		m_pieces[i] = now;
+		incoming.erase(it);
+		
+		if(changed && from < 0)
+			from = i;
+		else if(!changed && from >= 0)
+		{
+			dataChanged(createIndex(from, 0), createIndex(i-1, m_columns.size()-1));
+			from = -1;
+		}
 	}
-	else if(count < m_nLastRowCount)
+	if(from >= 0)
+		dataChanged(createIndex(from, 0), createIndex(m_pieces.size()-1, m_columns.size()-1));
+	
+	if(!incoming.empty())
 	{
-		beginRemoveRows(QModelIndex(), 0, m_nLastRowCount-count-1);
-		endRemoveRows();
+		int first = m_pieces.size();
+		
+		beginInsertRows(QModelIndex(), first, first + incoming.size() - 1);
+		for(size_t i=0;i<pieces.size();i++)
+		{
+			if(incoming.count(pieces[i].piece_index))
+				m_pieces.push_back(pieces[i]);
+		}
+		endInsertRows();
 	}
-	m_nLastRowCount = count;
-	
-	dataChanged(createIndex(0,0), createIndex(count, m_columns.size())); // refresh the view
 }
 
 void BlockDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
@@ -58,8 +58,9 @@ public:
 	
 	void refresh();
 private:
+	static bool pieceChanged(const libtorrent::partial_piece_info& a, const libtorrent::partial_piece_info& b);
+	
 	TorrentDownload* m_download;
-	int m_nLastRowCount;
 	QStringList m_columns;
 protected:
 	std::vector<libtorrent::partial_piece_info> m_pieces;
@@ -27,11 +27,15 @@ respects for all of the code used other than "OpenSSL".
 #include "TorrentProgressWidget.h"
 #include <QPainter>
 #include <algorithm>
+#include <cstring>
 #include <QtDebug>
 
-TorrentProgressWidget::TorrentProgressWidget(QWidget* parent) : QWidget(parent)
+static const int WIDTH = 1000;
+
+TorrentProgressWidget::TorrentProgressWidget(QWidget* parent)
+	: QWidget(parent), m_bPixmapValid(false), m_nFinished(0)
 {
-	m_data = new quint32[1000];
+	m_data = new quint32[WIDTH];
 }
 
 TorrentProgressWidget::~TorrentProgressWidget()
@@ -39,15 +43,129 @@ TorrentProgressWidget::~TorrentProgressWidget()
 	delete [] m_data;
 }
 
+static inline int popcount64(quint64 v)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll(v);
+#else
+	v = v - ((v >> 1) & Q_UINT64_C(0x5555555555555555));
+	v = (v & Q_UINT64_C(0x3333333333333333)) + ((v >> 2) & Q_UINT64_C(0x3333333333333333));
+	v = (v + (v >> 4)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+	return int((v * Q_UINT64_C(0x0101010101010101)) >> 56);
+#endif
+}
+
+// the pieces [from, to] drawn in the given column
+static inline void columnRange(int size, double fact, float sstart, int column, int& from, int& to)
+{
+	from = column*fact+sstart;
+	to = (column+1)*fact+sstart;
+	
+	if(to >= size)
+		to = size-1;
+}
+
+static inline quint32 blueColor(int count, double step)
+{
+	quint32 rcolor = 255 - qMin(quint32(count*step), 255U);
+	return 0xff0000ff | (rcolor << 8) | (rcolor << 16);
+}
+
+int TorrentProgressWidget::countBits(const libtorrent::bitfield& data, int from, int to)
+{
+	// libtorrent stores the first piece in the most significant bit
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.bytes());
+	int count = 0;
+	
+	to++;
+	while(from < to && (from & 7))
+	{
+		if(bytes[from >> 3] & (0x80 >> (from & 7)))
+			count++;
+		from++;
+	}
+	while(to - from >= 64)
+	{
+		quint64 word;
+		memcpy(&word, bytes + (from >> 3), sizeof word);
+		count += popcount64(word);
+		from += 64;
+	}
+	while(to - from >= 8)
+	{
+		count += popcount64(bytes[from >> 3]);
+		from += 8;
+	}
+	while(from < to)
+	{
+		if(bytes[from >> 3] & (0x80 >> (from & 7)))
+			count++;
+		from++;
+	}
+	
+	return count;
+}
+
 void TorrentProgressWidget::generate(const libtorrent::bitfield& data)
 {
-	m_image = generate(data, 1000, m_data);
+	const int size = data.size();
+	const double fact = size/double(WIDTH);
+	const double step = qMin<double>(255.0, 255.0/fact);
+	
+	m_pieces = data;
+	m_counts.resize(WIDTH);
+	m_nFinished = countBits(data, 0, size-1);
+	
+	for(int i=0;i<WIDTH;i++)
+	{
+		int from, to;
+		
+		columnRange(size, fact, 0, i, from, to);
+		m_counts[i] = countBits(data, from, to);
+		m_data[i] = blueColor(m_counts[i], step);
+	}
+	
+	m_image = QImage((uchar*) m_data, WIDTH, 1, QImage::Format_RGB32);
+	m_bPixmapValid = false;
+	update();
+}
+
+void TorrentProgressWidget::setPieceFinished(int piece)
+{
+	const int size = m_pieces.size();
+	
+	if(piece < 0 || piece >= size || m_pieces[piece])
+		return;
+	
+	const double fact = size/double(WIDTH);
+	const double step = qMin<double>(255.0, 255.0/fact);
+	
+	m_pieces.set_bit(piece);
+	m_nFinished++;
+	
+	// neighbouring columns share their boundary pieces and a small
+	// torrent has a piece spread over many columns
+	for(int i=qMax(0, int(piece/fact)-1);i<WIDTH && i<=(piece+1)/fact;i++)
+	{
+		int from, to;
+		
+		columnRange(size, fact, 0, i, from, to);
+		if(piece >= from && piece <= to)
+		{
+			m_counts[i]++;
+			m_data[i] = blueColor(m_counts[i], step);
+		}
+	}
+	
+	m_bPixmapValid = false;
 	update();
 }
 
 void TorrentProgressWidget::generate(const std::vector<int>& data)
 {
-	m_image = generate(data, 1000, m_data);
+	m_image = generate(data, WIDTH, m_data);
+	m_pieces = libtorrent::bitfield();
+	m_bPixmapValid = false;
 	update();
 }
 
@@ -59,22 +177,10 @@ QImage TorrentProgressWidget::generate(const libtorrent::bitfield& data, int wid
 	
 	for(int i=0;i<width;i++)
 	{
-		int from = i*fact+sstart;
-		int to = (i+1)*fact+sstart;
+		int from, to;
 		
-		if(to >= (int) data.size())
-			to = data.size()-1;
-		
-		double color = 0;
-		do
-		{
-			color += data[from] ? step : 0;
-			from++;
-		}
-		while(from <= to);
-		
-		quint32 rcolor = 255 - qMin(quint32(color), 255U);
-		buf[i] = 0xff0000ff | (rcolor << 8) | (rcolor << 16);
+		columnRange(data.size(), fact, sstart, i, from, to);
+		buf[i] = blueColor(countBits(data, from, to), step);
 	}
 	
 	return QImage((uchar*) buf, width, 1, QImage::Format_RGB32);
@@ -120,8 +226,12 @@ void TorrentProgressWidget::paintEvent(QPaintEvent* event)
 	painter.setRenderHint(QPainter::Antialiasing);
 	painter.setClipRegion(event->region());
 	
-	QImage bdraw = m_image.scaled(size());
-	painter.drawImage(0, 0, bdraw);
+	if(!m_bPixmapValid || m_pixmap.size() != size())
+	{
+		m_pixmap = QPixmap::fromImage(m_image.scaled(size()));
+		m_bPixmapValid = true;
+	}
+	painter.drawPixmap(0, 0, m_pixmap);
 	
 	painter.end();
 }
@@ -28,6 +28,8 @@ respects for all of the code used other than "OpenSSL".
 #define TORRENTPROGRESSWIDGET_H
 #include <QWidget>
 #include <QImage>
+#include <QPixmap>
+#include <QVector>
 #include <QPaintEvent>
 #include <cmath>
 #include <cstring>
@@ -42,16 +44,29 @@ public:
 	
 	void generate(const libtorrent::bitfield& data);
 	void generate(const std::vector<int>& data);
+	// updates the columns of a single piece of the last bitfield
+	void setPieceFinished(int piece);
+	// set bits in the last bitfield
+	int finishedPieces() const { return m_nFinished; }
 	
 	// blue colored
 	static QImage generate(const libtorrent::bitfield& data, int width, quint32* buf, float sstart = 0, float send = 0);
 	// grey colored
 	static QImage generate(const std::vector<int>& data, int width, quint32* buf, float sstart = 0, float send = -1);
+	// number of set bits in the range [from, to]
+	static int countBits(const libtorrent::bitfield& data, int from, int to);
 	
 	void paintEvent(QPaintEvent* event);
 private:
 	QImage m_image;
+	// m_image scaled to the size of the widget
+	QPixmap m_pixmap;
+	bool m_bPixmapValid;
 	quint32* m_data;
+	
+	libtorrent::bitfield m_pieces;
+	QVector<int> m_counts;
+	int m_nFinished;
 };
 
 #endif
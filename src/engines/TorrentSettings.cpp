@@ -29,6 +29,7 @@ respects for all of the code used other than "OpenSSL".
 #include "Settings.h"
 #include <QDir>
 #include <QMessageBox>
+#include <QFileDialog>
 #include <QSettings>
 
 extern const char* TORRENT_FILE_STORAGE;
@@ -53,6 +54,7 @@ TorrentSettings::TorrentSettings(QWidget* w, QObject* p) : QObject(p)
 	comboUA->addItem("Azureus/Vuze", "Azureus 4.2.0.8");
 	
 	connect(pushCleanup, SIGNAL(clicked()), this, SLOT(cleanup()));
+	connect(toolIPFilter, SIGNAL(clicked()), this, SLOT(browseIPFilter()));
 }
 
 void TorrentSettings::load()
@@ -107,6 +109,9 @@ void TorrentSettings::load()
 	
 	comboDetailsMode->setCurrentIndex(getSettingsValue("torrent/details_mode").toInt());
 	
+	checkIPFilter->setChecked(getSettingsValue("torrent/ipfilter_enable").toBool());
+	lineIPFilter->setText(getSettingsValue("torrent/ipfilter").toString());
+	
 	QString ua = getSettingsValue("torrent/ua").toString();
 	for(int i=0;i<comboUA->count();i++)
 	{
@@ -149,6 +154,9 @@ void TorrentSettings::accepted()
 	g_settings->setValue("torrent/mapping_natpmp", checkNATPMP->isChecked());
 	g_settings->setValue("torrent/mapping_lsd", checkLSD->isChecked());
 	
+	g_settings->setValue("torrent/ipfilter_enable", checkIPFilter->isChecked());
+	g_settings->setValue("torrent/ipfilter", lineIPFilter->text());
+	
 	g_settings->setValue("torrent/details_mode", comboDetailsMode->currentIndex());
 	g_settings->setValue("torrent/ua", comboUA->itemData(comboUA->currentIndex()).toString());
 	
@@ -160,6 +168,14 @@ void TorrentSettings::applySettings()
 	TorrentDownload::applySettings();
 }
 
+void TorrentSettings::browseIPFilter()
+{
+	QString file = QFileDialog::getOpenFileName(lineIPFilter, "FatRat", lineIPFilter->text(),
+			tr("Blocklists (*.p2p *.dat *.txt *.gz);;All files (*)"));
+	if(!file.isEmpty())
+		lineIPFilter->setText(file);
+}
+
 void TorrentSettings::cleanup()
 {
 	int removed = 0;
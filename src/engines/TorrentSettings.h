@@ -43,6 +43,7 @@ public:
 	static void applySettings();
 public slots:
 	void cleanup();
+	void browseIPFilter();
 private:
 	QList<Proxy> m_listProxy;
 };
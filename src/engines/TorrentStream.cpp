@@ -0,0 +1,129 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#include "TorrentStream.h"
+#include "TorrentDownload.h"
+#include "TorrentAlertThread.h"
+#include <cstring>
+
+// how much is downloaded ahead of the cursor
+static const qint64 READAHEAD_BYTES = 16*1024*1024;
+// the n-th piece ahead is due in n times this many milliseconds
+static const int DEADLINE_STEP = 500;
+// a read fails if the piece doesn't arrive in time
+static const int READ_TIMEOUT = 60*1000;
+
+TorrentStream::TorrentStream(const libtorrent::torrent_handle& handle, boost::intrusive_ptr<libtorrent::torrent_info const> info, int file)
+	: m_handle(handle), m_info(info), m_nPiece(-1), m_nFirstAhead(0), m_nLastAhead(-1)
+{
+	const libtorrent::file_entry& fe = m_info->file_at(file);
+	QString path = QString::fromUtf8(fe.path.c_str());
+	
+	m_hash = m_info->info_hash();
+	m_nFileOffset = fe.offset;
+	m_nFileSize = fe.size;
+	m_strName = path.mid(path.lastIndexOf('/') + 1);
+}
+
+TorrentStream::~TorrentStream()
+{
+	// let the piece picker have its way again
+	if(m_handle.is_valid())
+	{
+		for(int p = m_nFirstAhead; p <= m_nLastAhead; p++)
+			m_handle.reset_piece_deadline(p);
+	}
+}
+
+qint64 TorrentStream::read(qint64 offset, char* buffer, qint64 bytes)
+{
+	if(offset >= m_nFileSize)
+		return 0;
+	if(offset < 0 || !m_handle.is_valid())
+		return -1;
+	
+	const qint64 pos = m_nFileOffset + offset;
+	const int piece = pos / m_info->piece_length();
+	const qint64 inPiece = pos - qint64(piece) * m_info->piece_length();
+	
+	if(piece != m_nPiece && !fetchPiece(piece))
+		return -1;
+	
+	bytes = qMin(bytes, m_nFileSize - offset);
+	bytes = qMin(bytes, qint64(m_piece.size()) - inPiece);
+	
+	if(bytes <= 0)
+		return -1;
+	
+	memcpy(buffer, m_piece.constData() + inPiece, bytes);
+	return bytes;
+}
+
+bool TorrentStream::fetchPiece(int piece)
+{
+	TorrentAlertThread* thread = TorrentDownload::m_alertThread;
+	
+	// a paused torrent won't download the piece, fail the read right away
+	if(m_handle.status(0).paused)
+		return false;
+	
+	readAhead(piece);
+	
+	// a piece that is already there is read right away, a missing one as soon as it passes the hash check
+	thread->expectPiece(m_hash, piece);
+	m_handle.set_piece_deadline(piece, 0, libtorrent::torrent_handle::alert_when_available);
+	
+	if(!thread->waitForPiece(m_hash, piece, m_piece, READ_TIMEOUT))
+	{
+		m_nPiece = -1;
+		m_piece.clear();
+		return false;
+	}
+	
+	m_nPiece = piece;
+	return true;
+}
+
+void TorrentStream::readAhead(int piece)
+{
+	const int pieceLength = m_info->piece_length();
+	const int lastInFile = (m_nFileOffset + qMax<qint64>(m_nFileSize, 1) - 1) / pieceLength;
+	const int window = qMax<qint64>(4, READAHEAD_BYTES / pieceLength);
+	const int last = qMin(piece + window, lastInFile);
+	
+	// the reader has jumped, the old window is of no use anymore
+	if(piece < m_nFirstAhead || piece > m_nLastAhead + 1)
+	{
+		for(int p = m_nFirstAhead; p <= m_nLastAhead; p++)
+			m_handle.reset_piece_deadline(p);
+	}
+	
+	for(int p = piece + 1, i = 1; p <= last; p++, i++)
+		m_handle.set_piece_deadline(p, i * DEADLINE_STEP);
+	
+	m_nFirstAhead = piece + 1;
+	m_nLastAhead = last;
+}
@@ -0,0 +1,68 @@
+/*
+FatRat download manager
+http://fatrat.dolezel.info
+
+Copyright (C) 2006-2011 Lubos Dolezel <lubos a dolezel.info>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 3 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+In addition, as a special exemption, Luboš Doležel gives permission
+to link the code of FatRat with the OpenSSL project's
+"OpenSSL" library (or with modified versions of it that use the; same
+license as the "OpenSSL" library), and distribute the linked
+executables. You must obey the GNU General Public License in all
+respects for all of the code used other than "OpenSSL".
+*/
+
+#ifndef TORRENTSTREAM_H
+#define TORRENTSTREAM_H
+#include "config.h"
+
+#ifndef WITH_BITTORRENT
+#	error This file is not supposed to be included!
+#endif
+
+#include <QByteArray>
+#include <QString>
+#include <libtorrent/torrent_handle.hpp>
+#include <libtorrent/torrent_info.hpp>
+#include "remote/TransferHttpService.h"
+
+// Reads a file of a torrent that is still being downloaded. The pieces ahead
+// of the read cursor get deadlines, so they're downloaded in order.
+// Only the handle is used, the stream may outlive the TorrentDownload.
+class TorrentStream : public TransferHttpService::Stream
+{
+public:
+	TorrentStream(const libtorrent::torrent_handle& handle, boost::intrusive_ptr<libtorrent::torrent_info const> info, int file);
+	virtual ~TorrentStream();
+	
+	virtual qint64 size() const { return m_nFileSize; }
+	virtual QString name() const { return m_strName; }
+	virtual qint64 read(qint64 offset, char* buffer, qint64 bytes);
+private:
+	bool fetchPiece(int piece);
+	void readAhead(int piece);
+private:
+	libtorrent::torrent_handle m_handle;
+	boost::intrusive_ptr<libtorrent::torrent_info const> m_info;
+	libtorrent::sha1_hash m_hash;
+	qint64 m_nFileOffset, m_nFileSize;
+	QString m_strName;
+	
+	// the last piece read and the pieces with a deadline
+	int m_nPiece, m_nFirstAhead, m_nLastAhead;
+	QByteArray m_piece;
+};
+
+#endif
@@ -33,6 +33,10 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #	define lseek64 lseek
 #endif
 
+// read for every segment
+static const CachedSetting<bool> g_forbidIPv6("httpftp/forbidipv6");
+static const CachedSetting<int> g_timeout("httpftp/timeout");
+
 UrlClient::UrlClient()
 	: m_source(0), m_target(0), m_rangeFrom(0), m_rangeTo(-1), m_progress(0), m_curl(0), m_postData(0), m_bTerminating(false)
 {
@@ -41,7 +45,7 @@ UrlClient::UrlClient()
 
 UrlClient::~UrlClient()
 {
-	if (m_target)
+	if (m_target > 0)
 	{
 		close(m_target);
 		m_target = 0;
@@ -81,12 +85,16 @@ void UrlClient::start()
 	QUrl url = m_source->url;
 	bool bWatchHeaders = false;
 	
-	if(lseek64(m_target, m_rangeFrom, SEEK_SET) == (off_t) -1)
+	// a negative target means the subclass consumes the data in writeData()
+	if(m_target >= 0)
 	{
-		emit failure(tr("Failed to seek in the file - %1").arg(strerror(errno)));
-		return;
+		if(lseek64(m_target, m_rangeFrom, SEEK_SET) == (off_t) -1)
+		{
+			emit failure(tr("Failed to seek in the file - %1").arg(strerror(errno)));
+			return;
+		}
+		qDebug() << "Position in file:" << lseek64(m_target, 0, SEEK_CUR);
 	}
-	qDebug() << "Position in file:" << lseek64(m_target, 0, SEEK_CUR);
 	
 	m_curl = curl_easy_init();
 	
@@ -149,7 +157,7 @@ void UrlClient::start()
 	if(!ba.isEmpty())
 		curl_easy_setopt(m_curl, CURLOPT_INTERFACE, ba.constData());
 	
-	if(getSettingsValue("httpftp/forbidipv6").toInt() != 0)
+	if(g_forbidIPv6.value())
 		curl_easy_setopt(m_curl, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V4);
 	
 	curl_easy_setopt(m_curl, CURLOPT_AUTOREFERER, true);
@@ -200,7 +208,7 @@ void UrlClient::start()
 	curl_easy_setopt(m_curl, CURLOPT_SSH_AUTH_TYPES, CURLSSH_AUTH_PASSWORD | CURLSSH_AUTH_KEYBOARD);
 	curl_easy_setopt(m_curl, CURLOPT_USE_SSL, false);
 	
-	int timeout = getSettingsValue("httpftp/timeout").toInt();
+	int timeout = g_timeout.value();
 	curl_easy_setopt(m_curl, CURLOPT_FTP_RESPONSE_TIMEOUT, timeout);
 	curl_easy_setopt(m_curl, CURLOPT_CONNECTTIMEOUT, timeout);
 	curl_easy_setopt(m_curl, CURLOPT_NOSIGNAL, true);
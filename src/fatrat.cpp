@@ -37,6 +37,7 @@ respects for all of the code used other than "OpenSSL".
 #include <QMap>
 #include <QDir>
 #include <QTextCodec>
+#include <QElapsedTimer>
 
 #include <dlfcn.h>
 #include <cstdlib>
@@ -52,6 +53,7 @@ respects for all of the code used other than "OpenSSL".
 
 #include "MainWindow.h"
 #include "QueueMgr.h"
+#include "TickService.h"
 #include "Queue.h"
 #include "Transfer.h"
 #include "AppTools.h"
@@ -66,6 +68,8 @@ respects for all of the code used other than "OpenSSL".
 #include "MyApplication.h"
 #include "Scheduler.h"
 #include "TransferFactory.h"
+#include "TransferScheduler.h"
+#include "LogSink.h"
 
 #ifdef WITH_WEBINTERFACE
 #	include "remote/HttpService.h"
@@ -76,6 +80,10 @@ respects for all of the code used other than "OpenSSL".
 #	include "remote/JabberService.h"
 #endif
 
+#ifdef WITH_CURL
+#	include "engines/CurlUploadTest.h"
+#endif
+
 #ifdef WITH_JPLUGINS
 #	include "java/JVM.h"
 #	include "engines/JavaDownload.h"
@@ -110,6 +118,11 @@ static void initDbus();
 static void testNotif();
 static void writePidFile();
 static void dropPrivileges();
+static void simulateSchedule(const char* file);
+static int runUnitTest(QString name);
+static void startupStage(const char* name);
+static void startupReport();
+static void moveEnginesToFront(QVector<EngineEntry>& engines, int from);
 
 static bool m_bForceNewInstance = false;
 static bool m_bStartHidden = false;
@@ -119,6 +132,11 @@ static QString m_strUnitTest;
 static QString m_strSettingsPath;
 static QString m_strPidFile, m_strSetUser;
 
+// how long each startup stage took, in ms
+static QElapsedTimer g_startupTimer;
+static QList<QPair<QString, qint64> > g_startupStages;
+static qint64 g_nLastStage = 0;
+
 static int g_argc = -1;
 static char** g_argv = 0;
 static QueueMgr* g_qmgr = 0;
@@ -131,6 +149,7 @@ int main(int argc,char** argv)
 	int rval;
 	QString arg;
 	
+	g_startupTimer.start();
 	qsrand(time(0));
 	
 	QCoreApplication::setOrganizationName("Dolezel");
@@ -167,29 +186,63 @@ int main(int argc,char** argv)
 	
 	// Init download engines (let them load settings)
 	initSettingsDefaults(m_strSettingsPath);
+	new TickService;
 	
 	if(m_bStartGUI)
 		initSettingsPages();
 
+	startupStage("settings");
+
+	// independent stages run in the background while the engines start
 #ifdef WITH_JPLUGINS
 	if (!m_bDisableJava)
+		JVM::startAsync(m_bJavaForceSearch);
+#endif
+	if(m_strUnitTest.isEmpty())
+		Queue::preloadQueues();
+	
+	installSignalHandler();
+	initTransferClasses();
+	loadPlugins();
+	startupStage("plugins");
+	runEngines();
+	startupStage("engines");
+	
+	if(!m_strUnitTest.isEmpty())
 	{
-		new JVM(m_bJavaForceSearch);
+		rval = runUnitTest(m_strUnitTest);
+		
+		runEngines(false);
+		delete TickService::instance();
+		exitSettings();
+		LogSink::shutdown();
+		delete app;
+		return rval;
+	}
+
+#ifdef WITH_JPLUGINS
+	if (!m_bDisableJava)
+	{
+		// saved transfers may belong to Java engines
+		JVM::waitForStartup();
+		startupStage("waiting for the JVM");
 
 		if (JVM::JVMAvailable())
 		{
+			const int downloads = g_enginesDownload.size(), uploads = g_enginesUpload.size();
+			
 			JavaDownload::globalInit();
 			JavaExtractor::globalInit();
 			JavaUpload::globalInit();
 			FileSharingSearch::globalInit();
+			
+			// they used to be registered first and win ties in Transfer::bestEngine()
+			moveEnginesToFront(g_enginesDownload, downloads);
+			moveEnginesToFront(g_enginesUpload, uploads);
+			startupStage("Java extensions");
 		}
 	}
 #endif
-	
-	installSignalHandler();
-	initTransferClasses();
-	loadPlugins();
-	runEngines();
 
 	qRegisterMetaType<QString*>("QString*");
 	qRegisterMetaType<QByteArray*>("QByteArray*");
@@ -197,6 +250,7 @@ int main(int argc,char** argv)
 	qRegisterMetaType<Transfer::TransferList>("Transfer::TransferList");
 
 	Queue::loadQueues();
+	startupStage("queues");
 	initAppTools();
 
 	// force singleton creation
@@ -209,8 +263,13 @@ int main(int argc,char** argv)
 	new HttpService;
 #endif
 	
+	startupStage("services");
+	
 	if(m_bStartGUI)
+	{
 		g_wndMain = new MainWindow(m_bStartHidden);
+		startupStage("main window");
+	}
 	else
 		qDebug() << "FatRat is up and running now";
 	
@@ -228,6 +287,9 @@ int main(int argc,char** argv)
 #endif
 	new Scheduler;
 	
+	startupStage("other");
+	startupReport();
+	
 	if(m_bStartGUI)
 		QApplication::setQuitOnLastWindowClosed(false);
 	rval = app->exec();
@@ -259,7 +321,9 @@ int main(int argc,char** argv)
 #endif
 	
 	delete g_qmgr;
+	delete TickService::instance();
 	exitSettings();
+	LogSink::shutdown();
 	delete app;
 	
 	return rval;
@@ -292,7 +356,12 @@ QString argsToArg(int argc,char** argv)
 		else if (!strcasecmp(argv[i], "--user") || !strcasecmp(argv[i], "-u"))
 			m_strSetUser = argv[++i];
 		else if( ( !strcasecmp(argv[i], "--test") || !strcasecmp(argv[i], "-t") ) && i+1 < argc)
+		{
 			m_strUnitTest = argv[++i];
+			m_bStartGUI = false;
+			m_bForceNewInstance = true;
+			m_bDisableJava = true;
+		}
 		else if(!strcasecmp(argv[i], "--no-java"))
 		{
 			qDebug() << "Disabling Java support";
@@ -305,8 +374,18 @@ QString argsToArg(int argc,char** argv)
 		}
 		else if (!strcasecmp(argv[i], "-c") || !strcasecmp(argv[i], "--config"))
 			m_strSettingsPath = argv[++i];
+		else if(!strcasecmp(argv[i], "--simulate-schedule") && i+1 < argc)
+			simulateSchedule(argv[++i]);
 		else if (!strcasecmp(argv[i], "--syslog"))
 			Logger::global()->toggleSysLog(true);
+		else if (!strcasecmp(argv[i], "--log-file") && i+1 < argc)
+		{
+			const char* file = argv[++i];
+			if (LogSink::instance()->setFile(file))
+				Logger::global()->toggleSink(true);
+			else
+				qDebug() << "Cannot open the log file" << file;
+		}
 		else if(argv[i][0] == '-')
 		{
 			i++;
@@ -599,8 +678,11 @@ void showHelp()
 			"-d, --daemon     \tDaemonize the application (assumes --nogui)\n"
 			"-c, --config file\tUse file as settings storage\n"
 			"--syslog         \tPrint global log contents to syslog\n"
+			"--log-file file  \tAppend global log contents to file\n"
 			"-p, --pidfile file\tSave PID to file\n"
 			"-u, --user user[:grp]\tSetuid to user, setgid to grp\n"
+			"--simulate-schedule file\tReplay a queue workload and report missed deadlines\n"
+			"-t, --test name  \tRun a built-in test and exit (curlupload)\n"
 #ifdef WITH_JPLUGINS
 			"--no-java        \tDisable support for Java extensions\n"
 			//"--force-jre-search\tIgnore the cached JRE location\n"
@@ -707,6 +789,29 @@ void writePidFile()
 	file.write(QByteArray::number(getpid()));
 }
 
+int runUnitTest(QString name)
+{
+#ifdef WITH_CURL
+	if(name == "curlupload")
+		return CurlUploadTest().run();
+#endif
+	std::cerr << "Unknown test: " << name.toLocal8Bit().constData() << std::endl;
+	return 1;
+}
+
+void simulateSchedule(const char* path)
+{
+	QFile file(QString::fromLocal8Bit(path));
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		std::cerr << "Cannot open the workload file\n";
+		exit(1);
+	}
+	
+	std::cout << TransferScheduler::simulate(&file).toLocal8Bit().constData();
+	exit(0);
+}
+
 void dropPrivileges()
 {
 	QByteArray user, group;
@@ -756,3 +861,29 @@ void dropPrivileges()
 		chdir(u->pw_dir);
 	}
 }
+
+void startupStage(const char* name)
+{
+	const qint64 now = g_startupTimer.elapsed();
+	g_startupStages << QPair<QString, qint64>(name, now - g_nLastStage);
+	g_nLastStage = now;
+}
+
+void startupReport()
+{
+	QStringList stages;
+	
+	for (int i = 0; i < g_startupStages.size(); i++)
+		stages << QString("%1: %2 ms").arg(g_startupStages[i].first).arg(g_startupStages[i].second);
+	
+	Logger::global()->enterLogMessage("Startup", QObject::tr("Started in %1 ms (%2)")
+					  .arg(g_startupTimer.elapsed()).arg(stages.join(", ")));
+}
+
+void moveEnginesToFront(QVector<EngineEntry>& engines, int from)
+{
+	QVector<EngineEntry> moved = engines.mid(from);
+	
+	engines.resize(from);
+	engines = moved + engines;
+}
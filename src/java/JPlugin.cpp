@@ -129,7 +129,7 @@ void JPlugin::fetchFinished(QNetworkReply* reply)
 		if (reply->error() != QNetworkReply::NoError)
 		{
 			if (m_transfer)
-				m_transfer->logMessage(QLatin1String("JPlugin::fetchFinished(): ")+reply->errorString());
+				m_transfer->enterLogMessage(QLatin1String("JPlugin::fetchFinished(): ")+reply->errorString());
 			iface.call("onFailed", JSignature().addString(), reply->errorString());
 		}
 		else
@@ -153,7 +153,7 @@ void JPlugin::fetchFinished(QNetworkReply* reply)
 			qDebug() << "fetchFinished.onCompleted:" << buf.toString();
 
 			if (m_transfer)
-				m_transfer->logMessage(QLatin1String("JPlugin::fetchFinished(): OK"));
+				m_transfer->enterLogMessage(QLatin1String("JPlugin::fetchFinished(): OK"));
 
 			iface.call("onCompleted", JSignature().add("java.nio.ByteBuffer").add("java.util.Map"), buf, map);
 		}
@@ -49,14 +49,52 @@ respects for all of the code used other than "OpenSSL".
 #include <QtDebug>
 
 JVM* JVM::m_instance = 0;
+QThread* JVM::m_startupThread = 0;
+
+// QSettings isn't shared with the startup thread, the settings are
+// read before it starts and the found libjvm is saved after it ends
+class JVMStartupThread : public QThread
+{
+public:
+	JVMStartupThread(bool forceJreSearch)
+		: m_bForce(forceJreSearch), m_jvm(0)
+	{
+		m_strSavedPath = getSettingsValue("extensions/jvm_path").toString();
+		m_nMaxHeap = getSettingsValue("java/maxheap").toInt();
+	}
+	virtual void run()
+	{
+		m_jvm = new JVM(m_bForce, m_strSavedPath, m_nMaxHeap);
+		
+		// the VM stays, this thread doesn't
+		if (JVM::JVMAvailable())
+			JVM::instance()->detachCurrentThread();
+	}
+	
+	bool m_bForce;
+	QString m_strSavedPath;
+	int m_nMaxHeap;
+	JVM* m_jvm;
+};
+
 
 typedef jint (*cjvm_fn) (JavaVM **pvm, void **penv, void *args);
 
 JVM::JVM(bool forceJreSearch) : m_jvm(0)
+{
+	startup(forceJreSearch, getSettingsValue("extensions/jvm_path").toString(), getSettingsValue("java/maxheap").toInt());
+	saveLibraryPath();
+}
+
+JVM::JVM(bool forceJreSearch, QString savedPath, int maxHeap) : m_jvm(0)
+{
+	startup(forceJreSearch, savedPath, maxHeap);
+}
+
+void JVM::startup(bool forceJreSearch, QString savedPath, int maxHeap)
 {
 	qRegisterMetaType<JObject>("JObject");
 
-	QString savedPath = getSettingsValue("extensions/jvm_path").toString();
 	if (forceJreSearch || savedPath.isEmpty() || !QFile::exists(savedPath))
 	{
 		QProcess prc;
@@ -74,16 +112,22 @@ JVM::JVM(bool forceJreSearch) : m_jvm(0)
 		else
 		{
 			QByteArray libname = prc.readAll().trimmed();
-			jvmStartup(libname);
+			jvmStartup(libname, maxHeap);
 		}
 	}
 	else
 	{
 		qDebug() << "Loading JVM from the stored location:" << savedPath;
-		jvmStartup(savedPath);
+		jvmStartup(savedPath, maxHeap);
 	}
 }
 
+void JVM::saveLibraryPath()
+{
+	if (!m_strLibPath.isEmpty())
+		setSettingsValue("extensions/jvm_path", m_strLibPath);
+}
+
 JVM::~JVM()
 {
 	qDebug() << "Unloading the JVM...";
@@ -95,13 +139,13 @@ JVM::~JVM()
 		m_instance = 0;
 }
 
-void JVM::jvmStartup(QString libname)
+void JVM::jvmStartup(QString libname, int mb)
 {
 	QLibrary lib (libname);
 	cjvm_fn fn = (cjvm_fn) lib.resolve("JNI_CreateJavaVM");
 
 	qDebug() << "libjvm found in" << libname;
-	setSettingsValue("extensions/jvm_path", libname);
+	m_strLibPath = libname;
 
 	if (!fn)
 	{
@@ -119,7 +163,6 @@ void JVM::jvmStartup(QString libname)
 	
 	JNIEnv* env;
 	QByteArray classpath = getClassPath().toUtf8();
-	int mb = getSettingsValue("java/maxheap").toInt();
 
 	if (!mb)
 		mb = 16;
@@ -225,6 +268,30 @@ JVM* JVM::instance()
 	return m_instance;
 }
 
+void JVM::startAsync(bool forceJreSearch)
+{
+	if (m_startupThread)
+		return;
+	
+	m_startupThread = new JVMStartupThread(forceJreSearch);
+	m_startupThread->start();
+}
+
+void JVM::waitForStartup()
+{
+	if (!m_startupThread)
+		return;
+	
+	m_startupThread->wait();
+	
+	JVM* jvm = static_cast<JVMStartupThread*>(m_startupThread)->m_jvm;
+	if (jvm)
+		jvm->saveLibraryPath();
+	
+	delete m_startupThread;
+	m_startupThread = 0;
+}
+
 JVM::operator JNIEnv*()
 {
 	if (!m_jvm)
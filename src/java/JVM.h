@@ -34,6 +34,7 @@ respects for all of the code used other than "OpenSSL".
 
 #include <jni.h>
 #include <QThreadStorage>
+#include <QThread>
 #include <QMap>
 #include <QString>
 #include "JObject.h"
@@ -44,9 +45,17 @@ class JVM
 {
 public:
 	JVM(bool forceJreSearch = false);
+	// doesn't touch the settings, for use outside of the main thread
+	JVM(bool forceJreSearch, QString savedPath, int maxHeap);
 	virtual ~JVM();
 	static bool JVMAvailable();
 	static JVM* instance();
+	
+	// Boots the JVM on a background thread so that the rest of the startup
+	// doesn't have to wait for findjvm.sh and the VM creation
+	static void startAsync(bool forceJreSearch = false);
+	// joins the thread started by startAsync(), if any
+	static void waitForStartup();
 	operator JNIEnv*();
 
 	QMap<QString,QString> getPackageVersions();
@@ -55,11 +64,16 @@ public:
 	void throwException(JObject& obj);
 private:
 	static QString getClassPath();
-	void jvmStartup(QString path);
+	void startup(bool forceJreSearch, QString savedPath, int maxHeap);
+	void jvmStartup(QString path, int maxHeap);
+	void saveLibraryPath();
 private:
 	static JVM* m_instance;
+	static QThread* m_startupThread;
 	JavaVM* m_jvm;
 	QThreadStorage<JNIEnv**> m_env;
+	// the libjvm the VM was loaded from
+	QString m_strLibPath;
 };
 
 #endif // JVM_H
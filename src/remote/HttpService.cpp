@@ -50,6 +50,11 @@ respects for all of the code used other than "OpenSSL".
 #include <QMultiMap>
 #include <QProcess>
 #include <QFile>
+#include <QRegExp>
+#include <QScopedPointer>
+#include <QMimeDatabase>
+#include <QThread>
+#include <QCoreApplication>
 #include <pion/http/basic_auth.hpp>
 #include <pion/http/response_writer.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -74,6 +79,42 @@ HttpService* HttpService::m_instance = 0;
 
 struct AuthenticationFailure {};
 
+// Sends the body of a stream, a read may wait for a piece for a long time
+// and pion's worker threads shouldn't be held for that long
+class StreamSender : public QThread
+{
+public:
+	StreamSender(TransferHttpService::Stream* stream, const pion::tcp::connection_ptr& conn, qint64 from, qint64 to)
+		: m_stream(stream), m_conn(conn), m_nFrom(from), m_nTo(to)
+	{
+		// created on a pion thread, which has no event loop for deleteLater()
+		moveToThread(QCoreApplication::instance()->thread());
+		connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
+	}
+	void run()
+	{
+		QByteArray buffer(64*1024, 0);
+		boost::system::error_code ec;
+
+		for (qint64 pos = m_nFrom; !ec && pos <= m_nTo;)
+		{
+			qint64 rd = m_stream->read(pos, buffer.data(), qMin<qint64>(buffer.size(), m_nTo - pos + 1));
+
+			if (rd <= 0)
+				break;
+
+			m_conn->write(boost::asio::buffer(buffer.constData(), rd), ec);
+			pos += rd;
+		}
+
+		m_conn->finish();
+	}
+private:
+	QScopedPointer<TransferHttpService::Stream> m_stream;
+	pion::tcp::connection_ptr m_conn;
+	qint64 m_nFrom, m_nTo;
+};
+
 HttpService::HttpService()
 	: m_server(0), m_port(0)
 {
@@ -203,6 +244,7 @@ void HttpService::setup()
 		m_server->add_service("/copyrights", new pion::plugins::FileService);
 		m_server->set_service_option("/copyrights", "file", DATA_LOCATION "/README");
 		m_server->add_service("/download", new TransferDownloadService);
+		m_server->add_service("/stream", new TransferStreamService);
 		m_server->add_service("/captcha", new CaptchaService);
 
 		m_server->start();
@@ -249,9 +291,12 @@ void HttpService::LogService::operator()(const pion::http::request_ptr &request,
 	pion::http::response_writer_ptr writer(pion::http::response_writer::create(tcp_conn, *request, boost::bind(&pion::tcp::connection::finish, tcp_conn)));
 	QString uuidTransfer = QString::fromStdString(get_relative_resource(request->get_resource()));
 	QString data;
+	// clients pass back X-Log-Next to receive only the newer records
+	qint64 since = QString::fromStdString(request->get_query("since")).toLongLong();
+	qint64 next;
 
 	if (uuidTransfer.isEmpty())
-		data = Logger::global()->logContents();
+		data = Logger::global()->logContents(since, &next);
 	else
 	{
 		Queue* q = 0;
@@ -266,13 +311,14 @@ void HttpService::LogService::operator()(const pion::http::request_ptr &request,
 			return;
 		}
 
-		data = t->logContents();
+		data = t->logContents(since, &next);
 
 		q->unlock();
 		g_queuesLock.unlock();
 	}
 
 	writer->get_response().add_header("Content-Type", "text/plain");
+	writer->get_response().add_header("X-Log-Next", QString::number(next).toStdString());
 	writer->write(data.toStdString());
 	writer->send();
 }
@@ -440,6 +486,115 @@ void HttpService::TransferDownloadService::operator()(const pion::http::request_
 	sender_ptr->send();
 }
 
+void HttpService::TransferStreamService::operator()(const pion::http::request_ptr &request, const pion::tcp::connection_ptr &tcp_conn)
+{
+	QString transfer = QString::fromStdString(request->get_query("transfer"));
+	int file = QString::fromStdString(request->get_query("file")).toInt();
+
+	transfer = QUrl::fromPercentEncoding(transfer.toUtf8());
+
+	Queue* q = 0;
+	Transfer* t = 0;
+	TransferHttpService::Stream* stream = 0;
+	QString error;
+
+	findTransfer(transfer, &q, &t);
+
+	if (t)
+	{
+		// the stream doesn't need the transfer, nothing is held locked while waiting for data
+		if (TransferHttpService* s = dynamic_cast<TransferHttpService*>(t))
+			stream = s->openStream(file, error);
+
+		q->unlock();
+		g_queuesLock.unlock();
+	}
+
+	if (!stream)
+	{
+		pion::http::response_writer_ptr writer(pion::http::response_writer::create(tcp_conn, *request, boost::bind(&pion::tcp::connection::finish, tcp_conn)));
+		if (!error.isEmpty())
+		{
+			// the data wouldn't arrive, don't let the client wait for them
+			writer->get_response().set_status_code(503);
+			writer->get_response().set_status_message("Service Unavailable");
+			writer->get_response().set_content_type("text/plain; charset=utf-8");
+			writer->write(error.toStdString());
+		}
+		else
+		{
+			writer->get_response().set_status_code(pion::http::types::RESPONSE_CODE_NOT_FOUND);
+			writer->get_response().set_status_message(pion::http::types::RESPONSE_MESSAGE_NOT_FOUND);
+		}
+		writer->send();
+		return;
+	}
+
+	QScopedPointer<TransferHttpService::Stream> guard(stream);
+	const qint64 size = stream->size();
+	qint64 from = 0, to = size - 1;
+	bool partial = false;
+
+	QString range = QString::fromStdString(request->get_header("Range")).trimmed();
+	QRegExp reRange("bytes=(\\d*)-(\\d*)");
+
+	if (reRange.exactMatch(range))
+	{
+		if (reRange.cap(1).isEmpty())
+			from = qMax<qint64>(0, size - reRange.cap(2).toLongLong()); // the last n bytes
+		else
+		{
+			from = reRange.cap(1).toLongLong();
+			if (!reRange.cap(2).isEmpty())
+				to = qMin(to, reRange.cap(2).toLongLong());
+		}
+		partial = true;
+	}
+
+	pion::http::response response(*request);
+	boost::system::error_code ec;
+
+	tcp_conn->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+	response.add_header("Accept-Ranges", "bytes");
+
+	if (partial && (from > to || from >= size))
+	{
+		response.set_status_code(416);
+		response.set_status_message("Requested Range Not Satisfiable");
+		response.add_header("Content-Range", QString("bytes */%1").arg(size).toStdString());
+		response.send(*tcp_conn, ec);
+		tcp_conn->finish();
+		return;
+	}
+
+	if (partial)
+	{
+		response.set_status_code(206);
+		response.set_status_message("Partial Content");
+		response.add_header("Content-Range", QString("bytes %1-%2/%3").arg(from).arg(to).arg(size).toStdString());
+	}
+	else
+	{
+		response.set_status_code(pion::http::types::RESPONSE_CODE_OK);
+		response.set_status_message(pion::http::types::RESPONSE_MESSAGE_OK);
+	}
+
+	QString mime = QMimeDatabase().mimeTypeForFile(stream->name(), QMimeDatabase::MatchExtension).name();
+	response.set_content_type(mime.toStdString());
+	response.add_header("Content-Disposition", QString("inline; filename=\"%1\"").arg(stream->name().left(100)).toStdString());
+	response.set_content_length(to - from + 1);
+	response.send(*tcp_conn, ec, true);
+
+	if (!ec && request->get_method() != "HEAD")
+	{
+		// every read blocks until the pieces covering it have arrived
+		(new StreamSender(guard.take(), tcp_conn, from, to))->start();
+		return;
+	}
+
+	tcp_conn->finish();
+}
+
 void HttpService::SubclassService::operator()(const pion::http::request_ptr &request, const pion::tcp::connection_ptr &tcp_conn)
 {
 	pion::http::response_writer_ptr writer = pion::http::response_writer::create(tcp_conn, *request, boost::bind(&pion::tcp::connection::finish, tcp_conn));
@@ -522,22 +677,44 @@ int HttpService::findTransfer(QString transferUUID, Queue** q, Transfer** t, boo
 	for(int i=0;i<g_queues.size();i++)
 	{
 		Queue* c = g_queues[i];
-		if (lockForWrite)
-			c->lockW();
-		else
-			c->lock();
+		const QueueSnapshot snap = c->snapshot();
 		
-		for(int j=0;j<c->size();j++)
+		// search without the lock, then lock only the queue that has it
+		for(int j=0;j<snap.size();j++)
 		{
-			if(c->at(j)->uuid() == transferUUID)
+			Transfer* x = snap.at(j);
+			if(x->uuid() != transferUUID)
+				continue;
+			
+			if (lockForWrite)
+				c->lockW();
+			else
+				c->lock();
+			
+			// the queue may have changed since the snapshot was taken
+			if(j >= c->size() || c->at(j) != x)
 			{
-				*q = c;
-				*t = c->at(j);
-				return j;
+				j = -1;
+				for(int k=0;k<c->size();k++)
+				{
+					if(c->at(k) == x)
+					{
+						j = k;
+						break;
+					}
+				}
 			}
+			
+			if(j == -1)
+			{
+				c->unlock();
+				break;
+			}
+			
+			*q = c;
+			*t = x;
+			return j;
 		}
-		
-		c->unlock();
 	}
 
 	g_queuesLock.unlock();
@@ -107,6 +107,11 @@ private:
 	{
 		void operator()(const pion::http::request_ptr &request, const pion::tcp::connection_ptr &tcp_conn) override;
 	};
+	// serves a file of a transfer while it's being downloaded, supports ranges
+	class TransferStreamService : public pion::http::plugin_service
+	{
+		void operator()(const pion::http::request_ptr &request, const pion::tcp::connection_ptr &tcp_conn) override;
+	};
 	class SubclassService : public pion::http::plugin_service
 	{
 	public:
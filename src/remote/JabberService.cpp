@@ -425,23 +425,22 @@ QString JabberService::processCommand(ConnectionInfo* conn, QString cmd)
 		}
 		else if(args[0] == "list")
 		{
-			QReadLocker locker(&g_queuesLock);
+			QueueSnapshot q;
+			{
+				QReadLocker locker(&g_queuesLock);
+				validateQueue(conn);
+				q = g_queues[conn->nQueue]->snapshot();
+			}
 			
-			validateQueue(conn);
 			response = tr("List of transfers:");
 			
-			Queue* q = g_queues[conn->nQueue];
-			q->lock();
-			
-			if(q->size())
+			if(q.size())
 			{
-				for(int i=0;i<q->size();i++)
-					response += tr("\n#%1 %2").arg(i).arg(transferInfo(q->at(i)));
+				for(int i=0;i<q.size();i++)
+					response += tr("\n#%1 %2").arg(i).arg(transferInfo(q.at(i)));
 			}
 			else
 				response += tr("no transfers");
-			
-			q->unlock();
 		}
 		else if(args[0] == "pauseall" || args[0] == "resumeall")
 		{
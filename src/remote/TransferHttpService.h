@@ -51,6 +51,21 @@ public:
 
 	// properties the script can access via XML-RPC
 	virtual QVariantMap properties() const = 0;
+
+	// a file of the transfer that can be read before the transfer is complete
+	class Stream
+	{
+	public:
+		virtual ~Stream() {}
+		virtual qint64 size() const = 0;
+		virtual QString name() const = 0;
+		// blocks until the data are available; returns the number of bytes read, 0 at the end and -1 on failure
+		virtual qint64 read(qint64 offset, char* buffer, qint64 bytes) = 0;
+	};
+
+	// the caller takes ownership; 0 if the file can't be streamed,
+	// error is set if it can't be streamed right now
+	virtual Stream* openStream(int /*file*/, QString& /*error*/) { return 0; }
 };
 
 #endif // TRANSFERHTTPSERVICE_H
@@ -32,7 +32,10 @@ respects for all of the code used other than "OpenSSL".
 #include "TransferHttpService.h"
 #include "TransferFactory.h"
 #include "Settings.h"
+#include "SpeedHistory.h"
+#include "TransferIndex.h"
 #include <QReadWriteLock>
+#include <QSet>
 #include <QStringList>
 #include <QFileInfo>
 #include <QTemporaryFile>
@@ -188,10 +191,11 @@ void XmlRpcService::operator()(const pion::http::request_ptr &request, const pio
 
 		if(function == "Queue.getTransfers")
 		{
-			QVariant::Type aa[] = { QVariant::String };
-			checkArguments(args, aa, sizeof(aa)/sizeof(aa[0]));
+			// the second argument, if present, filters the transfers
+			QVariant::Type aa[] = { QVariant::String, QVariant::String };
+			checkArguments(args, aa, (args.size() > 1) ? 2 : 1);
 
-			returnValue = Queue_getTransfers(args[0].toString());
+			returnValue = Queue_getTransfers(args[0].toString(), (args.size() > 1) ? args[1].toString() : QString());
 		}
 		else if(function == "Queue.moveTransfers")
 		{
@@ -349,6 +353,8 @@ QVariant XmlRpcService::Transfer_getProperties(QList<QVariant>& args)
 	vmap["comment"] = t->comment();
 	vmap["object"] = t->object();
 	vmap["timeRunning"] = double(t->timeRunning());
+	vmap["priority"] = t->priority();
+	vmap["deadline"] = double(t->deadline());
 
 	t->speeds(down, up);
 	vmap["speeds"] = QVariantList() << down << up;
@@ -366,30 +372,38 @@ QVariant XmlRpcService::Transfer_getProperties(QList<QVariant>& args)
 	return vmap;
 }
 
-QVariant XmlRpcService::Queue_getTransfers(QString uuid)
+QVariant XmlRpcService::Queue_getTransfers(QString uuid, QString filter)
 {
-	QReadLocker l(&g_queuesLock);
-	Queue* q = 0;
+	QueueSnapshot snapshot;
+	QSet<Transfer*> matches;
+	bool found = false;
 	QVariantList vlist;
 
+	g_queuesLock.lockForRead();
 	for(int i=0;i<g_queues.size();i++)
 	{
 		if(g_queues[i]->uuid() == uuid)
 		{
-			q = g_queues[i];
+			snapshot = g_queues[i]->snapshot();
+			if(!filter.isEmpty())
+				matches = g_queues[i]->searchIndex()->search(snapshot, filter);
+			found = true;
 			break;
 		}
 	}
+	g_queuesLock.unlock();
 
-	if(!q)
+	if(!found)
 		throw XmlRpcError(101, "Invalid queue UUID");
 
-	q->lock();
-
-	for(int i=0;i<q->size();i++)
+	// building the reply doesn't hold up any writers
+	for(int i=0;i<snapshot.size();i++)
 	{
-		Transfer* t = q->at(i);
+		Transfer* t = snapshot.at(i);
 		QVariantMap vmap;
+		
+		if(!filter.isEmpty() && !matches.contains(t))
+			continue;
 		int down, up;
 
 		vmap["name"] = t->name();
@@ -420,7 +434,6 @@ QVariant XmlRpcService::Queue_getTransfers(QString uuid)
 		vlist << vmap;
 	}
 
-	q->unlock();
 	return vlist;
 }
 
@@ -599,6 +612,18 @@ QVariant XmlRpcService::Transfer_setProperties(QStringList luuid, QVariantMap pr
 
 				t->setUserSpeedLimits(list.at(0).toInt(), list.at(1).toInt());
 			}
+			else if(prop == "priority")
+			{
+				checkType(it.value(), QVariant::Int);
+				t->setPriority(it.value().toInt());
+			}
+			else if(prop == "deadline")
+			{
+				// a double so that the time fits past 2038
+				if(it.value().type() != QVariant::Int)
+					checkType(it.value(), QVariant::Double);
+				t->setDeadline(qint64(it.value().toDouble()));
+			}
 			else
 				throw XmlRpcError(103, QString("Invalid transfer property: %1").arg(prop));
 		}
@@ -644,7 +669,7 @@ QVariant XmlRpcService::Queue_moveTransfers(QString uuidQueue, QStringList uuidT
 		throw XmlRpcError(101, "Invalid queue UUID");
 
 	QList<int> positions;
-	q->lockW();
+	q->beginBatch();
 	for(int i=0;i<q->size();i++)
 	{
 		for(int j=0;j<uuidTransfers.size();j++)
@@ -660,7 +685,7 @@ QVariant XmlRpcService::Queue_moveTransfers(QString uuidQueue, QStringList uuidT
 
 	if (!uuidTransfers.empty())
 	{
-		q->unlock();
+		q->endBatch();
 		throw XmlRpcError(102, "One or more invalid transfer UUIDs");
 	}
 
@@ -693,11 +718,11 @@ QVariant XmlRpcService::Queue_moveTransfers(QString uuidQueue, QStringList uuidT
 	}
 	else
 	{
-		q->unlock();
+		q->endBatch();
 		throw XmlRpcError(105, "Invalid move direction");
 	}
 
-	q->unlock();
+	q->endBatch();
 
 	return QVariant();
 }
@@ -789,12 +814,7 @@ QVariant XmlRpcService::Queue_addTransfers(QList<QVariant>& args)
 			uuids << d->uuid();
 		}
 		
-		q->lockW();
-		
-		foreach (Transfer* t, listTransfers)
-			q->add(t);
-		
-		q->unlock();
+		q->add(listTransfers);
 	}
 	catch (const RuntimeException& e)
 	{
@@ -854,9 +874,7 @@ QVariant XmlRpcService::Queue_addTransferWithData(QList<QVariant>& args)
 		else
 			t->setState(Transfer::Waiting);
 
-		q->lockW();
 		q->add(t);
-		q->unlock();
 	}
 	catch (const RuntimeException& e)
 	{
@@ -951,7 +969,7 @@ QVariant XmlRpcService::Transfer_getSpeedGraph(QList<QVariant>& args)
 	if(!t)
 		throw XmlRpcError(102, "Invalid transfer UUID");
 
-	rv = speedDataToString(t->speedData());
+	rv = speedDataToString(t->speedHistory());
 
 	q->unlock();
 	g_queuesLock.unlock();
@@ -970,22 +988,32 @@ QVariant XmlRpcService::Queue_getSpeedGraph(QList<QVariant>& args)
 	if(!q)
 		throw XmlRpcError(101, "Invalid queue UUID");
 
-	rv = speedDataToString(q->speedData());
+	rv = speedDataToString(q->speedHistory());
 	return rv;
 }
 
-QString XmlRpcService::speedDataToString(QQueue<QPair<int,int> > data)
+QString XmlRpcService::speedDataToString(const SpeedHistory* history)
 {
-	QString result;
-
-	while (!data.isEmpty())
+	QByteArray result;
+	
+	if (!history)
+		return QString();
+	
+	const int seconds = getSettingsValue("graphminutes").toInt()*60;
+	const SpeedHistory::Resolution res = SpeedHistory::resolutionFor(seconds);
+	const int repeat = SpeedHistory::interval(res);
+	SpeedHistory::Reader data(history, res);
+	
+	// the clients expect one sample per second, per-minute samples are repeated
+	for (int i = qMax(0, data.size() - seconds/repeat); i < data.size(); i++)
 	{
-		QPair<int,int> el = data.dequeue();
 		char buffer[100];
+		int len;
 
 		// faster than QString
-		snprintf(buffer, sizeof buffer, "%d,%d;", el.first, el.second);
-		result += buffer;
+		len = snprintf(buffer, sizeof buffer, "%d,%d;", data.at(i).down, data.at(i).up);
+		for (int j = 0; j < repeat; j++)
+			result.append(buffer, len);
 	}
-	return result;
+	return QString::fromLatin1(result);
 }
@@ -42,6 +42,7 @@ respects for all of the code used other than "OpenSSL".
 
 class Queue;
 class Transfer;
+class SpeedHistory;
 
 class XmlRpcService : public QObject, public pion::http::plugin_service
 {
@@ -59,7 +60,7 @@ protected:
 	static QVariant getQueues(QList<QVariant>&);
 	static QVariant Queue_create(QList<QVariant>&);
 	static QVariant Queue_setProperties(QList<QVariant>&);
-	static QVariant Queue_getTransfers(QString uuid);
+	static QVariant Queue_getTransfers(QString uuid, QString filter);
 	static QVariant Transfer_getProperties(QList<QVariant>&);
 	static QVariant Queue_moveTransfers(QString uuidQueue, QStringList uuidTransfers, QString direction);
 	static QVariant Transfer_getAdvancedProperties(QList<QVariant>&);
@@ -74,7 +75,7 @@ protected:
 	static QVariant Settings_apply(QList<QVariant>&);
 	static QVariant Settings_getPages(QList<QVariant>&);
 
-	static QString speedDataToString(QQueue<QPair<int,int> > data);
+	static QString speedDataToString(const SpeedHistory* history);
 private slots:
 	void applyAllSettings();
 public:
@@ -25,19 +25,14 @@ respects for all of the code used other than "OpenSSL".
 */
 
 #include "CreateTorrentDlg.h"
+#include "engines/TorrentCreator.h"
+#include "RuntimeException.h"
 #include "fatrat.h"
 #include <cmath>
-#include <fstream>
 #include <QFileDialog>
 #include <QFile>
-#include <QDir>
 #include <QMessageBox>
 #include <QPushButton>
-#include <QFileInfo>
-#include <libtorrent/bencode.hpp>
-#include <libtorrent/storage.hpp>
-#include <libtorrent/hasher.hpp>
-#include <libtorrent/file_pool.hpp>
 
 CreateTorrentDlg::CreateTorrentDlg(QWidget* parent)
 	: QDialog(parent), m_hasher(0)
@@ -82,61 +77,21 @@ void CreateTorrentDlg::browseDirs()
 
 void CreateTorrentDlg::createTorrent()
 {
-	bool bDataInvalid = false, bDirectory = false, bPrivate;
-	QString data = lineData->text();
-	
-	if(data.isEmpty())
-		bDataInvalid = true;
-	else
-	{
-		QFileInfo info(data);
-		if(info.exists())
-			bDirectory = info.isDir();
-		else
-			bDataInvalid = true;
-	}
-	
-	if(bDataInvalid)
-	{
-		QMessageBox::critical(this, "FatRat", tr("The data path is invalid."));
-		return;
-	}
-	
-	bPrivate = checkPrivate->isChecked();
-	
 	libtorrent::create_torrent* info;
+	bool bPrivate = checkPrivate->isChecked();
 	QByteArray comment = lineComment->text().toUtf8();
-	QList<QPair<QString, qint64> > files;
 	
-	QByteArray baseDir;
-	if(!bDirectory)
-	{
-		QFileInfo file(data);
-		
-		baseDir = file.absolutePath().toUtf8();
-		files << QPair<QString, qint64>(file.fileName(), file.size());
-	}
-	else
+	try
 	{
-		QDir dir(data);
-		baseDir = dir.dirName().toUtf8() + '/';
-		
-		recurseDir(files, baseDir, data);
-		dir.cdUp();
-		
-		baseDir = dir.absolutePath().toUtf8();
+		m_hasher = new TorrentCreator(lineData->text(), 64*1024 * pow(2, comboPieceSize->currentIndex()), this);
 	}
-	
-	for(int i=0;i<files.size();i++)
+	catch(const RuntimeException& e)
 	{
-		QByteArray name = files[i].first.toUtf8();
-		qDebug() << name;
-		m_fs.add_file(name.data(), files[i].second);
+		QMessageBox::critical(this, "FatRat", e.what());
+		return;
 	}
 	
-	info = new libtorrent::create_torrent(m_fs, 64*1024 * pow(2, comboPieceSize->currentIndex()));
-	
-	info->set_creator("FatRat " VERSION);
+	info = m_hasher->info();
 	info->set_comment(comment.data());
 	
 	for(int i=0;i<listTrackers->count();i++)
@@ -185,7 +140,6 @@ void CreateTorrentDlg::createTorrent()
 		info->add_url_seed(text.data());
 	}
 	
-	m_hasher = new HasherThread(baseDir, info, this);
 	progressBar->setVisible(true);
 	progressBar->setMaximum(info->num_pieces());
 	pushCreate->setDisabled(true);
@@ -195,39 +149,24 @@ void CreateTorrentDlg::createTorrent()
 	m_hasher->start();
 }
 
-void CreateTorrentDlg::recurseDir(QList<QPair<QString, qint64> >& list, QString prefix, QString path)
-{
-	QDir dir(path);
-	QFileInfoList flist = dir.entryInfoList();
-	
-	for(int i=0;i<flist.size();i++)
-	{
-		if(flist[i].fileName() == "." || flist[i].fileName() == "..")
-			continue;
-		
-		if(flist[i].isDir())
-			recurseDir(list, prefix + flist[i].fileName() + '/', flist[i].absoluteFilePath());
-		else
-			list << QPair<QString, qint64>(prefix + flist[i].fileName(), flist[i].size());
-	}
-}
-
 void CreateTorrentDlg::hasherFinished()
 {
-	libtorrent::create_torrent* info = m_hasher->info();
-	QByteArray torrent;
+	QString torrent;
+	
+	if(!m_hasher) // cancelled
+		return;
 	
 	progressBar->setVisible(false);
 	pushCreate->setDisabled(false);
 	
 	if(m_hasher->error().isEmpty())
 	{
-		torrent = QFileDialog::getSaveFileName(this, "FatRat", QString(), tr("Torrents (*.torrent)")).toUtf8();
+		torrent = QFileDialog::getSaveFileName(this, "FatRat", QString(), tr("Torrents (*.torrent)"));
 		if(!torrent.isEmpty())
 		{
-			libtorrent::entry e = info->generate();
-			std::ofstream fout(torrent.constData(), std::ios_base::binary);
-			libtorrent::bencode(std::ostream_iterator<char>(fout), e);
+			QFile file(torrent);
+			if(!file.open(QIODevice::WriteOnly) || file.write(m_hasher->generate()) < 0)
+				QMessageBox::critical(this, "FatRat", file.errorString());
 		}
 		close();
 	}
@@ -236,48 +175,15 @@ void CreateTorrentDlg::hasherFinished()
 		QMessageBox::critical(this, "FatRat", m_hasher->error());
 	}
 	
-	delete info;
 	delete m_hasher;
 	m_hasher = 0;
 }
 
-HasherThread::HasherThread(QByteArray baseDir, libtorrent::create_torrent* info, QObject* parent)
-	: QThread(parent), m_baseDir(baseDir), m_info(info), m_bAbort(false)
-{
-}
-
-HasherThread::~HasherThread()
-{
-	m_bAbort = true;
-	wait();
-}
-
-void HasherThread::run()
+void CreateTorrentDlg::reject()
 {
-	int num = m_info->num_pieces();
-	char* buf = new char[m_info->piece_length()];
-	
-	try
-	{
-		libtorrent::file_pool fp;
-		libtorrent::storage_interface* st = libtorrent::default_storage_constructor(m_info->files(), 0, m_baseDir.data(), fp, std::vector<boost::uint8_t>());
-		
-		for(int i=0;i<num && !m_bAbort;i++)
-		{
-			st->read(buf, i, 0, m_info->piece_size(i));
-			libtorrent::hasher h(buf, m_info->piece_size(i));
-			m_info->set_hash(i, h.final());
-			
-			emit progress(i);
-		}
-	}
-	catch(const std::exception& e)
-	{
-		std::string err = e.what();
-		m_strError = QString::fromUtf8(err.c_str());
-	}
+	// stops the hashing and waits for the workers
+	delete m_hasher;
+	m_hasher = 0;
 	
-	//delete st;
-	delete [] buf;
+	QDialog::reject();
 }
-
@@ -27,50 +27,25 @@ respects for all of the code used other than "OpenSSL".
 #ifndef CREATETORRENTDLG_H
 #define CREATETORRENTDLG_H
 #include <QDialog>
-#include <QList>
-#include <QPair>
-#include <QThread>
 #include "ui_CreateTorrentDlg.h"
 #include "config.h"
-#include <libtorrent/create_torrent.hpp>
 
-class HasherThread;
+class TorrentCreator;
 class CreateTorrentDlg : public QDialog, Ui_CreateTorrentDlg
 {
 Q_OBJECT
 public:
 	CreateTorrentDlg(QWidget* parent);
 	static QWidget* create();
-private:
-	static void recurseDir(QList<QPair<QString, qint64> >& list, QString prefix, QString path);
 public slots:
 	void browseFiles();
 	void browseDirs();
 	void createTorrent();
 	void hasherFinished();
+	virtual void reject();
 private:
-	libtorrent::file_storage m_fs;
-	HasherThread* m_hasher;
+	TorrentCreator* m_hasher;
 	QPushButton* pushCreate;
 };
 
-class HasherThread : public QThread
-{
-Q_OBJECT
-public:
-	HasherThread(QByteArray baseDir, libtorrent::create_torrent* info, QObject* parent);
-	~HasherThread();
-	
-	virtual void run();
-	const QString& error() const { return m_strError; }
-	libtorrent::create_torrent* info() { return m_info; }
-signals:
-	void progress(int pos);
-private:
-	QByteArray m_baseDir;
-	libtorrent::create_torrent* m_info;
-	bool m_bAbort;
-	QString m_strError;
-};
-
 #endif